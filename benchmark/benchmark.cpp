@@ -6,6 +6,8 @@
 #include <array>
 #include <fstream>
 #include <cassert>
+#include <algorithm>
+#include <omp.h>
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/benchmark/catch_benchmark.hpp>
@@ -15,6 +17,16 @@
 #include <pluribus/poker.hpp>
 #include <pluribus/cluster.hpp>
 #include <pluribus/mccfr.hpp>
+#include <pluribus/deal.hpp>
+#include <pluribus/simd.hpp>
+#include <pluribus/rng.hpp>
+#include <pluribus/numa.hpp>
+#include <pluribus/block.hpp>
+#include <pluribus/mapped.hpp>
+#include <pluribus/compressed.hpp>
+#include <pluribus/hot.hpp>
+#include <pluribus/coro.hpp>
+#include <pluribus/sums.hpp>
 
 using namespace pluribus;
 using std::string;
@@ -129,16 +141,273 @@ TEST_CASE("OCHS features", "[ochs]") {
 
 namespace pluribus {
 
-void call_update_strategy(BlueprintTrainer& trainer, const PokerState& state, int i, const Board& board, 
-                          const std::vector<Hand>& hands) {
-  trainer.update_strategy(state, i, board, hands);
+void call_update_strategy(BlueprintTrainer& trainer, PokerState& state, int i, const Deal& deal) {
+  trainer.update_strategy(state, trainer.root_node(), i, deal);
+  trainer.merge_phi();
 }
 
-int call_traverse_mccfr(BlueprintTrainer& trainer, const PokerState& state, int i, const Board& board, 
-                        const std::vector<Hand>& hands, const omp::HandEvaluator& eval) {
-  return trainer.traverse_mccfr(state, i, board, hands, eval);
+int call_traverse_mccfr(BlueprintTrainer& trainer, PokerState& state, int i, const Deal& deal, const omp::HandEvaluator& eval) {
+  return trainer.traverse_mccfr(state, trainer.root_node(), i, deal, eval);
 }
 
+// Runs the iterations [init_t, end_t) on a single worker like mccfr_p, without its discounts, snapshots and final save.
+void call_run_interval(BlueprintTrainer& trainer, long init_t, long end_t, bool full_ranges) {
+  if(trainer._workers.empty()) trainer._workers.resize(1);
+  auto& worker = trainer._workers[0];
+  if(!worker) worker = std::make_unique<WorkerContext>(trainer._config);
+  if(trainer._config.interleave > 1) {
+    std::atomic<long> next_t = init_t;
+    trainer.run_interleaved(next_t, end_t, *worker, full_ranges);
+  }
+  else {
+    for(long t = init_t; t < end_t; ++t) trainer.run_iteration(t, *worker, full_ranges);
+  }
+  trainer.merge_phi();
+}
+
+}
+
+TEST_CASE("Regret matching", "[mccfr]") {
+  constexpr int n_rows = 1024;
+  constexpr int n_actions = 6;
+  std::uniform_int_distribution<int> dist(-1'000'000, 1'000'000);
+  std::vector<int> int_values(n_rows * n_actions);
+  std::vector<float> float_values(n_rows * n_actions);
+  for(int idx = 0; idx < n_rows * n_actions; ++idx) {
+    int_values[idx] = dist(GlobalRNG::instance());
+    float_values[idx] = int_values[idx];
+  }
+  std::vector<float> freq(n_rows * n_actions);
+
+  BENCHMARK("Regret matching int, scalar") {
+    for(int row = 0; row < n_rows; ++row) regret_matching_scalar(&int_values[row * n_actions], n_actions, &freq[row * n_actions]);
+    return freq[0];
+  };
+  BENCHMARK("Regret matching int, dispatched") {
+    for(int row = 0; row < n_rows; ++row) regret_matching(&int_values[row * n_actions], n_actions, &freq[row * n_actions]);
+    return freq[0];
+  };
+  BENCHMARK("Regret matching float, scalar") {
+    for(int row = 0; row < n_rows; ++row) regret_matching_scalar(&float_values[row * n_actions], n_actions, &freq[row * n_actions]);
+    return freq[0];
+  };
+  BENCHMARK("Regret matching float, dispatched") {
+    for(int row = 0; row < n_rows; ++row) regret_matching(&float_values[row * n_actions], n_actions, &freq[row * n_actions]);
+    return freq[0];
+  };
+}
+
+// Sampling an opponent action from the regrets of the root, by regret matching and from the cached positive sums.
+TEST_CASE("Opponent sampling", "[mccfr]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 169};
+  regrets.allocate(tree);
+  const TreeNode& root = tree.root();
+  int n_actions = root.n_actions;
+  std::uniform_int_distribution<int> dist(-1'000'000, 1'000'000);
+  for(int cluster = 0; cluster < 169; ++cluster) {
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) regrets[regrets.index(root, cluster, a_idx)].store(dist(GlobalRNG::instance()));
+  }
+  RowSums sums{tree, 169, {Precision::INT32, Precision::INT32, Precision::INT32, Precision::INT32}};
+  sums.rebuild(regrets, tree);
+  uint32_t root_id = tree.id(root);
+
+  BENCHMARK("Regret matching") {
+    long sum = 0;
+    std::array<float, MAX_ACTIONS> freq;
+    for(int cluster = 0; cluster < 169; ++cluster) {
+      calculate_strategy(regrets, regrets.index(root, cluster), n_actions, freq.data());
+      sum += sample_action_idx(freq.data(), n_actions);
+    }
+    return sum;
+  };
+  BENCHMARK("Cached row sums") {
+    long sum = 0;
+    std::array<int, MAX_ACTIONS> values;
+    for(int cluster = 0; cluster < 169; ++cluster) {
+      size_t base_idx = regrets.index(root, cluster);
+      regrets.load_row(base_idx, n_actions, values.data());
+      int a_idx = sums.sample(sums.slot(root_id, cluster), values.data(), n_actions, uniform_float(GlobalRNG::instance()));
+      if(a_idx < 0) {
+        std::array<float, MAX_ACTIONS> freq;
+        calculate_strategy(regrets, base_idx, n_actions, freq.data());
+        a_idx = sample_action_idx(freq.data(), n_actions);
+      }
+      sum += a_idx;
+    }
+    return sum;
+  };
+}
+
+void random_updates(AtomicBlock<int>& block, long n_updates) {
+  std::uniform_int_distribution<size_t> dist(0, block.size() - 1);
+  #pragma omp for schedule(static)
+  for(long u = 0; u < n_updates; ++u) block[dist(GlobalRNG::instance())].fetch_add(1, std::memory_order_relaxed);
+}
+
+TEST_CASE("NUMA placement", "[numa]") {
+  int n_nodes = n_numa_nodes();
+  int n_threads = omp_get_max_threads();
+  int node_threads = std::max(1, n_threads / n_nodes);
+  AtomicBlock<int> block{size_t{1} << 26, false, true};
+  std::cout << "NUMA nodes: " << n_nodes << ", placement: " << placement_str(page_nodes(block.data(), block.bytes())) << "\n";
+
+  BENCHMARK("Random updates, one node") {
+    #pragma omp parallel num_threads(node_threads)
+    {
+      pin_to_node(0);
+      random_updates(block, 1'000'000);
+    }
+  };
+  BENCHMARK("Random updates, all nodes") {
+    #pragma omp parallel num_threads(n_threads)
+    {
+      pin_to_node(omp_get_thread_num() % n_nodes);
+      random_updates(block, 1'000'000);
+    }
+  };
+}
+
+float variable_work(long t) {
+  GlobalRNG::seed(42, t);
+  int n = 1 + GlobalRNG::instance()() % 256;
+  float sum = 0.0f;
+  for(int k = 0; k < n; ++k) sum += uniform_float(GlobalRNG::instance());
+  return sum;
+}
+
+TEST_CASE("Iteration scheduling", "[mccfr]") {
+  constexpr long n_iterations = 100'000;
+
+  BENCHMARK("Dynamic, one iteration per claim") {
+    float total = 0.0f;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:total)
+    for(long t = 0; t < n_iterations; ++t) total += variable_work(t);
+    return total;
+  };
+  BENCHMARK("Guided, adaptive chunks") {
+    float total = 0.0f;
+    #pragma omp parallel for schedule(guided, 16) reduction(+:total)
+    for(long t = 0; t < n_iterations; ++t) total += variable_work(t);
+    return total;
+  };
+}
+
+// Every thread updates the rows of the root in the same order, the worst case for contention. Each thread does the same
+// number of updates, so flat times across thread counts mean linear scaling.
+TEST_CASE("Hot row updates", "[mccfr]") {
+  constexpr int n_updates = 100'000;
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 169};
+  regrets.allocate(tree);
+  const TreeNode& root = tree.root();
+  int n_actions = root.n_actions;
+  std::array<Precision, 4> precision = {Precision::INT32, Precision::INT32, Precision::INT32, Precision::INT32};
+  HotRows hot{tree, {{tree.id(root), 1}}, 169, precision, 1, size_t{1} << 16};
+
+  for(int n_threads = 1; n_threads <= omp_get_max_threads(); n_threads *= 2) {
+    BENCHMARK("Direct updates, " + std::to_string(n_threads) + " threads") {
+      #pragma omp parallel num_threads(n_threads)
+      {
+        std::array<int, MAX_ACTIONS> values;
+        for(int k = 0; k < n_updates; ++k) {
+          size_t base_idx = regrets.index(root, k % 169);
+          regrets.load_row(base_idx, n_actions, values.data());
+          for(int a_idx = 0; a_idx < n_actions; ++a_idx) values[a_idx] += a_idx - 1;
+          regrets.store_row(base_idx, n_actions, values.data());
+        }
+      }
+    };
+    BENCHMARK("Hot row deltas, " + std::to_string(n_threads) + " threads") {
+      #pragma omp parallel num_threads(n_threads)
+      {
+        std::vector<long> deltas(hot.n_values(), 0);
+        for(int k = 0; k < n_updates; ++k) {
+          long* row = deltas.data() + hot.slot(regrets.index(root, k % 169));
+          for(int a_idx = 0; a_idx < n_actions; ++a_idx) row[a_idx] += a_idx - 1;
+          if((k + 1) % 256 == 0) hot.flush(regrets, deltas.data(), -310'000'000);
+        }
+        hot.flush(regrets, deltas.data(), -310'000'000);
+      }
+    };
+  }
+}
+
+size_t chase_next(size_t idx, int value, size_t mask) { return (idx * 0x9E3779B97F4A7C15ULL + value) & mask; }
+
+long chase(const int* data, size_t idx, int depth, size_t mask) {
+  if(depth == 0) return 0;
+  int value = data[idx];
+  return value + chase(data, chase_next(idx, value, mask), depth - 1, mask);
+}
+
+Task<long> chase_interleaved(const int* data, size_t idx, int depth, size_t mask) {
+  if(depth == 0) co_return 0;
+  __builtin_prefetch(data + idx);
+  co_await yield_lane();
+  int value = data[idx];
+  co_return value + co_await chase_interleaved(data, chase_next(idx, value, mask), depth - 1, mask);
+}
+
+// Random descents through a table far larger than the caches, like traversals through a large regret table. Every
+// descent depends on the values it reads, so the recursive version waits for each miss in turn.
+TEST_CASE("Interleaved traversals", "[mccfr]") {
+  constexpr int n_descents = 4'096;
+  constexpr int depth = 12;
+  size_t mask = (size_t{1} << 26) - 1;
+  std::vector<int> data(mask + 1);
+  for(size_t idx = 0; idx < data.size(); ++idx) data[idx] = idx % 1'013;
+
+  BENCHMARK("Recursive") {
+    long sum = 0;
+    for(int d = 0; d < n_descents; ++d) sum += chase(data.data(), d * 7'919, depth, mask);
+    return sum;
+  };
+  for(int n_lanes : {2, 4, 8, 16}) {
+    BENCHMARK("Interleaved, " + std::to_string(n_lanes) + " lanes") {
+      std::vector<Lane> lanes(n_lanes);
+      std::vector<Task<long>> tasks(n_lanes);
+      long sum = 0;
+      int next = 0, n_active = 0;
+      auto start = [&](int l_idx) {
+        if(next == n_descents) return false;
+        size_t idx = next++ * 7'919;
+        tasks[l_idx] = lanes[l_idx].spawn([&]() { return chase_interleaved(data.data(), idx, depth, mask); });
+        return true;
+      };
+      for(int l_idx = 0; l_idx < n_lanes; ++l_idx) n_active += start(l_idx);
+      while(n_active > 0) {
+        for(int l_idx = 0; l_idx < n_lanes; ++l_idx) {
+          if(!lanes[l_idx].resume_point) continue;
+          lanes[l_idx].resume();
+          if(!tasks[l_idx].done()) continue;
+          sum += tasks[l_idx].result();
+          tasks[l_idx].reset();
+          if(!start(l_idx)) --n_active;
+        }
+      }
+      return sum;
+    };
+  }
+}
+
+TEST_CASE("Public chance sampling", "[deal]") {
+  omp::HandEvaluator eval;
+  Board board{"AcTd2h3cQs"};
+  PublicDeal deal;
+  deal.update_showdown(board, eval);
+  std::vector<float> reach(N_HANDS, 1.0f / N_HANDS);
+  std::vector<float> values(N_HANDS);
+
+  BENCHMARK("Showdown order") {
+    deal.update_showdown(board, eval);
+  };
+  BENCHMARK("Showdown values") {
+    deal.showdown_values(reach.data(), -500.0f, 1'000.0f, values.data());
+    return values[0];
+  };
 }
 
 TEST_CASE("Blueprint trainer", "[mccfr]") {
@@ -146,14 +415,80 @@ TEST_CASE("Blueprint trainer", "[mccfr]") {
   omp::HandEvaluator eval;
   Board board{"AcTd2h3cQs"};
   std::vector<Hand> hands{Hand{"AsQs"}, Hand{"5c5h"}, Hand{"Kh5d"}, Hand{"Ah3d"}, Hand{"9s9h"}, Hand{"QhJd"}};
+  Deal deal{board, hands};
   BlueprintTrainer trainer{BlueprintTrainerConfig{config}};
+  PokerState state{config};
 
+  BENCHMARK("Cluster deal") {
+    deal.update_clusters();
+  };
+  BENCHMARK("Rank deal") {
+    deal.update_ranks(eval);
+  };
   BENCHMARK("Update strategy") {
-    call_update_strategy(trainer, PokerState{config}, 0, board, hands);
+    call_update_strategy(trainer, state, 0, deal);
   };
   BENCHMARK("Traverse MCCFR") {
-    call_traverse_mccfr(trainer, PokerState{config}, 0, board, hands, eval);
+    call_traverse_mccfr(trainer, state, 0, deal, eval);
+  };
+
+  cereal_save(trainer, "benchmark_snapshot.bin");
+  save_mapped(trainer, "benchmark_snapshot.snap");
+  BENCHMARK("Load cereal snapshot") {
+    return cereal_load<BlueprintTrainer>("benchmark_snapshot.bin").get_regrets().size();
+  };
+  BENCHMARK("Open mapped snapshot") {
+    return MappedSnapshot{"benchmark_snapshot.snap"}.n_regrets();
+  };
+  unlink("benchmark_snapshot.bin");
+  unlink("benchmark_snapshot.snap");
+
+  // Heads-up pre-sized regrets take about 250 MB, far more than the last level cache, so most regret rows miss.
+  for(int interleave : {1, 4}) {
+    BlueprintTrainerConfig hu_config{};
+    hu_config.compile_tree = true;
+    hu_config.interleave = interleave;
+    BlueprintTrainer hu_trainer{hu_config, false, "benchmark_snapshots"};
+    long t = 1;
+    call_run_interval(hu_trainer, t, t + 20'000, true);
+    t += 20'000;
+    BENCHMARK(interleave > 1 ? "Interleaved iterations, 4 lanes" : "Recursive iterations") {
+      call_run_interval(hu_trainer, t, t + 1'000, true);
+      t += 1'000;
+    };
+  }
+  std::filesystem::remove_all("benchmark_snapshots");
+}
+
+TEST_CASE("Snapshot backends", "[serialize]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 200};
+  regrets.allocate(tree);
+  for(size_t idx = 0; idx < regrets.size(); idx += 3) regrets[idx].store(idx % 100'000 - 50'000);
+  int n_shards = omp_get_max_threads();
+
+  BENCHMARK("Save cereal") {
+    cereal_save(regrets, "benchmark_regrets.bin");
+  };
+  BENCHMARK("Save compressed shards") {
+    std::ofstream os("benchmark_regrets.z", std::ios::binary);
+    cereal::BinaryOutputArchive oarchive(os);
+    save_compressed(regrets, oarchive, "benchmark_regrets", n_shards);
+  };
+  BENCHMARK("Load cereal") {
+    return cereal_load<StrategyStorage<int>>("benchmark_regrets.bin").size();
+  };
+  BENCHMARK("Load compressed shards") {
+    std::ifstream is("benchmark_regrets.z", std::ios::binary);
+    cereal::BinaryInputArchive iarchive(is);
+    StrategyStorage<int> loaded;
+    load_compressed(loaded, iarchive, ".");
+    return loaded.size();
   };
+  unlink("benchmark_regrets.bin");
+  unlink("benchmark_regrets.z");
+  for(int shard = 0; shard < n_shards; ++shard) unlink(("benchmark_regrets." + std::to_string(shard) + ".gz").c_str());
 }
 
 #endif
\ No newline at end of file
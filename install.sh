@@ -3,6 +3,7 @@ apt upgrade
 apt install g++ cmake libsdl2-dev libsdl2-image-dev python3.10-venv
 apt-get install libboost-all-dev
 apt-get install libtbb-dev
+apt-get install libnuma-dev
 apt-get install libsdl2-ttf-dev
 
 git clone https://github.com/catchorg/Catch2.git
@@ -56,11 +56,11 @@ void ActionProfile::add_action(const Action& action, int round, int bet_level, i
 }
 
 int ActionProfile::max_actions() const {
-  int ret;
+  int ret = 0;
   for(auto& round : _profile) {
     for(auto& level : round) {
       for(auto& pos : level) {
-        ret = std::max(static_cast<int>(level.size()), ret);
+        ret = std::max(static_cast<int>(pos.size()), ret);
       }
     }
   }
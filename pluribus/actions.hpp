@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <unordered_map>
 #include <initializer_list>
@@ -43,8 +44,9 @@ public:
   ActionHistory(std::vector<Action> actions) : _history{actions} {}
   ActionHistory(std::initializer_list<Action> actions) : _history{actions} {}
 
-  const std::vector<Action> get_history() const { return _history; }
+  const std::vector<Action>& get_history() const { return _history; }
   void push_back(const Action& action) { _history.push_back(action); }
+  void pop_back() { _history.pop_back(); }
   const Action& get(int i) const { return _history[i]; }
   size_t size() const { return _history.size(); }
   std::string to_string() const;
@@ -61,6 +63,10 @@ private:
   std::vector<Action> _history;
 };
 
+// Largest number of actions at a node. Per-node scratch arrays have this size, trees and trainers reject profiles with 
+// more actions.
+constexpr int MAX_ACTIONS = 16;
+
 class ActionProfile {
 public:
   void set_actions(const std::vector<Action>& actions, int round, int bet_level, int pos);
@@ -18,9 +18,9 @@ Action RandomAgent::act(const PokerState& state, const Board& board, const Hand&
 Action BlueprintAgent::act(const PokerState& state, const Board& board, const Hand& hand, const PokerConfig& config) {
   auto actions = valid_actions(state, _trainer_p->get_config().action_profile);
   int cluster = FlatClusterMap::get_instance()->cluster(state.get_round(), board, hand);
-  size_t base_idx = _trainer_p->get_regrets().index(state, cluster);
-  auto freq = calculate_strategy(_trainer_p->get_regrets(), base_idx, actions.size());
-  return actions[sample_action_idx(freq)];
+  const TreeNode* node = _trainer_p->find_node(state);
+  size_t base_idx = node ? _trainer_p->get_regrets().index(*node, cluster) : _trainer_p->get_regrets().index(state, cluster);
+  return actions[_trainer_p->sample_action(node, cluster, base_idx, actions.size())];
 }
 
 // SampledBlueprintAgent::SampledBlueprintAgent(const BlueprintTrainer& trainer) : 
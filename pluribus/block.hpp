@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <omp.h>
+#include <pluribus/numa.hpp>
+
+namespace pluribus {
+
+// Fixed size block of zero-initialized atomics. The block is either heap allocated or mmap'd, optionally backed by 
+// transparent huge pages and interleaved across NUMA nodes. Mapped blocks are prefaulted in parallel, so first touches 
+// don't stall the traversals.
+template<class T>
+class AtomicBlock {
+public:
+  AtomicBlock() = default;
+
+  AtomicBlock(size_t size, bool huge_pages, bool interleave = false) : _size{size}, _mapped{huge_pages || interleave} {
+    if(_size == 0) return;
+    if(_mapped) {
+      void* ptr = mmap(nullptr, bytes(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if(ptr == MAP_FAILED) throw std::runtime_error("AtomicBlock --- mmap failed.");
+      if(huge_pages && madvise(ptr, bytes(), MADV_HUGEPAGE) != 0) std::cout << "AtomicBlock --- madvise(MADV_HUGEPAGE) failed.\n";
+      if(interleave) interleave_pages(ptr, bytes());
+      _data = static_cast<std::atomic<T>*>(ptr);
+      long page_sz = sysconf(_SC_PAGESIZE);
+      char* bytes_ptr = static_cast<char*>(ptr);
+      #pragma omp parallel for schedule(static)
+      for(size_t offset = 0; offset < bytes(); offset += page_sz) {
+        bytes_ptr[offset] = 0;
+      }
+    }
+    else {
+      _data = new std::atomic<T>[_size]();
+    }
+  }
+
+  AtomicBlock(const AtomicBlock& other) : AtomicBlock{other._size, other._mapped} {
+    for(size_t idx = 0; idx < _size; ++idx) _data[idx].store(other._data[idx].load());
+  }
+
+  AtomicBlock(AtomicBlock&& other) noexcept : _data{other._data}, _size{other._size}, _mapped{other._mapped} {
+    other._data = nullptr;
+    other._size = 0;
+  }
+
+  AtomicBlock& operator=(AtomicBlock&& other) noexcept {
+    if(this != &other) {
+      release();
+      _data = other._data;
+      _size = other._size;
+      _mapped = other._mapped;
+      other._data = nullptr;
+      other._size = 0;
+    }
+    return *this;
+  }
+
+  ~AtomicBlock() { release(); }
+
+  std::atomic<T>& operator[](size_t idx) { return _data[idx]; }
+  const std::atomic<T>& operator[](size_t idx) const { return _data[idx]; }
+  size_t size() const { return _size; }
+  size_t bytes() const { return _size * sizeof(std::atomic<T>); }
+  const void* data() const { return _data; }
+  bool is_mapped() const { return _mapped; }
+
+private:
+  void release() {
+    if(!_data) return;
+    if(_mapped) munmap(_data, bytes());
+    else delete[] _data;
+    _data = nullptr;
+  }
+
+  std::atomic<T>* _data = nullptr;
+  size_t _size = 0;
+  bool _mapped = false;
+};
+
+}
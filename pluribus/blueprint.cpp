@@ -1,19 +1,58 @@
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
+#include <memory>
 #include <sys/sysinfo.h>
 #include <pluribus/cereal_ext.hpp>
 #include <pluribus/util.hpp>
 #include <pluribus/mccfr.hpp>
+#include <pluribus/mapped.hpp>
+#include <pluribus/simd.hpp>
 #include <pluribus/range_viewer.hpp>
 #include <pluribus/blueprint.hpp>
 
 namespace pluribus {
 
+// Mapped snapshots of the same config share the tree layout, so their regrets are summed in place without buffers.
+void Blueprint::build_mapped(const std::vector<std::string>& postflop_fns) {
+  std::vector<std::unique_ptr<MappedSnapshot>> snapshots;
+  for(const auto& fn : postflop_fns) {
+    snapshots.push_back(std::make_unique<MappedSnapshot>(fn));
+    if(snapshots.back()->get_config() != snapshots[0]->get_config()) {
+      throw std::runtime_error("Blueprint --- Mapped snapshots were trained with different configs.");
+    }
+  }
+  const auto& config = snapshots[0]->get_config();
+  int n_clusters = snapshots[0]->n_clusters();
+  std::cout << "Computing frequencies of " << snapshots.size() << " mapped snapshots...\n";
+  _freq = std::unique_ptr<StrategyStorage<float>>{new StrategyStorage<float>{config.action_profile, n_clusters}};
+  snapshots[0]->walk([&](const PokerState& state, const TreeNode& node) {
+    for(int c = 0; c < n_clusters; ++c) {
+      size_t regret_idx = node.offset * n_clusters + c * node.n_actions;
+      std::array<float, MAX_ACTIONS> cum_regrets;
+      std::fill(cum_regrets.begin(), cum_regrets.begin() + node.n_actions, 0.0f);
+      for(const auto& snapshot : snapshots) {
+        for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) cum_regrets[a_idx] += snapshot->regrets()[regret_idx + a_idx];
+      }
+      std::array<float, MAX_ACTIONS> curr_freq;
+      regret_matching(cum_regrets.data(), node.n_actions, curr_freq.data());
+      size_t freq_idx = _freq->index(state, c);
+      for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) {
+        _freq->operator[](freq_idx + a_idx).store(curr_freq[a_idx]);
+      }
+    }
+  });
+}
+
 void Blueprint::build(const std::string& preflop_fn, const std::vector<std::string>& postflop_fns, const std::string& buf_dir) {
+  if(!postflop_fns.empty() && std::all_of(postflop_fns.begin(), postflop_fns.end(), is_mapped_snapshot)) {
+    build_mapped(postflop_fns);
+    return;
+  }
   std::filesystem::path buffer_dir = buf_dir;
   size_t max_regrets = 0;
-  tbb::concurrent_unordered_map<ActionHistory, HistoryEntry> history_map;
+  std::vector<std::pair<ActionHistory, size_t>> histories;
   BlueprintTrainerConfig config;
   int n_clusters;
 
@@ -32,15 +71,16 @@ void Blueprint::build(const std::string& preflop_fn, const std::vector<std::stri
     size_t buf_sz = static_cast<size_t>(0.8 * (get_free_ram() / sizeof(std::atomic<int>)));
     std::cout << "Blueprint " << bp_idx << " buffer: " << std::setprecision(2) << std::fixed << buf_sz / static_cast<double>(pow(1024, 3)) << "\n";
 
-    if(regrets.data().size() > max_regrets) {
-      max_regrets = regrets.data().size();
+    if(regrets.size() > max_regrets) {
+      max_regrets = regrets.size();
       std::cout << "New max regrets: " << max_regrets << "\n";
-      history_map = regrets.history_map();
+      histories.clear();
+      regrets.for_each_history([&](const ActionHistory& history, size_t idx) { histories.emplace_back(history, idx); });
     }
 
     size_t offset = 0;
-    while(offset < regrets.data().size()) {
-      size_t curr_buf_sz = std::min(regrets.data().size() - offset, buf_sz);
+    while(offset < regrets.size()) {
+      size_t curr_buf_sz = std::min(regrets.size() - offset, buf_sz);
       Buffer buffer;
       buffer.offset = offset;
       buffer.regrets.resize(curr_buf_sz);
@@ -48,7 +88,7 @@ void Blueprint::build(const std::string& preflop_fn, const std::vector<std::stri
       std::cout << "Storing buffer " << buf_idx << ": [" << offset << ", " << offset + curr_buf_sz << ")\n";
       #pragma omp parallel for schedule(static)
       for(size_t idx = 0; idx < curr_buf_sz ; ++idx) {
-        buffer.regrets[idx] = regrets.data()[offset + idx];
+        buffer.regrets[idx] = regrets.get(offset + idx);
       }
 
       offset += curr_buf_sz;
@@ -71,13 +111,13 @@ void Blueprint::build(const std::string& preflop_fn, const std::vector<std::stri
 
   std::cout << "Computing frequencies...\n";
   _freq = std::unique_ptr<StrategyStorage<float>>{new StrategyStorage<float>{config.action_profile, n_clusters}};
-  for(const auto& entry : history_map) {
+  for(const auto& [history, idx] : histories) {
     PokerState state{config.poker};
-    state = state.apply(entry.first);
+    state = state.apply(history);
     auto actions = valid_actions(state, config.action_profile);
 
     for(int c = 0; c < n_clusters; ++c) {
-      int regret_idx = entry.second.idx + c * actions.size();
+      size_t regret_idx = idx + c * actions.size();
       auto curr_freq = calculate_strategy(cum_strategy, regret_idx, actions.size());
       size_t freq_idx = _freq->index(state, c);
       for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
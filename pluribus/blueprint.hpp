@@ -20,6 +20,8 @@ public:
   }
 
 private:
+  void build_mapped(const std::vector<std::string>& postflop_fns);
+
   std::unique_ptr<StrategyStorage<float>> _freq;
 };
 
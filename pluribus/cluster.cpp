@@ -174,10 +174,10 @@ FlatClusterMap::FlatClusterMap() {
 
 uint16_t FlatClusterMap::cluster(int round, const Board& board, const Hand& hand) const {
   int card_sum = 2 + n_board_cards(round);
-  std::vector<uint8_t> cards(card_sum);
-  std::copy(hand.cards().begin(), hand.cards().end(), cards.data());
-  if(round > 0) std::copy(board.cards().begin(), board.cards().begin() + card_sum - 2, cards.data() + 2);
-  uint64_t idx = HandIndexer::get_instance()->index(cards.data(), round);
+  uint8_t cards[7];
+  std::copy(hand.cards().begin(), hand.cards().end(), cards);
+  if(round > 0) std::copy(board.cards().begin(), board.cards().begin() + card_sum - 2, cards + 2);
+  uint64_t idx = HandIndexer::get_instance()->index(cards, round);
   return cluster(round, idx);
 }
 
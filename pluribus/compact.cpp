@@ -0,0 +1,171 @@
+#include <iostream>
+#include <stdexcept>
+#include <omp.h>
+#include <pluribus/compact.hpp>
+
+namespace pluribus {
+
+CompactSegment::CompactSegment(const GameTree& tree, int round, int n_clusters, Precision precision, int floor, bool huge_pages, 
+                               bool interleave)
+    : _begin{tree.round_offset(round) * n_clusters}, _end{tree.round_offset(round + 1) * n_clusters}, _n_clusters{n_clusters},
+      _precision{precision}, _floor{floor} {
+  if(_precision == Precision::INT32) throw std::runtime_error("CompactSegment --- INT32 rounds are not compact.");
+  tree.walk([&](const PokerState& state, const TreeNode& node) {
+    if(node.round != round) return;
+    // Row scales are indexed by half the row offset, which is unique as long as every row has two or more actions.
+    if(node.n_actions < 2) throw std::runtime_error("CompactSegment --- Rows with less than two actions are not supported.");
+    _nodes.push_back(&node);
+  });
+  if(_precision == Precision::INT16) {
+    _q16 = AtomicBlock<int16_t>{_end - _begin, huge_pages, interleave};
+    while(min_q(_min_shift) < -32767) ++_min_shift;
+    if(_min_shift > 16) throw std::runtime_error("CompactSegment --- Regret floor is out of range for INT16.");
+    set_shift(_min_shift);
+  }
+  else {
+    _q8 = AtomicBlock<int8_t>{_end - _begin, huge_pages, interleave};
+    _row_shift = AtomicBlock<int8_t>{(_end - _begin + 1) / 2, huge_pages, interleave};
+  }
+  size_t n_pages = ((_end - _begin) >> PAGE_BITS) + 1;
+  _page_epochs = std::make_unique<std::atomic<uint32_t>[]>(n_pages);
+  for(size_t page = 0; page < n_pages; ++page) _page_epochs[page].store(0, std::memory_order_relaxed);
+}
+
+size_t CompactSegment::row_base(size_t idx, int& n_actions) const {
+  auto it = std::upper_bound(_nodes.begin(), _nodes.end(), idx, [&](size_t i, const TreeNode* node) {
+    return i < node->offset * _n_clusters;
+  });
+  const TreeNode* node = *std::prev(it);
+  n_actions = node->n_actions;
+  size_t node_base = node->offset * _n_clusters;
+  return node_base + (idx - node_base) / n_actions * n_actions;
+}
+
+int CompactSegment::load(size_t idx) const {
+  if(_precision == Precision::INT16) {
+    settle(idx, 1);
+    return static_cast<int>(_q16[idx - _begin].load(std::memory_order_relaxed)) << _shift.load(std::memory_order_relaxed);
+  }
+  int n_actions;
+  size_t base_idx = row_base(idx, n_actions);
+  std::array<int, MAX_ACTIONS> values;
+  load_row(base_idx, n_actions, values.data());
+  return values[idx - base_idx];
+}
+
+void CompactSegment::store(size_t idx, int value) {
+  if(_precision == Precision::INT16) {
+    settle(idx, 1);
+    store16(idx, value);
+    return;
+  }
+  int n_actions;
+  size_t base_idx = row_base(idx, n_actions);
+  std::array<int, MAX_ACTIONS> values;
+  load_row(base_idx, n_actions, values.data());
+  values[idx - base_idx] = value;
+  store_row(base_idx, n_actions, values.data());
+}
+
+std::vector<size_t> CompactSegment::placement() const {
+  std::vector<size_t> pages = page_nodes(_q16.data(), _q16.bytes());
+  for(const auto* block : {&_q8, &_row_shift}) {
+    std::vector<size_t> block_pages = page_nodes(block->data(), block->bytes());
+    for(int node = 0; node < pages.size(); ++node) pages[node] += block_pages[node];
+  }
+  return pages;
+}
+
+void CompactSegment::set_shift(int shift) {
+  _shift.store(shift);
+  _q16_min = std::max<int64_t>(-32767, min_q(shift));
+}
+
+void CompactSegment::push_epoch(double factor, int shift) {
+  _factors.push_back(_factors.back() * factor);
+  if(_precision == Precision::INT16) {
+    set_shift(shift);
+    _max_q.store(std::min<double>(std::ceil(_max_q.load() * factor), 32'767));
+  }
+}
+
+// The first thread to lock the page rounds it, the others wait until the page is stamped with the current epoch. 
+// Rounding keeps the represented values in expectation, so settling is logically const.
+void CompactSegment::settle_page(size_t page, uint32_t epoch) const {
+  std::atomic<uint32_t>& stamp = _page_epochs[page];
+  uint32_t page_epoch = stamp.load(std::memory_order_acquire);
+  while(page_epoch != epoch) {
+    if(page_epoch == LOCKED_EPOCH) {
+      page_epoch = stamp.load(std::memory_order_acquire);
+    }
+    else if(stamp.compare_exchange_weak(page_epoch, LOCKED_EPOCH, std::memory_order_acquire)) {
+      double factor = _factors[epoch] / _factors[page_epoch];
+      size_t first = page << PAGE_BITS;
+      if(_precision == Precision::INT16) {
+        auto& q16 = const_cast<AtomicBlock<int16_t>&>(_q16);
+        for(size_t idx = first; idx < std::min(first + (size_t{1} << PAGE_BITS), q16.size()); ++idx) {
+          int64_t q = std::max(stochastic_round(q16[idx].load(std::memory_order_relaxed) * factor), _q16_min);
+          if(q > 32767) {
+            q = 32767;
+            const_cast<std::atomic<bool>&>(_saturated).store(true, std::memory_order_relaxed);
+          }
+          q16[idx].store(q, std::memory_order_relaxed);
+        }
+      }
+      else {
+        auto& q8 = const_cast<AtomicBlock<int8_t>&>(_q8);
+        for(size_t idx = first; idx < std::min(first + (size_t{1} << PAGE_BITS), q8.size()); ++idx) {
+          q8[idx].store(stochastic_round(q8[idx].load(std::memory_order_relaxed) * factor), std::memory_order_relaxed);
+        }
+      }
+      stamp.store(epoch, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+void CompactSegment::settle_all() const {
+  uint32_t epoch = _factors.size() - 1;
+  size_t n_pages = ((_end - _begin) >> PAGE_BITS) + 1;
+  #pragma omp parallel for schedule(static)
+  for(size_t page = 0; page < n_pages; ++page) {
+    if(_page_epochs[page].load(std::memory_order_acquire) != epoch) settle_page(page, epoch);
+  }
+}
+
+void CompactSegment::fit(int max_abs) {
+  if(_precision != Precision::INT16) return;
+  int shift = _shift.load();
+  int next_shift = shift;
+  while(next_shift < 16 && (static_cast<int64_t>(max_abs) >> next_shift) > 32767) ++next_shift;
+  if(next_shift != shift) push_epoch(std::ldexp(1.0, shift - next_shift), next_shift);
+}
+
+bool CompactSegment::rescale() {
+  if(_precision != Precision::INT16 || !_saturated.load()) return false;
+  discount(1.0);
+  return true;
+}
+
+// Values clamped at the top of the scale saturate it, the scale is widened at the next discount or rescale. It is 
+// narrowed again once the bound of the values allows it. Rounding can't leave the floor, settled values are clamped to 
+// the minimum of the scale of their epoch.
+void CompactSegment::discount(double d) {
+  if(_precision == Precision::INT8) {
+    push_epoch(d, 0);
+    return;
+  }
+  int shift = _shift.load();
+  bool widened = _saturated.exchange(false) && shift < 16;
+  if(widened) {
+    ++shift;
+    d /= 2.0;
+  }
+  if(!widened && shift > _min_shift && std::ceil(_max_q.load() * d) < 16'384) {
+    --shift;
+    d *= 2.0;
+  }
+  push_epoch(d, shift);
+}
+
+}
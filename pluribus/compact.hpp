@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <pluribus/rng.hpp>
+#include <pluribus/tree.hpp>
+#include <pluribus/block.hpp>
+
+namespace pluribus {
+
+enum class Precision : uint8_t {
+  INT32 = 0, INT16 = 1, INT8 = 2
+};
+
+// Unbiased rounding of value / 2^shift. Quantized regrets stay correct in expectation even if the updates are much
+// smaller than the quantization step.
+inline int64_t stochastic_shift(int64_t value, int shift) {
+  if(shift == 0) return value;
+  int64_t q = value >> shift;
+  uint64_t rem = static_cast<uint64_t>(value - (q << shift));
+  return q + ((GlobalRNG::instance()() >> (64 - shift)) < rem ? 1 : 0);
+}
+
+// Unbiased rounding of value to one of the two integers next to it, for quantized values that are scaled.
+inline int64_t stochastic_round(double value) {
+  double q = std::floor(value);
+  return static_cast<int64_t>(q) + (uniform_float(GlobalRNG::instance()) < value - q ? 1 : 0);
+}
+
+// Regrets of all rows of one betting round, quantized to 16 or 8 bits.
+// INT16: all values of the round share a power of two scale. The scale grows at the next discount or rescale after 
+//        values saturated and shrinks at a discount when the values allow it again. It never drops below the smallest
+//        scale at which the floor is representable, 2^14 for the default floor of -310M, so smaller updates are applied
+//        as coin flips between neighbouring steps. They are only exact in expectation, which is enough for training to 
+//        converge like with INT32 rounds.
+// INT8:  every row has its own power of two scale, which is chosen whenever the row is stored. Rows are read and written
+//        as a whole. Concurrent writers of the same row can tear it the same way concurrent int updates race.
+// Decoded values never drop below the floor, so the regret floor and the prune cutoff keep their meaning.
+// Discounts and scale changes are applied lazily like the page epochs of full precision values: they only record the 
+// cumulative factor of the quantized values, and each page is rounded to it the first time it is touched afterwards.
+class CompactSegment {
+public:
+  CompactSegment(const GameTree& tree, int round, int n_clusters, Precision precision, int floor, bool huge_pages, 
+                 bool interleave = false);
+
+  size_t begin() const { return _begin; }
+  size_t end() const { return _end; }
+  Precision precision() const { return _precision; }
+  // Sampled pages of the segment on each NUMA node.
+  std::vector<size_t> placement() const;
+
+  void prefetch_row(size_t base_idx) const {
+    __builtin_prefetch(&_page_epochs[(base_idx - _begin) >> PAGE_BITS]);
+    if(_precision == Precision::INT16) {
+      __builtin_prefetch(&_q16[base_idx - _begin]);
+    }
+    else {
+      __builtin_prefetch(&_q8[base_idx - _begin]);
+      __builtin_prefetch(&_row_shift[(base_idx - _begin) / 2]);
+    }
+  }
+
+  void load_row(size_t base_idx, int n_actions, int* values) const {
+    settle(base_idx, n_actions);
+    if(_precision == Precision::INT16) {
+      int shift = _shift.load(std::memory_order_relaxed);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        values[a_idx] = static_cast<int>(_q16[base_idx - _begin + a_idx].load(std::memory_order_relaxed)) << shift;
+      }
+    }
+    else {
+      int shift = _row_shift[(base_idx - _begin) / 2].load(std::memory_order_relaxed);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        values[a_idx] = static_cast<int>(_q8[base_idx - _begin + a_idx].load(std::memory_order_relaxed)) << shift;
+      }
+    }
+  }
+
+  void store_row(size_t base_idx, int n_actions, const int* values) {
+    settle(base_idx, n_actions);
+    if(_precision == Precision::INT16) {
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) store16(base_idx + a_idx, values[a_idx]);
+    }
+    else {
+      int max_abs = 0;
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) max_abs = std::max(max_abs, std::abs(values[a_idx]));
+      int shift = std::max(0, (32 - __builtin_clz(max_abs | 1)) - 7);
+      int64_t q_min = std::max<int64_t>(-127, min_q(shift));
+      _row_shift[(base_idx - _begin) / 2].store(shift, std::memory_order_relaxed);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        int64_t q = std::clamp<int64_t>(stochastic_shift(values[a_idx], shift), q_min, 127);
+        _q8[base_idx - _begin + a_idx].store(q, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  int load(size_t idx) const;
+  void store(size_t idx, int value);
+  // Discounts, rescales and fits must not race with accesses.
+  void discount(double d);
+  // Widens the INT16 scale if values saturated since the last discount or rescale and returns whether it did.
+  bool rescale();
+  // Widens the INT16 scale so that values up to max_abs can be stored without saturating.
+  void fit(int max_abs);
+  // Brings every page up to the current epoch in parallel. Only for the parent process, a forked child hangs in OpenMP.
+  void settle_all() const;
+
+  // Calls f(base_idx, n_actions) for every row of the round in storage order.
+  template <class F>
+  void for_each_row(F&& f) const {
+    for(const TreeNode* node : _nodes) {
+      size_t node_base = node->offset * _n_clusters;
+      for(int c = 0; c < _n_clusters; ++c) f(node_base + c * node->n_actions, node->n_actions);
+    }
+  }
+
+private:
+  static constexpr int PAGE_BITS = 12;
+  static constexpr uint32_t LOCKED_EPOCH = std::numeric_limits<uint32_t>::max();
+
+  void store16(size_t idx, int value) {
+    int shift = _shift.load(std::memory_order_relaxed);
+    int64_t q = std::max(stochastic_shift(value, shift), _q16_min);
+    if(q > 32767) {
+      q = 32767;
+      _saturated.store(true, std::memory_order_relaxed);
+    }
+    _q16[idx - _begin].store(q, std::memory_order_relaxed);
+    int abs_q = std::abs(static_cast<int>(q));
+    int max_q = _max_q.load(std::memory_order_relaxed);
+    while(abs_q > max_q && !_max_q.compare_exchange_weak(max_q, abs_q, std::memory_order_relaxed));
+  }
+
+  // Brings the pages of [base_idx, base_idx + n) up to the current epoch.
+  void settle(size_t base_idx, int n) const {
+    uint32_t epoch = _factors.size() - 1;
+    size_t first = (base_idx - _begin) >> PAGE_BITS, last = (base_idx - _begin + n - 1) >> PAGE_BITS;
+    if(_page_epochs[first].load(std::memory_order_acquire) != epoch) settle_page(first, epoch);
+    if(last != first && _page_epochs[last].load(std::memory_order_acquire) != epoch) settle_page(last, epoch);
+  }
+  void settle_page(size_t page, uint32_t epoch) const;
+  // Opens an epoch in which the quantized values are factor times those of the previous one, at the given INT16 scale.
+  void push_epoch(double factor, int shift);
+
+  // Smallest quantized value that does not decode below the floor.
+  int64_t min_q(int shift) const { return -((-static_cast<int64_t>(_floor)) >> shift); }
+  size_t row_base(size_t idx, int& n_actions) const;
+  void set_shift(int shift);
+
+  size_t _begin;
+  size_t _end;
+  int _n_clusters;
+  Precision _precision;
+  int _floor;
+  std::vector<const TreeNode*> _nodes;
+  AtomicBlock<int16_t> _q16;
+  std::atomic<int> _shift = 0;
+  int _min_shift = 0;
+  int64_t _q16_min = -32767;
+  std::atomic<bool> _saturated = false;
+  // Upper bound of the absolute INT16 values in units of the current scale.
+  std::atomic<int> _max_q = 0;
+  AtomicBlock<int8_t> _q8;
+  AtomicBlock<int8_t> _row_shift;
+  std::unique_ptr<std::atomic<uint32_t>[]> _page_epochs;
+  // Cumulative factor of the quantized values at every epoch.
+  std::vector<double> _factors{1.0};
+};
+
+}
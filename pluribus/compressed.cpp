@@ -0,0 +1,75 @@
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <climits>
+#include <zlib.h>
+#include <pluribus/compressed.hpp>
+
+namespace pluribus {
+
+ShardFile::ShardFile(const std::string& fn, bool write, int level) : _fn{fn} {
+  std::string mode = write ? "wb" + std::to_string(level) : "rb";
+  _file = gzopen(fn.c_str(), mode.c_str());
+  if(!_file) throw std::runtime_error("ShardFile --- Cannot open " + fn);
+  gzbuffer(_file, 1 << 20);
+}
+
+ShardFile::~ShardFile() {
+  if(_file) gzclose(_file);
+}
+
+void ShardFile::write(const void* data, size_t bytes) {
+  const char* ptr = static_cast<const char*>(data);
+  while(bytes > 0) {
+    unsigned n = std::min<size_t>(bytes, INT_MAX);
+    if(gzwrite(_file, ptr, n) != n) throw std::runtime_error("ShardFile --- Write failed: " + _fn);
+    ptr += n;
+    bytes -= n;
+  }
+}
+
+void ShardFile::read(void* data, size_t bytes) {
+  char* ptr = static_cast<char*>(data);
+  while(bytes > 0) {
+    unsigned n = std::min<size_t>(bytes, INT_MAX);
+    if(gzread(_file, ptr, n) != n) throw std::runtime_error("ShardFile --- Truncated shard: " + _fn);
+    ptr += n;
+    bytes -= n;
+  }
+}
+
+void ShardFile::close() {
+  int status = gzclose(_file);
+  _file = nullptr;
+  if(status != Z_OK) throw std::runtime_error("ShardFile --- Failed to close " + _fn);
+}
+
+void run_shards(int n_shards, const std::function<void(int)>& f) {
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  std::vector<std::thread> threads;
+  for(int shard = 0; shard < n_shards; ++shard) {
+    threads.emplace_back([&, shard]() {
+      try {
+        f(shard);
+      }
+      catch(...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if(!error) error = std::current_exception();
+      }
+    });
+  }
+  for(auto& thread : threads) thread.join();
+  if(error) std::rethrow_exception(error);
+}
+
+bool is_compressed_snapshot(const std::string& fn) {
+  std::ifstream is(fn, std::ios::binary);
+  char magic[sizeof(COMPRESSED_MAGIC)];
+  return is.read(magic, sizeof(magic)) && std::memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) == 0;
+}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <cereal/cereal.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+#include <pluribus/storage.hpp>
+
+struct gzFile_s;
+
+namespace pluribus {
+
+// One shard of a compressed snapshot, a gzip stream of raw values.
+class ShardFile {
+public:
+  ShardFile(const std::string& fn, bool write, int level = 1);
+  ShardFile(const ShardFile&) = delete;
+  ShardFile& operator=(const ShardFile&) = delete;
+  ~ShardFile();
+
+  void write(const void* data, size_t bytes);
+  void read(void* data, size_t bytes);
+  // Flushes a written shard. Errors surface here instead of in the destructor.
+  void close();
+
+private:
+  gzFile_s* _file;
+  std::string _fn;
+};
+
+// Calls f(shard) for every shard on a thread of its own and rethrows the first exception once all shards are done. Plain
+// threads instead of OpenMP, since a forked snapshot can't use the thread pool of its parent.
+void run_shards(int n_shards, const std::function<void(int)>& f);
+
+// Values per read or write of a shard.
+constexpr size_t SHARD_CHUNK = size_t{1} << 20;
+
+inline size_t shard_begin(size_t n_values, int shard, int n_shards) { return n_values * shard / n_shards; }
+
+// Writes the layout of the storage and the names of its shards to ar. The values are split into n_shards contiguous
+// ranges, which are compressed and written to fn.<shard>.gz in parallel.
+template <class T, class Archive>
+void save_compressed(const StrategyStorage<T>& storage, Archive& ar, const std::string& fn, int n_shards, int level = 1) {
+  if(n_shards < 1) throw std::runtime_error("save_compressed --- At least one shard is required.");
+  std::vector<std::string> shard_fns;
+  for(int shard = 0; shard < n_shards; ++shard) shard_fns.push_back(fn + "." + std::to_string(shard) + ".gz");
+  size_t n_values = storage.size();
+  run_shards(n_shards, [&](int shard) {
+    size_t begin = shard_begin(n_values, shard, n_shards), end = shard_begin(n_values, shard + 1, n_shards);
+    ShardFile file{shard_fns[shard], true, level};
+    std::vector<T> chunk(std::min(SHARD_CHUNK, end - begin));
+    for(size_t idx = begin; idx < end; idx += chunk.size()) {
+      size_t n = std::min(chunk.size(), end - idx);
+      storage.copy_values(idx, n, chunk.data());
+      file.write(chunk.data(), n * sizeof(T));
+    }
+    file.close();
+  });
+  // Shards are referenced by name relative to the index, so snapshots can be moved or renamed as a whole.
+  for(auto& shard_fn : shard_fns) shard_fn = std::filesystem::path{shard_fn}.filename().string();
+  storage.save_layout(ar);
+  ar(shard_fns);
+}
+
+// Loads storage saved by save_compressed from the index in dir. Shards are decompressed in parallel.
+template <class T, class Archive>
+void load_compressed(StrategyStorage<T>& storage, Archive& ar, const std::filesystem::path& dir) {
+  storage.load_layout(ar);
+  std::vector<std::string> shard_fns;
+  ar(shard_fns);
+  int n_shards = shard_fns.size();
+  size_t n_values = storage.size();
+  run_shards(n_shards, [&](int shard) {
+    size_t begin = shard_begin(n_values, shard, n_shards), end = shard_begin(n_values, shard + 1, n_shards);
+    ShardFile file{(dir / shard_fns[shard]).string(), false};
+    std::vector<T> chunk(std::min(SHARD_CHUNK, end - begin));
+    for(size_t idx = begin; idx < end; idx += chunk.size()) {
+      size_t n = std::min(chunk.size(), end - idx);
+      file.read(chunk.data(), n * sizeof(T));
+      storage.fill_values(idx, n, chunk.data());
+    }
+  });
+}
+
+// Index files of compressed snapshots start with these bytes, followed by a cereal archive.
+constexpr char COMPRESSED_MAGIC[8] = {'P', 'L', 'R', 'B', 'Z', 'S', 'N', 'P'};
+
+bool is_compressed_snapshot(const std::string& fn);
+
+}
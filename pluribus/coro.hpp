@@ -0,0 +1,174 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <new>
+
+namespace pluribus {
+
+// Frames of the coroutines of one lane. A lane runs a single chain of nested coroutines, so frames are created and
+// destroyed in stack order and a bump allocator suffices. Frames that don't fit go to the heap.
+class FrameArena {
+public:
+  explicit FrameArena(size_t bytes = size_t{1} << 16) : _buffer{new std::byte[bytes]}, _bytes{bytes} {}
+
+  void* allocate(size_t n) {
+    n = aligned(n);
+    if(_top + n > _bytes) return nullptr;
+    void* ptr = _buffer.get() + _top;
+    _top += n;
+    return ptr;
+  }
+  void deallocate(size_t n) { _top -= aligned(n); }
+  size_t used() const { return _top; }
+
+  // Arena that frames created on this thread are allocated from, or nullptr for the heap.
+  static inline thread_local FrameArena* current = nullptr;
+
+private:
+  static size_t aligned(size_t n) { return (n + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t); }
+
+  std::unique_ptr<std::byte[]> _buffer;
+  size_t _bytes;
+  size_t _top = 0;
+};
+
+struct TaskPromiseBase {
+  // Every frame starts with the arena it was taken from.
+  static constexpr size_t HEADER = alignof(std::max_align_t);
+
+  static void* operator new(size_t n) {
+    FrameArena* arena = FrameArena::current;
+    void* ptr = arena ? arena->allocate(n + HEADER) : nullptr;
+    if(!ptr) {
+      ptr = ::operator new(n + HEADER);
+      arena = nullptr;
+    }
+    *static_cast<FrameArena**>(ptr) = arena;
+    return static_cast<std::byte*>(ptr) + HEADER;
+  }
+
+  static void operator delete(void* frame, size_t n) {
+    void* ptr = static_cast<std::byte*>(frame) - HEADER;
+    FrameArena* arena = *static_cast<FrameArena**>(ptr);
+    if(arena) arena->deallocate(n + HEADER);
+    else ::operator delete(ptr);
+  }
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <class Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+      return handle.promise().continuation;
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() { error = std::current_exception(); }
+
+  std::coroutine_handle<> continuation = std::noop_coroutine();
+  std::exception_ptr error;
+};
+
+template <class T>
+struct TaskPromise : TaskPromiseBase {
+  void return_value(T v) { value = std::move(v); }
+  T result() {
+    if(error) std::rethrow_exception(error);
+    return std::move(value);
+  }
+  T value{};
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+  void return_void() {}
+  void result() {
+    if(error) std::rethrow_exception(error);
+  }
+};
+
+// Lazily started coroutine. Awaiting a task runs it to completion and resumes the awaiting coroutine by symmetric
+// transfer, so deep recursion doesn't grow the native stack.
+template <class T = void>
+class Task {
+public:
+  struct promise_type : TaskPromise<T> {
+    Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+  };
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Task() = default;
+  explicit Task(Handle handle) : _handle{handle} {}
+  Task(Task&& other) noexcept : _handle{std::exchange(other._handle, nullptr)} {}
+  Task& operator=(Task&& other) noexcept {
+    if(this != &other) {
+      reset();
+      _handle = std::exchange(other._handle, nullptr);
+    }
+    return *this;
+  }
+  ~Task() { reset(); }
+
+  Handle handle() const { return _handle; }
+  bool done() const { return !_handle || _handle.done(); }
+  T result() { return _handle.promise().result(); }
+  void reset() {
+    if(_handle) _handle.destroy();
+    _handle = nullptr;
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    _handle.promise().continuation = awaiting;
+    return _handle;
+  }
+  T await_resume() { return _handle.promise().result(); }
+
+private:
+  Handle _handle = nullptr;
+};
+
+// One of several coroutine chains that a thread runs interleaved. A chain gives up the thread with co_await yield_lane(),
+// typically right after prefetching data it is about to read, and continues when the scheduler resumes the lane.
+struct Lane {
+  FrameArena arena;
+  std::coroutine_handle<> resume_point = nullptr;
+
+  static inline thread_local Lane* current = nullptr;
+
+  // Creates the root coroutine of the lane with f(), so that its frame is taken from the arena of the lane.
+  template <class F>
+  auto spawn(F&& f) {
+    FrameArena* prev_arena = std::exchange(FrameArena::current, &arena);
+    auto task = f();
+    FrameArena::current = prev_arena;
+    resume_point = task.handle();
+    return task;
+  }
+
+  // Runs the lane until its chain yields or completes.
+  void resume() {
+    Lane* prev_lane = std::exchange(current, this);
+    FrameArena* prev_arena = std::exchange(FrameArena::current, &arena);
+    std::exchange(resume_point, nullptr).resume();
+    FrameArena::current = prev_arena;
+    current = prev_lane;
+  }
+};
+
+// Outside of a lane, yielding doesn't suspend.
+struct LaneYield {
+  bool await_ready() const noexcept { return !Lane::current; }
+  void await_suspend(std::coroutine_handle<> handle) const noexcept { Lane::current->resume_point = handle; }
+  void await_resume() const noexcept {}
+};
+
+inline LaneYield yield_lane() { return {}; }
+
+}
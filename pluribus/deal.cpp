@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <limits>
+#include <hand_isomorphism/hand_index.h>
+#include <pluribus/infoset.hpp>
+#include <pluribus/cluster.hpp>
+#include <pluribus/range.hpp>
+#include <pluribus/deal.hpp>
+
+namespace pluribus {
+
+void Deal::update_clusters() {
+  // Indices of earlier rounds are a by-product of indexing the river hand round by round.
+  const hand_indexer_t* indexer = HandIndexer::get_instance()->indexer(3);
+  const FlatClusterMap* cluster_map = FlatClusterMap::get_instance();
+  const uint8_t round_cards[] = {2, 3, 1, 1};
+  uint8_t cards[7];
+  std::copy(board.cards().begin(), board.cards().end(), cards + 2);
+  for(int p_idx = 0; p_idx < hands.size(); ++p_idx) {
+    std::copy(hands[p_idx].cards().begin(), hands[p_idx].cards().end(), cards);
+    hand_indexer_state_t state;
+    hand_indexer_state_init(indexer, &state);
+    const uint8_t* round_begin = cards;
+    for(int round = 0; round < 4; ++round) {
+      hand_index_t idx = hand_index_next_round(indexer, round_begin, &state);
+      clusters[p_idx][round] = cluster_map->cluster(round, idx);
+      round_begin += round_cards[round];
+    }
+  }
+}
+
+void Deal::update_ranks(const omp::HandEvaluator& eval) {
+  omp::Hand board_hand = omp::Hand::empty();
+  for(uint8_t card : board.cards()) board_hand += omp::Hand(card);
+  for(int p_idx = 0; p_idx < hands.size(); ++p_idx) {
+    strength[p_idx] = eval.evaluate(board_hand + hands[p_idx].cards()[0] + hands[p_idx].cards()[1]);
+  }
+  // The winners of a mask are the winners of the mask without its lowest seat, compared against that seat.
+  winner_masks[0] = 0;
+  for(uint16_t mask = 1; mask < (1 << hands.size()); ++mask) {
+    int seat = __builtin_ctz(mask);
+    uint16_t rest = mask & (mask - 1);
+    if(rest == 0) {
+      winner_masks[mask] = mask;
+      continue;
+    }
+    uint16_t rest_winners = winner_masks[rest];
+    uint16_t best = strength[__builtin_ctz(rest_winners)];
+    if(strength[seat] > best) winner_masks[mask] = 1 << seat;
+    else if(strength[seat] == best) winner_masks[mask] = rest_winners | (1 << seat);
+    else winner_masks[mask] = rest_winners;
+  }
+}
+
+int Deal::showdown_payoff(const PokerState& state, int i, int n_chips) const {
+  const auto& players = state.get_players();
+  int n_players = players.size();
+  if(players[i].has_folded()) return 0;
+  std::array<int, MAX_PLAYERS> contributions;
+  int total = 0;
+  for(int p_idx = 0; p_idx < n_players; ++p_idx) {
+    contributions[p_idx] = n_chips - players[p_idx].get_chips();
+    total += contributions[p_idx];
+  }
+  // Chips in the pot that no seat contributed (e.g. antes) belong to the main pot.
+  int dead_chips = state.get_pot() - total;
+
+  int payoff = 0;
+  int level = 0;
+  while(true) {
+    int next_level = std::numeric_limits<int>::max();
+    for(int p_idx = 0; p_idx < n_players; ++p_idx) {
+      if(!players[p_idx].has_folded() && contributions[p_idx] > level) next_level = std::min(next_level, contributions[p_idx]);
+    }
+    if(next_level == std::numeric_limits<int>::max()) break;
+    // The last side pot also takes what folded seats put in above the highest remaining contribution.
+    bool last = true;
+    for(int p_idx = 0; p_idx < n_players; ++p_idx) {
+      if(!players[p_idx].has_folded() && contributions[p_idx] > next_level) last = false;
+    }
+    int upper = last ? std::numeric_limits<int>::max() : next_level;
+    int side_pot = level == 0 ? dead_chips : 0;
+    uint16_t eligible = 0;
+    for(int p_idx = 0; p_idx < n_players; ++p_idx) {
+      side_pot += std::clamp(contributions[p_idx], level, upper) - level;
+      if(!players[p_idx].has_folded() && contributions[p_idx] >= next_level) eligible |= 1 << p_idx;
+    }
+    uint16_t win_mask = winners(eligible);
+    if(win_mask & (1 << i)) {
+      int n_winners = __builtin_popcount(win_mask);
+      int rank = __builtin_popcount(win_mask & ((1 << i) - 1));
+      payoff += side_pot / n_winners + (rank < side_pot % n_winners ? 1 : 0);
+    }
+    level = next_level;
+  }
+  return payoff;
+}
+
+const std::array<Hand, N_HANDS>& PublicDeal::hands() {
+  static const std::array<Hand, N_HANDS> table = []() {
+    std::array<Hand, N_HANDS> table;
+    for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) table[h_idx] = HoleCardIndexer::get_instance()->hand(h_idx);
+    return table;
+  }();
+  return table;
+}
+
+void PublicDeal::update(const Board& board_, const omp::HandEvaluator& eval) {
+  update_showdown(board_, eval);
+  update_clusters();
+}
+
+void PublicDeal::update_showdown(const Board& board_, const omp::HandEvaluator& eval) {
+  board = board_;
+  omp::Hand board_hand = omp::Hand::empty();
+  for(uint8_t card : board.cards()) board_hand += omp::Hand(card);
+  order.clear();
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+    const auto& cards = hands()[h_idx].cards();
+    blocked[h_idx] = std::any_of(board.cards().begin(), board.cards().end(), [&](uint8_t card) { 
+      return card == cards[0] || card == cards[1]; 
+    });
+    strength[h_idx] = blocked[h_idx] ? 0 : eval.evaluate(board_hand + cards[0] + cards[1]);
+    if(!blocked[h_idx]) order.push_back(h_idx);
+  }
+  std::sort(order.begin(), order.end(), [&](uint16_t h1, uint16_t h2) { return strength[h1] < strength[h2]; });
+}
+
+void PublicDeal::update_clusters() {
+  const hand_indexer_t* indexer = HandIndexer::get_instance()->indexer(3);
+  const FlatClusterMap* cluster_map = FlatClusterMap::get_instance();
+  const uint8_t round_cards[] = {2, 3, 1, 1};
+  uint8_t cards[7];
+  std::copy(board.cards().begin(), board.cards().end(), cards + 2);
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+    if(blocked[h_idx]) {
+      for(int round = 0; round < 4; ++round) clusters[round][h_idx] = 0;
+      continue;
+    }
+    std::copy(hands()[h_idx].cards().begin(), hands()[h_idx].cards().end(), cards);
+    hand_indexer_state_t state;
+    hand_indexer_state_init(indexer, &state);
+    const uint8_t* round_begin = cards;
+    for(int round = 0; round < 4; ++round) {
+      clusters[round][h_idx] = cluster_map->cluster(round, hand_index_next_round(indexer, round_begin, &state));
+      round_begin += round_cards[round];
+    }
+  }
+}
+
+// Reach of the combinations that collide with h is removed by inclusion-exclusion: subtracting the reach through either 
+// card of h removes h itself twice.
+void PublicDeal::fold_values(const float* reach, float u, float* values) const {
+  float total = 0.0f;
+  float card_total[52] = {};
+  for(uint16_t h_idx : order) {
+    const auto& cards = hands()[h_idx].cards();
+    total += reach[h_idx];
+    card_total[cards[0]] += reach[h_idx];
+    card_total[cards[1]] += reach[h_idx];
+  }
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) values[h_idx] = 0.0f;
+  for(uint16_t h_idx : order) {
+    const auto& cards = hands()[h_idx].cards();
+    values[h_idx] = u * (total - card_total[cards[0]] - card_total[cards[1]] + reach[h_idx]);
+  }
+}
+
+void PublicDeal::showdown_values(const float* reach, float base, float pot, float* values) const {
+  float total = 0.0f, weaker = 0.0f;
+  float card_total[52] = {}, card_weaker[52] = {}, card_tied[52] = {};
+  for(uint16_t h_idx : order) {
+    const auto& cards = hands()[h_idx].cards();
+    total += reach[h_idx];
+    card_total[cards[0]] += reach[h_idx];
+    card_total[cards[1]] += reach[h_idx];
+  }
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) values[h_idx] = 0.0f;
+  for(size_t begin = 0, end = 0; begin < order.size(); begin = end) {
+    float tied = 0.0f;
+    while(end < order.size() && strength[order[end]] == strength[order[begin]]) {
+      const auto& cards = hands()[order[end]].cards();
+      tied += reach[order[end]];
+      card_tied[cards[0]] += reach[order[end]];
+      card_tied[cards[1]] += reach[order[end]];
+      ++end;
+    }
+    for(size_t o_idx = begin; o_idx < end; ++o_idx) {
+      uint16_t h_idx = order[o_idx];
+      const auto& cards = hands()[h_idx].cards();
+      float compatible = total - card_total[cards[0]] - card_total[cards[1]] + reach[h_idx];
+      float beaten = weaker - card_weaker[cards[0]] - card_weaker[cards[1]];
+      float split = tied - card_tied[cards[0]] - card_tied[cards[1]] + reach[h_idx];
+      values[h_idx] = base * compatible + pot * (beaten + 0.5f * split);
+    }
+    weaker += tied;
+    for(size_t o_idx = begin; o_idx < end; ++o_idx) {
+      const auto& cards = hands()[order[o_idx]].cards();
+      card_weaker[cards[0]] += reach[order[o_idx]];
+      card_weaker[cards[1]] += reach[order[o_idx]];
+      card_tied[cards[0]] = card_tied[cards[1]] = 0.0f;
+    }
+  }
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <omp/HandEvaluator.h>
+#include <pluribus/poker.hpp>
+
+namespace pluribus {
+
+// Board and hands of one dealt game together with the cluster of every seat in every round and the showdown winners of
+// every set of seats. Both are computed once per deal, so looking them up during a traversal is an array read.
+struct Deal {
+  explicit Deal(int n_players = 2) : hands(n_players) {}
+  Deal(const Board& board_, const std::vector<Hand>& hands_) : board{board_}, hands{hands_} { 
+    update_clusters(); 
+    update_ranks(omp::HandEvaluator{});
+  }
+
+  // Recomputes all clusters, must be called whenever the board or the hands change.
+  void update_clusters();
+  // Evaluates every seat once and recomputes the winner masks, must be called whenever the board or the hands change.
+  void update_ranks(const omp::HandEvaluator& eval);
+  uint16_t cluster(int player, int round) const { return clusters[player][round]; }
+  // Seats with the best hand among the seats in mask.
+  uint16_t winners(uint16_t mask) const { return winner_masks[mask]; }
+  // Chips player i wins from the pot at showdown. Every contribution level forms its own side pot, which is split among the
+  // remaining players who contributed at least that much. Odd chips go to the winners in seat order.
+  int showdown_payoff(const PokerState& state, int i, int n_chips) const;
+
+  Board board;
+  std::vector<Hand> hands;
+  std::array<std::array<uint16_t, 4>, MAX_PLAYERS> clusters;
+  std::array<uint16_t, MAX_PLAYERS> strength;
+  std::array<uint16_t, 1 << MAX_PLAYERS> winner_masks;
+};
+
+constexpr int N_HANDS = 1326;
+
+// Board of one public chance sample with the cluster of every hole card combination in every round and the combinations
+// sorted by showdown strength. Values are computed for all combinations at once against a reach vector of the opponent, 
+// combinations that share a card with each other or with the board never meet.
+struct PublicDeal {
+  // Recomputes everything, must be called whenever the board changes.
+  void update(const Board& board_, const omp::HandEvaluator& eval);
+  void update_showdown(const Board& board_, const omp::HandEvaluator& eval);
+  void update_clusters();
+  uint16_t cluster(int hand_idx, int round) const { return clusters[round][hand_idx]; }
+
+  // values[h] = u * sum of the reach of all opponent combinations that don't collide with h.
+  void fold_values(const float* reach, float u, float* values) const;
+  // values[h] = sum over compatible opponent combinations of reach * (base + pot if h wins, base + pot / 2 if it ties, 
+  // base if it loses).
+  void showdown_values(const float* reach, float base, float pot, float* values) const;
+
+  // Hole cards of every combination index of the HoleCardIndexer.
+  static const std::array<Hand, N_HANDS>& hands();
+
+  Board board;
+  std::array<std::array<uint16_t, N_HANDS>, 4> clusters;
+  std::array<uint16_t, N_HANDS> strength;
+  std::array<bool, N_HANDS> blocked;
+  // Combinations that don't collide with the board, weakest first.
+  std::vector<uint16_t> order;
+};
+
+}
@@ -75,7 +75,7 @@ std::string strategy_str(const BlueprintTrainer& trainer, const PokerState& stat
       Hand hand{j, i};
       auto actions = valid_actions(state, trainer.get_config().action_profile);
       int cluster = FlatClusterMap::get_instance()->cluster(state.get_round(), board, hand);
-      int base_idx = trainer.get_regrets().index(state, cluster);
+      size_t base_idx = trainer.regret_index(state, cluster);
       auto freq = calculate_strategy(trainer.get_regrets(), base_idx, actions.size());
       int a_idx = std::distance(actions.begin(), std::find(actions.begin(), actions.end(), action));
       oss << std::fixed << std::setprecision(1) << "[" << freq[a_idx] << "]" << cards_to_str(hand.cards().data(), 2) << "[/" << freq[a_idx] << "],";
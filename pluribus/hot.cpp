@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <stdexcept>
+#include <pluribus/hot.hpp>
+
+namespace pluribus {
+
+HotRows::HotRows(const GameTree& tree, const std::unordered_map<uint32_t, long>& visits, int n_clusters, 
+                 const std::array<Precision, 4>& precision, long min_visits, size_t budget) {
+  std::vector<std::pair<long, uint32_t>> candidates;
+  for(const auto& [id, count] : visits) {
+    if(count >= min_visits && precision[tree.node(id).round] == Precision::INT32) candidates.emplace_back(count, id);
+  }
+  std::sort(candidates.begin(), candidates.end(), std::greater<>{});
+  for(const auto& [count, id] : candidates) {
+    const TreeNode& node = tree.node(id);
+    size_t n = static_cast<size_t>(node.n_actions) * n_clusters;
+    if(_n_values + n > budget) break;
+    _nodes.push_back(HotNode{node.offset * n_clusters, node.offset * n_clusters + n, _n_values});
+    _n_values += n;
+    _ids.push_back(id);
+  }
+  std::sort(_nodes.begin(), _nodes.end(), [](const HotNode& a, const HotNode& b) { return a.begin < b.begin; });
+}
+
+long HotRows::flush(StrategyStorage<int>& regrets, long* deltas, int floor) const {
+  long positive_delta = 0;
+  for(const auto& node : _nodes) {
+    for(size_t idx = node.begin; idx < node.end; ++idx) {
+      long& delta = deltas[node.slot + idx - node.begin];
+      if(delta == 0) continue;
+      std::atomic<int>& value = regrets[idx];
+      int prev = value.load(std::memory_order_relaxed);
+      long next;
+      do {
+        next = std::max<long>(prev + delta, floor);
+        if(next > 2'000'000'000) throw std::runtime_error("Regret overflowing!");
+      } while(!value.compare_exchange_weak(prev, next, std::memory_order_relaxed));
+      positive_delta += std::max<long>(next, 0) - std::max(prev, 0);
+      delta = 0;
+    }
+  }
+  return positive_delta;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <pluribus/tree.hpp>
+#include <pluribus/storage.hpp>
+
+namespace pluribus {
+
+// Regret rows which are updated by most iterations, typically the first decisions of the tree. Every worker adds its 
+// updates of hot rows to a private accumulator and flushes them into the shared rows from time to time, so the hottest
+// cache lines are written once per flush instead of once per update. Cold rows are updated directly.
+class HotRows {
+public:
+  HotRows() = default;
+  // Picks the nodes with at least min_visits sampled updates, most visited first, until budget values are taken. visits
+  // maps node ids to sampled update counts. Only nodes with full precision regrets are eligible.
+  HotRows(const GameTree& tree, const std::unordered_map<uint32_t, long>& visits, int n_clusters, 
+          const std::array<Precision, 4>& precision, long min_visits, size_t budget);
+
+  bool empty() const { return _nodes.empty(); }
+  size_t n_nodes() const { return _nodes.size(); }
+  // Values of all hot rows, which is the size of every accumulator.
+  size_t n_values() const { return _n_values; }
+  const std::vector<uint32_t>& node_ids() const { return _ids; }
+
+  // Accumulator slot of a regret index, or -1 if the row is cold.
+  long slot(size_t idx) const {
+    auto it = std::upper_bound(_nodes.begin(), _nodes.end(), idx, [](size_t i, const HotNode& node) { return i < node.begin; });
+    if(it == _nodes.begin()) return -1;
+    --it;
+    return idx < it->end ? static_cast<long>(it->slot + idx - it->begin) : -1;
+  }
+
+  // Adds the accumulated deltas to the regrets and resets them. Values are updated with compare and swap, so concurrent 
+  // flushes don't lose updates. Returns the change of the positive regret sum. The floor and the overflow check apply to
+  // the sum of the deltas of a flush rather than after every update like for cold rows. Where direct updates would have
+  // been lifted by the floor in between, the flushed value is lower by up to that lift, but it never drops below the 
+  // floor. Until the next flush, strategies are computed from the shared values without pending deltas.
+  long flush(StrategyStorage<int>& regrets, long* deltas, int floor) const;
+
+private:
+  struct HotNode {
+    size_t begin;
+    size_t end;
+    size_t slot;
+  };
+
+  std::vector<HotNode> _nodes;
+  std::vector<uint32_t> _ids;
+  size_t _n_values = 0;
+};
+
+}
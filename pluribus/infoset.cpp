@@ -43,7 +43,7 @@ HandIndexer::HandIndexer() {
 //   return "Cluster: " + std::to_string(_cluster) + ", History index: " + std::to_string(_history_idx);
 // }
 
-long count(const PokerState& state, const ActionProfile& action_profile, int max_round, bool infosets) {
+long count(PokerState& state, const ActionProfile& action_profile, int max_round, bool infosets) {
   if(state.is_terminal() || state.get_round() > max_round) {
     return 0;
   }
@@ -55,17 +55,21 @@ long count(const PokerState& state, const ActionProfile& action_profile, int max
     c = 1;
   }
   for(Action a : valid_actions(state, action_profile)) {
-    c += count(state.apply(a), action_profile, max_round, infosets);
+    StateDelta delta = state.apply_in_place(a);
+    c += count(state, action_profile, max_round, infosets);
+    state.undo(delta);
   }
   return c;
 }
 
 long count_infosets(const PokerState& state, const ActionProfile& action_profile, int max_round) {
-  return count(state, action_profile, max_round, true);
+  PokerState root = state;
+  return count(root, action_profile, max_round, true);
 }
 
 long count_actionsets(const PokerState& state, const ActionProfile& action_profile, int max_round) {
-  return count(state, action_profile, max_round, false);
+  PokerState root = state;
+  return count(root, action_profile, max_round, false);
 }
 
 }
\ No newline at end of file
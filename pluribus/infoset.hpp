@@ -9,6 +9,7 @@ namespace pluribus {
 class HandIndexer {
 public:
   uint64_t index(const uint8_t cards[], int round) { return hand_index_last(&_indexers[round], cards); }
+  const hand_indexer_t* indexer(int round) const { return &_indexers[round]; }
 
   static HandIndexer* get_instance() {
     if(!_instance) {
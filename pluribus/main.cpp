@@ -2,10 +2,15 @@
 #include <map>
 #include <functional>
 #include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 #include <pluribus/poker.hpp>
 #include <pluribus/cluster.hpp>
 #include <pluribus/range_viewer.hpp>
 #include <pluribus/traverse.hpp>
+#include <pluribus/mccfr.hpp>
+#include <pluribus/mapped.hpp>
 
 using namespace pluribus;
 
@@ -41,6 +46,18 @@ int main(int argc, char* argv[]) {
     }
     
   }
+  else if(command == "merge-replicas") {
+    if(argc < 4) std::cout << "Usage: " << argv[0] << " merge-replicas <output> <rank 0> <rank 1> ...\n";
+    else merge_replicas(std::vector<std::string>{argv + 3, argv + argc}, argv[2]);
+  }
+  else if(command == "rebuild-snapshot") {
+    if(argc < 4) std::cout << "Usage: " << argv[0] << " rebuild-snapshot <output> <base> <delta 0> <delta 1> ...\n";
+    else cereal_save(load_snapshot(argv[3], std::vector<std::string>{argv + 4, argv + argc}), argv[2]);
+  }
+  else if(command == "map-snapshot") {
+    if(argc < 4) std::cout << "Usage: " << argv[0] << " map-snapshot <snapshot> <output>\n";
+    else save_mapped(cereal_load<BlueprintTrainer>(argv[2]), argv[3]);
+  }
   else {
     std::cout << "Unknown command." << std::endl;
   }
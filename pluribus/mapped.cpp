@@ -0,0 +1,167 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cereal/archives/binary.hpp>
+#include <pluribus/mapped.hpp>
+
+namespace pluribus {
+
+constexpr uint64_t SECTION_ALIGN = 4096;
+
+uint64_t align_section(uint64_t offset) {
+  return (offset + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+MappedSnapshot::MappedSnapshot(const std::string& fn) {
+  int fd = open(fn.c_str(), O_RDONLY);
+  if(fd < 0) throw std::runtime_error("MappedSnapshot --- Cannot open " + fn);
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < sizeof(MappedSnapshotHeader)) {
+    close(fd);
+    throw std::runtime_error("MappedSnapshot --- Not a snapshot: " + fn);
+  }
+  _bytes = st.st_size;
+  _data = mmap(nullptr, _bytes, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(_data == MAP_FAILED) {
+    _data = nullptr;
+    throw std::runtime_error("MappedSnapshot --- mmap failed: " + fn);
+  }
+
+  _header = section<MappedSnapshotHeader>(0);
+  std::string error;
+  if(std::memcmp(_header->magic, MappedSnapshotHeader::MAGIC, sizeof(_header->magic)) != 0) error = "Not a snapshot: ";
+  else if(_header->version != MappedSnapshotHeader::VERSION) error = "Unsupported version: ";
+  else if(_header->node_bytes != sizeof(TreeNode)) error = "Incompatible tree layout: ";
+  else if(_header->phi_offset + _header->n_phi * sizeof(float) > _bytes) error = "Truncated snapshot: ";
+  if(!error.empty()) {
+    munmap(_data, _bytes);
+    throw std::runtime_error("MappedSnapshot --- " + error + fn);
+  }
+  _nodes = section<TreeNode>(_header->nodes_offset);
+  _children = section<uint32_t>(_header->children_offset);
+  _actions = section<float>(_header->actions_offset);
+  std::istringstream is(std::string{section<char>(_header->config_offset), _header->config_bytes});
+  cereal::BinaryInputArchive iarchive(is);
+  iarchive(_config);
+}
+
+MappedSnapshot::~MappedSnapshot() {
+  if(_data) munmap(_data, _bytes);
+}
+
+const TreeNode* MappedSnapshot::find(const ActionHistory& history) const {
+  const TreeNode* node = &root();
+  for(int h_idx = _config.init_state.get_action_history().size(); h_idx < history.size(); ++h_idx) {
+    int a_idx = 0;
+    while(a_idx < node->n_actions && action(*node, a_idx) != history.get(h_idx)) ++a_idx;
+    if(a_idx == node->n_actions) return nullptr;
+    node = child(*node, a_idx);
+    if(!node) return nullptr;
+  }
+  return node;
+}
+
+const TreeNode& MappedSnapshot::find_node(const PokerState& state) const {
+  const TreeNode* node = find(state.get_action_history());
+  if(!node) throw std::runtime_error("MappedSnapshot --- History is not part of the snapshot.");
+  return *node;
+}
+
+bool is_mapped_snapshot(const std::string& fn) {
+  std::ifstream is(fn, std::ios::binary);
+  char magic[sizeof(MappedSnapshotHeader::MAGIC)];
+  return is.read(magic, sizeof(magic)) && std::memcmp(magic, MappedSnapshotHeader::MAGIC, sizeof(magic)) == 0;
+}
+
+void save_mapped(const BlueprintTrainer& trainer, const std::string& fn) {
+  std::cout << "Saving mapped snapshot to " << fn << '\n';
+  const auto& config = trainer.get_config();
+  const auto& regrets = trainer.get_regrets();
+  const auto& phi = trainer.get_phi();
+  std::unique_ptr<GameTree> own_tree;
+  const GameTree* tree = trainer.get_tree();
+  if(!tree) {
+    own_tree = std::make_unique<GameTree>(config.init_state, config.action_profile);
+    tree = own_tree.get();
+  }
+
+  std::ostringstream config_os;
+  {
+    cereal::BinaryOutputArchive oarchive(config_os);
+    oarchive(config);
+  }
+  std::string config_blob = config_os.str();
+
+  MappedSnapshotHeader header{};
+  std::copy(MappedSnapshotHeader::MAGIC, MappedSnapshotHeader::MAGIC + sizeof(header.magic), header.magic);
+  header.version = MappedSnapshotHeader::VERSION;
+  header.n_clusters = regrets.n_clusters();
+  header.phi_clusters = phi.n_clusters();
+  header.node_bytes = sizeof(TreeNode);
+  header.config_offset = align_section(sizeof(header));
+  header.config_bytes = config_blob.size();
+  header.nodes_offset = align_section(header.config_offset + header.config_bytes);
+  header.n_nodes = tree->size();
+  header.children_offset = align_section(header.nodes_offset + header.n_nodes * sizeof(TreeNode));
+  header.n_edges = tree->children().size();
+  header.actions_offset = align_section(header.children_offset + header.n_edges * sizeof(uint32_t));
+  header.regrets_offset = align_section(header.actions_offset + header.n_edges * sizeof(float));
+  header.n_regrets = tree->round_offset(4) * header.n_clusters;
+  header.phi_offset = align_section(header.regrets_offset + header.n_regrets * sizeof(int));
+  header.n_phi = tree->round_offset(1) * header.phi_clusters;
+  size_t bytes = header.phi_offset + header.n_phi * sizeof(float);
+
+  int fd = open(fn.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0 || ftruncate(fd, bytes) != 0) {
+    if(fd >= 0) close(fd);
+    throw std::runtime_error("MappedSnapshot --- Cannot create " + fn);
+  }
+  void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(ptr == MAP_FAILED) throw std::runtime_error("MappedSnapshot --- mmap failed: " + fn);
+  char* out = static_cast<char*>(ptr);
+  std::memcpy(out, &header, sizeof(header));
+  std::memcpy(out + header.config_offset, config_blob.data(), config_blob.size());
+  std::memcpy(out + header.nodes_offset, tree->nodes().data(), header.n_nodes * sizeof(TreeNode));
+  std::memcpy(out + header.children_offset, tree->children().data(), header.n_edges * sizeof(uint32_t));
+  float* out_actions = reinterpret_cast<float*>(out + header.actions_offset);
+  for(size_t e_idx = 0; e_idx < header.n_edges; ++e_idx) out_actions[e_idx] = tree->edge_actions()[e_idx].get_bet_type();
+
+  // The file is zero-filled by ftruncate, so rows a lazy trainer never visited stay zero.
+  int* out_regrets = reinterpret_cast<int*>(out + header.regrets_offset);
+  float* out_phi = reinterpret_cast<float*>(out + header.phi_offset);
+  if(regrets.is_presized()) {
+    regrets.for_each([&](size_t idx, int value) { out_regrets[idx] = value; });
+    phi.for_each([&](size_t idx, float value) { out_phi[idx] = value; });
+  }
+  else {
+    tree->walk([&](const PokerState& state, const TreeNode& node) {
+      size_t regret_idx = regrets.find(state.get_action_history());
+      if(regret_idx != StrategyStorage<int>::NO_HISTORY) {
+        for(size_t v_idx = 0; v_idx < header.n_clusters * node.n_actions; ++v_idx) {
+          out_regrets[node.offset * header.n_clusters + v_idx] = regrets.get(regret_idx + v_idx);
+        }
+      }
+      if(node.round > 0) return;
+      size_t phi_idx = phi.find(state.get_action_history());
+      if(phi_idx != StrategyStorage<float>::NO_HISTORY) {
+        for(size_t v_idx = 0; v_idx < header.phi_clusters * node.n_actions; ++v_idx) {
+          out_phi[node.offset * header.phi_clusters + v_idx] = phi.get(phi_idx + v_idx);
+        }
+      }
+    });
+  }
+  msync(ptr, bytes, MS_SYNC);
+  munmap(ptr, bytes);
+}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <pluribus/poker.hpp>
+#include <pluribus/actions.hpp>
+#include <pluribus/tree.hpp>
+#include <pluribus/mccfr.hpp>
+
+namespace pluribus {
+
+// Flat, versioned snapshot layout. The header is followed by page aligned sections: the serialized config, the nodes,
+// child ids and actions of the game tree, which serve as history index, and the regret and average strategy arrays in
+// tree order. All sections are used in place, so opening a snapshot only maps the file and parses the config.
+struct MappedSnapshotHeader {
+  static constexpr char MAGIC[8] = {'P', 'L', 'R', 'B', 'S', 'N', 'A', 'P'};
+  static constexpr uint32_t VERSION = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t n_clusters;
+  uint32_t phi_clusters;
+  uint32_t node_bytes;
+  uint64_t config_offset;
+  uint64_t config_bytes;
+  uint64_t nodes_offset;
+  uint64_t n_nodes;
+  uint64_t children_offset;
+  uint64_t actions_offset;
+  uint64_t n_edges;
+  uint64_t regrets_offset;
+  uint64_t n_regrets;
+  uint64_t phi_offset;
+  uint64_t n_phi;
+};
+
+// Read-only view of a snapshot written by save_mapped. Pages are only read from disk when they are first accessed.
+class MappedSnapshot {
+public:
+  explicit MappedSnapshot(const std::string& fn);
+  MappedSnapshot(const MappedSnapshot&) = delete;
+  MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+  ~MappedSnapshot();
+
+  const BlueprintTrainerConfig& get_config() const { return _config; }
+  int n_clusters() const { return _header->n_clusters; }
+  int phi_clusters() const { return _header->phi_clusters; }
+  size_t n_regrets() const { return _header->n_regrets; }
+  size_t n_phi() const { return _header->n_phi; }
+  const int* regrets() const { return section<int>(_header->regrets_offset); }
+  const float* phi() const { return section<float>(_header->phi_offset); }
+
+  const TreeNode& root() const { return _nodes[0]; }
+  const TreeNode* child(const TreeNode& node, int a_idx) const {
+    uint32_t id = _children[node.edges + a_idx];
+    return id == GameTree::TERMINAL ? nullptr : &_nodes[id];
+  }
+  Action action(const TreeNode& node, int a_idx) const { return Action{_actions[node.edges + a_idx]}; }
+  const TreeNode* find(const ActionHistory& history) const;
+  size_t regret_index(const PokerState& state, int cluster, int action = 0) const {
+    const TreeNode& node = find_node(state);
+    return node.offset * n_clusters() + cluster * node.n_actions + action;
+  }
+  size_t phi_index(const PokerState& state, int cluster, int action = 0) const {
+    const TreeNode& node = find_node(state);
+    if(node.round > 0) throw std::runtime_error("MappedSnapshot --- Average strategy is only stored preflop.");
+    return node.offset * phi_clusters() + cluster * node.n_actions + action;
+  }
+
+  template <class F>
+  void walk(F&& f) const {
+    PokerState state = _config.init_state;
+    walk(state, root(), f);
+  }
+
+private:
+  template <class T>
+  const T* section(uint64_t offset) const { return reinterpret_cast<const T*>(static_cast<const char*>(_data) + offset); }
+  const TreeNode& find_node(const PokerState& state) const;
+
+  template <class F>
+  void walk(PokerState& state, const TreeNode& node, F& f) const {
+    f(state, node);
+    for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) {
+      const TreeNode* next = child(node, a_idx);
+      if(!next) continue;
+      StateDelta delta = state.apply_in_place(action(node, a_idx));
+      walk(state, *next, f);
+      state.undo(delta);
+    }
+  }
+
+  void* _data = nullptr;
+  size_t _bytes = 0;
+  const MappedSnapshotHeader* _header = nullptr;
+  const TreeNode* _nodes = nullptr;
+  const uint32_t* _children = nullptr;
+  const float* _actions = nullptr;
+  BlueprintTrainerConfig _config;
+};
+
+bool is_mapped_snapshot(const std::string& fn);
+
+// Writes the trainer in the mapped layout. Trainers without a compiled tree are laid out along the tree of their config,
+// rows missing from the history map are written as zeros.
+void save_mapped(const BlueprintTrainer& trainer, const std::string& fn);
+
+}
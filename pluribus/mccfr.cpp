@@ -6,14 +6,20 @@
 #include <algorithm>
 #include <stdexcept>
 #include <atomic>
+#include <thread>
+#include <chrono>
 #include <limits>
+#include <cmath>
+#include <cstring>
 #include <omp.h>
+#include <sys/wait.h>
 #include <tqdm/tqdm.hpp>
 #include <json/json.hpp>
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/unordered_map.hpp>
 #include <pluribus/util.hpp>
 #include <pluribus/rng.hpp>
+#include <pluribus/numa.hpp>
 #include <pluribus/debug.hpp>
 #include <pluribus/poker.hpp>
 #include <pluribus/cluster.hpp>
@@ -21,12 +27,27 @@
 #include <pluribus/traverse.hpp>
 #include <pluribus/debug.hpp>
 #include <pluribus/mccfr.hpp>
+#include <pluribus/compressed.hpp>
 
 namespace pluribus {
 
+int sample_action_idx(const float* freq, int n_actions) {
+  float sum = 0.0f;
+  int last_idx = 0;
+  for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+    sum += freq[a_idx];
+    if(freq[a_idx] > 0.0f) last_idx = a_idx;
+  }
+  float r = uniform_float(GlobalRNG::instance()) * sum;
+  for(int a_idx = 0; a_idx < last_idx; ++a_idx) {
+    r -= freq[a_idx];
+    if(r < 0.0f) return a_idx;
+  }
+  return last_idx;
+}
+
 int sample_action_idx(const std::vector<float>& freq) {
-  std::discrete_distribution<> dist(freq.begin(), freq.end());
-  return dist(GlobalRNG::instance());
+  return sample_action_idx(freq.data(), freq.size());
 }
 
 BlueprintTrainerConfig::BlueprintTrainerConfig(int n_players, int n_chips, int ante) 
@@ -51,6 +72,23 @@ std::string BlueprintTrainerConfig::to_string() const {
   oss << "Log interval: " << log_interval << "\n";
   oss << "Prune cutoff: " << prune_cutoff << "\n";
   oss << "Regret floor: " << regret_floor << "\n";
+  oss << "Compile tree: " << compile_tree << "\n";
+  oss << "Shared deal: " << shared_deal << "\n";
+  oss << "Huge pages: " << huge_pages << "\n";
+  oss << "Async snapshots: " << async_snapshots << "\n";
+  oss << "Seed: " << seed << "\n";
+  oss << "Public sampling: " << public_sampling << "\n";
+  oss << "NUMA: " << numa << "\n";
+  oss << "Sync interval: " << sync_interval << "\n";
+  oss << "Delta snapshots: " << delta_snapshots << "\n";
+  oss << "Snapshot shards: " << snapshot_shards << "\n";
+  oss << "Hot row values: " << hot_row_values << "\n";
+  oss << "Interleave: " << interleave << "\n";
+  oss << "Row sums: " << row_sums << "\n";
+  oss << "Reorder rows: " << reorder_rows << "\n";
+  oss << "Regret precision: ";
+  for(Precision p : regret_precision) oss << (p == Precision::INT32 ? "int32 " : p == Precision::INT16 ? "int16 " : "int8 ");
+  oss << "\n";
   oss << "Initial board: " << cards_to_str(init_board.data(), init_board.size()) << "\n";
   oss << "Initial state:\n" << init_state.to_string() << "\n";
   oss << "Initial ranges:\n";
@@ -60,10 +98,17 @@ std::string BlueprintTrainerConfig::to_string() const {
   return oss.str();
 }
 
-BlueprintTrainer::BlueprintTrainer(const BlueprintTrainerConfig& config, bool enable_wandb, const std::string& snapshot_dir, const std::string& metrics_dir) 
+BlueprintTrainer::BlueprintTrainer(const BlueprintTrainerConfig& config, bool enable_wandb, const std::string& snapshot_dir, const std::string& metrics_dir,
+                                   std::unique_ptr<Transport> transport) 
     : _regrets{config.action_profile, 200}, _phi{config.action_profile, 169}, _config{config}, _snapshot_dir{snapshot_dir}, 
-      _metrics_dir{metrics_dir}, _t{1} {
+      _metrics_dir{metrics_dir}, _t{1}, _metrics{std::make_unique<MetricsChannel>(omp_get_max_threads())}, 
+      _phi_buffers(omp_get_max_threads()), _transport{std::move(transport)} {
   if(_config.init_state.get_players().size() != config.poker.n_players) throw std::runtime_error("Player number mismatch");
+  if(_config.public_sampling && _config.poker.n_players != 2) {
+    throw std::runtime_error("BlueprintTrainer --- Public chance sampling requires two players.");
+  }
+  if(_transport && !_config.compile_tree) throw std::runtime_error("BlueprintTrainer --- Distributed training requires a compiled tree.");
+  init_tree();
   std::cout << "BlueprintTrainer --- Initializing HandIndexer... " << std::flush << (HandIndexer::get_instance() ? "Success.\n" : "Failure.\n");
   std::cout << "BlueprintTrainer --- Initializing FlatClusterMap... " << std::flush << (FlatClusterMap::get_instance() ? "Success.\n" : "Failure.\n");
   std::cout << _config.to_string() << "\n";
@@ -114,6 +159,55 @@ BlueprintTrainer::BlueprintTrainer(const BlueprintTrainerConfig& config, bool en
   }
 }
 
+void BlueprintTrainer::init_tree() {
+  _max_actions = _config.action_profile.max_actions();
+  if(_max_actions > MAX_ACTIONS) throw std::runtime_error("BlueprintTrainer --- Too many actions in the action profile.");
+  bool compact = std::any_of(_config.regret_precision.begin(), _config.regret_precision.end(), [](Precision p) {
+    return p != Precision::INT32;
+  });
+  if(compact && !_config.compile_tree) throw std::runtime_error("BlueprintTrainer --- Compact regrets require a compiled tree.");
+  if(_config.numa && !_config.compile_tree) throw std::runtime_error("BlueprintTrainer --- NUMA placement requires a compiled tree.");
+  if(_config.delta_snapshots > 0 && !_config.compile_tree) {
+    throw std::runtime_error("BlueprintTrainer --- Delta snapshots require a compiled tree.");
+  }
+  if(_config.hot_row_values > 0 && !_config.compile_tree) throw std::runtime_error("BlueprintTrainer --- Hot rows require a compiled tree.");
+  if(_config.reorder_rows && _config.compile_tree) throw std::runtime_error("BlueprintTrainer --- Row reordering requires lazy regrets.");
+  if(_config.row_sums && !_config.compile_tree) throw std::runtime_error("BlueprintTrainer --- Row sums require a compiled tree.");
+  if(_config.interleave > 1) {
+    if(!_config.compile_tree) throw std::runtime_error("BlueprintTrainer --- Interleaved traversals require a compiled tree.");
+    if(_config.public_sampling) throw std::runtime_error("BlueprintTrainer --- Interleaved traversals don't support public sampling.");
+  }
+  if(_config.compile_tree) {
+    std::cout << "BlueprintTrainer --- Compiling game tree... " << std::flush;
+    _regrets.set_precision(_config.regret_precision, _config.regret_floor);
+    _tree = std::unique_ptr<GameTree>{new GameTree{_config.init_state, _config.action_profile}};
+    std::cout << _tree->size() << " nodes.\n";
+    if(_transport) partition();
+    _regrets.allocate(*_tree, 3, _config.huge_pages, _config.numa);
+    _phi.allocate(*_tree, 0, _config.huge_pages, _config.numa);
+    std::cout << "BlueprintTrainer --- Allocated " << _regrets.n_allocated() << " regrets, " << _phi.n_allocated() << " phi.\n";
+    if(_config.row_sums) {
+      _row_sums = RowSums{*_tree, _regrets.n_clusters(), _config.regret_precision};
+      _row_sums.rebuild(_regrets, *_tree);
+      std::cout << "BlueprintTrainer --- Caching " << _row_sums.n_rows() << " row sums.\n";
+    }
+  }
+  else {
+    _tree = nullptr;
+  }
+}
+
+int BlueprintTrainer::node_actions(const PokerState& state, const TreeNode* node, Action* actions) const {
+  if(!node) return valid_actions(state, _config.action_profile, actions);
+  std::copy(_tree->actions(*node), _tree->actions(*node) + node->n_actions, actions);
+  return node->n_actions;
+}
+
+template <class T>
+size_t node_index(StrategyStorage<T>& storage, const PokerState& state, const TreeNode* node, int cluster, int action = 0) {
+  return node ? storage.index(*node, cluster, action) : storage.index(state, cluster, action);
+}
+
 bool are_full_ranges(const std::vector<PokerRange>& ranges) {
   PokerRange full_range = PokerRange::full();
   for(const auto& r : ranges) {
@@ -122,71 +216,155 @@ bool are_full_ranges(const std::vector<PokerRange>& ranges) {
   return true;
 }
 
+// Smallest number of iterations a worker claims at once. Guided scheduling hands out large chunks while many iterations 
+// remain and shrinks them towards the end of an interval, so workers rarely meet at the scheduler but still finish 
+// together.
+constexpr long MIN_CHUNK = 16;
+// Every HOT_SAMPLE-th iteration counts its regret updates per node, or per row of lazy regrets. Workers flush the deltas of hot rows every HOT_FLUSH 
+// of their iterations and at the end of every interval.
+constexpr long HOT_SAMPLE = 64;
+constexpr long HOT_FLUSH = 256;
+// Cache size that reordered layouts are compared with, roughly the last level cache of a server socket.
+constexpr size_t MODEL_CACHE_BYTES = size_t{1} << 25;
+
+void BlueprintTrainer::deal_cards(Deck& deck, Deal& deal, const omp::HandEvaluator& eval, bool full_ranges) const {
+  deck.reset();
+  deck.shuffle();
+  deal.board.deal(deck, _config.init_board);
+  if(full_ranges) {
+    for(auto& hand : deal.hands) hand.deal(deck);
+  }
+  else {
+    uint64_t dead_cards = 0;
+    for(uint8_t card : deal.board.cards()) dead_cards |= uint64_t{1} << card;
+    for(int p_idx = 0; p_idx < _config.poker.n_players; ++p_idx) {
+      deal.hands[p_idx] = _config.init_ranges[p_idx].sample_masked(dead_cards);
+      dead_cards |= uint64_t{1} << deal.hands[p_idx].cards()[0] | uint64_t{1} << deal.hands[p_idx].cards()[1];
+    }
+  }
+  deal.update_clusters();
+  deal.update_ranks(eval);
+}
+
+void BlueprintTrainer::run_iteration(long t, WorkerContext& worker, bool full_ranges) {
+  if(_verbose) std::cout << "============== t = " << t << " ==============\n";
+  GlobalRNG::seed(_config.seed, t);
+  worker.count_visits = (_config.hot_row_values > 0 || _config.reorder_rows) && t % HOT_SAMPLE == 0;
+  if(t % (_config.log_interval) == 0) queue_metrics(t);
+  for(int i = 0; i < _config.poker.n_players; ++i) {
+    if(_verbose) std::cout << "============== i = " << i << " ==============\n";
+    if(i == 0 || (!_config.shared_deal && !_config.public_sampling)) {
+      deal_cards(worker.deck, worker.deal, worker.eval, full_ranges);
+      if(_config.public_sampling) worker.public_deal.update(worker.deal.board, worker.eval);
+    }
+
+    worker.state = _config.init_state;
+    if(t % _config.strategy_interval == 0 && _frozen.empty()) {
+      if(_verbose) std::cout << "============== Updating strategy ==============\n";
+      update_strategy(worker.state, root_node(), i, worker.deal);
+    }
+    if(_config.public_sampling) {
+      if(_verbose) std::cout << "============== Traverse public chance sampling ==============\n";
+      traverse_public_chance(worker.state, i, worker.public_deal, worker);
+    }
+    else if(t > _config.prune_thresh) {
+      float q = uniform_float(GlobalRNG::instance());
+      if(q < 0.05f) {
+        if(_verbose) std::cout << "============== Traverse MCCFR ==============\n";
+        traverse_mccfr(worker.state, root_node(), i, worker.deal, worker.eval);
+      }
+      else {
+        if(_verbose) std::cout << "============== Traverse MCCFR-P ==============\n";
+        traverse_mccfr_p(worker.state, root_node(), i, worker.deal, worker.eval);
+      }
+    }
+    else {
+      if(_verbose) std::cout << "============== Traverse MCCFR ==============\n";
+      traverse_mccfr(worker.state, root_node(), i, worker.deal, worker.eval);
+    }
+  }
+}
+
 void BlueprintTrainer::mccfr_p(long T) {
   if(_verbose || _verbose_update) {
     std::cout << "Launched in verbose single threaded mode.\n";
     omp_set_num_threads(1);
   }
-  long next_discount = _config.discount_interval;
-  long next_snapshot = _config.preflop_threshold;
+  // Resumed runs continue the schedules after _t.
+  long next_discount = (_t / _config.discount_interval + 1) * _config.discount_interval;
+  if(_t > 0 && next_discount >= _config.lcfr_thresh) next_discount = T + 1;
+  long next_snapshot = _t < _config.preflop_threshold ? _config.preflop_threshold : 
+                       _config.preflop_threshold + ((_t - _config.preflop_threshold) / _config.snapshot_interval + 1) * _config.snapshot_interval;
+  long next_sync = _transport ? _t + _config.sync_interval : T;
   bool full_ranges = are_full_ranges(_config.init_ranges);
+  bool interleaved = _config.interleave > 1 && !_verbose && !_verbose_update;
   std::cout << "Full ranges: " << full_ranges << "\n";
   std::cout << "Training blueprint from " << _t << " to " << std::to_string(T) << "\n";
+  if(_config.numa) {
+    int n_nodes = n_numa_nodes();
+    #pragma omp parallel
+    pin_to_node(omp_get_thread_num() % n_nodes);
+    std::vector<size_t> regret_pages = _regrets.placement();
+    std::vector<size_t> phi_pages = _phi.placement();
+    int n_threads = omp_get_max_threads();
+    std::cout << std::setprecision(1) << std::fixed;
+    std::cout << "NUMA nodes: " << n_nodes << "\n";
+    std::cout << "Regret pages: " << placement_str(regret_pages) << " (" << 100.0 * remote_ratio(regret_pages, n_threads) << "% remote)\n";
+    std::cout << "Phi pages: " << placement_str(phi_pages) << " (" << 100.0 * remote_ratio(phi_pages, n_threads) << "% remote)\n";
+  }
+  start_metrics();
+  if(_phi_buffers.size() < omp_get_max_threads()) _phi_buffers.resize(omp_get_max_threads());
+  if(_replica_buffers.size() < omp_get_max_threads()) _replica_buffers.resize(omp_get_max_threads());
+  if(_workers.size() < omp_get_max_threads()) _workers.resize(omp_get_max_threads());
+  if(_transport) {
+    std::cout << "Rank " << _transport->rank() << " of " << _transport->size() << ", " << _regrets.n_allocated() << "/" 
+              << _regrets.size() << " regrets allocated, " << _row_cache.capacity() << " cached\n";
+  }
+  if(_t >= _config.preflop_threshold && _frozen.empty()) freeze_preflop();
+  if(_config.public_sampling) {
+    _range_weights.resize(_config.poker.n_players);
+    for(int p_idx = 0; p_idx < _config.poker.n_players; ++p_idx) {
+      for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+        _range_weights[p_idx][h_idx] = _config.init_ranges[p_idx].frequency(PublicDeal::hands()[h_idx]);
+      }
+    }
+  }
   while(_t < T) {
     long init_t = _t;
-    _t = std::min(std::min(next_discount, next_snapshot), T);
+    _t = std::min({next_discount, next_snapshot, next_sync, T});
     auto interval_start = std::chrono::high_resolution_clock::now();
     std::cout << std::setprecision(1) << std::fixed << "Next step: " << _t / 1'000'000.0 << "M\n";
-    #pragma omp parallel for schedule(dynamic, 1)
-    for(long t = init_t; t < _t; ++t) {
-      thread_local omp::HandEvaluator eval;
-      thread_local Deck deck{_config.init_board};
-      thread_local Board board;
-      thread_local std::vector<Hand> hands{static_cast<size_t>(_config.poker.n_players)};
-      if(_verbose) std::cout << "============== t = " << t << " ==============\n";
-      if(t % (_config.log_interval) == 0) log_metrics(t);
-      for(int i = 0; i < _config.poker.n_players; ++i) {
-        if(_verbose) std::cout << "============== i = " << i << " ==============\n";
-        deck.shuffle();
-        board.deal(deck, _config.init_board);
-        if(full_ranges) {
-          for(auto& hand : hands) hand.deal(deck);
-        }
-        else {
-          std::unordered_set<uint8_t> dead_cards;
-          std::copy(board.cards().begin(), board.cards().end(), std::inserter(dead_cards, dead_cards.end()));
-          for(int p_idx = 0; p_idx < _config.poker.n_players; ++p_idx) {
-            hands[p_idx] = _config.init_ranges[p_idx].sample(dead_cards);
-            dead_cards.insert(hands[p_idx].cards()[0]);
-            dead_cards.insert(hands[p_idx].cards()[1]);
-          }
-        }
-
-        if(t % _config.strategy_interval == 0) {
-          if(_verbose) std::cout << "============== Updating strategy ==============\n";
-          update_strategy(_config.init_state, i, board, hands);
-        }
-        if(t > _config.prune_thresh) {
-          std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-          float q = dist(GlobalRNG::instance());
-          if(q < 0.05f) {
-            if(_verbose) std::cout << "============== Traverse MCCFR ==============\n";
-            traverse_mccfr(_config.init_state, i, board, hands, eval);
-          }
-          else {
-            if(_verbose) std::cout << "============== Traverse MCCFR-P ==============\n";
-            traverse_mccfr_p(_config.init_state, i, board, hands, eval);
-          }
-        }
-        else {
-          if(_verbose) std::cout << "============== Traverse MCCFR ==============\n";
-          traverse_mccfr(_config.init_state, i, board, hands, eval);
+    std::atomic<long> next_t = init_t;
+    #pragma omp parallel
+    {
+      // Contexts are created by their worker, so their pages are local to its NUMA node.
+      auto& worker = _workers[omp_get_thread_num()];
+      if(!worker) worker = std::make_unique<WorkerContext>(_config);
+      if(worker->hot_deltas.size() != _hot_rows.n_values()) worker->hot_deltas.assign(_hot_rows.n_values(), 0);
+      if(interleaved) {
+        run_interleaved(next_t, _t, *worker, full_ranges);
+      }
+      else {
+        #pragma omp for schedule(guided, MIN_CHUNK)
+        for(long t = init_t; t < _t; ++t) {
+          if(_transport && t % _transport->size() != _transport->rank()) continue;
+          run_iteration(t, *worker, full_ranges);
+          if(worker->count_visits) merge_visits(*worker);
+          if(!_hot_rows.empty() && ++worker->n_iterations % HOT_FLUSH == 0) flush_hot(*worker);
         }
       }
+      if(!_hot_rows.empty()) flush_hot(*worker);
     }
     
     auto interval_end = std::chrono::high_resolution_clock::now();
     std::cout << "Step duration: " << std::chrono::duration_cast<std::chrono::seconds>(interval_end - interval_start).count() << " s.\n";
+    if(_config.hot_row_values > 0 && !_transport) select_hot_rows((_t - init_t) / HOT_SAMPLE);
+    merge_phi();
+    if(_transport) {
+      sync_replicas();
+      next_sync = _t + _config.sync_interval;
+    }
+    flush_metrics();
     if(_t == next_discount) {
       std::cout << "============== Discounting ==============\n";
       long discount_interval = _config.discount_interval;
@@ -194,73 +372,388 @@ void BlueprintTrainer::mccfr_p(long T) {
       std::cout << std::setprecision(2) << std::fixed << "Discount factor: " << d << "\n";
       lcfr_discount(_regrets, d);
       lcfr_discount(_phi, d);
+      if(_transport) _row_cache.discount(d);
+      for(auto& counter : _metrics->positive_regret) counter.value.store(counter.value.load() * d);
       next_discount = next_discount + discount_interval < _config.lcfr_thresh ? next_discount + discount_interval : T + 1;
     }
+    _regrets.rescale();
     if(_t == next_snapshot) {
+      // Whether the previous snapshot succeeded decides if this one can be a delta.
+      reap_snapshot(true);
       std::ostringstream fn_stream;
+      bool delta = _t != _config.preflop_threshold && _n_deltas >= 0 && _n_deltas < _config.delta_snapshots;
       if(_t == _config.preflop_threshold) {
         std::cout << "============== Saving & freezing preflop strategy ==============\n";
-        fn_stream << date_time_str() << "_preflop.bin";
+        fn_stream << date_time_str() << "_preflop" << rank_suffix() << ".bin";
       }
       else {
         std::cout << "============== Saving snapshot ==============\n";
-        fn_stream << date_time_str() << "_t" << std::setprecision(1) << std::fixed << _t / 1'000'000.0 << "M.bin";
+        fn_stream << date_time_str() << "_t" << std::setprecision(1) << std::fixed << _t / 1'000'000.0 << "M" << rank_suffix() 
+                  << (delta ? "_delta" : "") << ".bin";
       }
-      cereal_save(*this, (_snapshot_dir / fn_stream.str()).string());
+      save_snapshot((_snapshot_dir / fn_stream.str()).string(), delta);
+      if(_t == _config.preflop_threshold) freeze_preflop();
+      if(_config.reorder_rows && !_transport) reorder_regrets();
       next_snapshot += _config.snapshot_interval;
     }
+    reap_snapshot(false);
   }
 
+  stop_metrics();
+  reap_snapshot(true);
   std::cout << "============== Blueprint training complete ==============\n";
   std::ostringstream oss;
   oss << date_time_str() << _config.poker.n_players << "p_" << _config.poker.n_chips / 100 << "bb_" << _config.poker.ante << "ante_"
-      << std::setprecision(1) << std::fixed << T / 1'000'000'000.0 << "B.bin";
-  cereal_save(*this, oss.str());
+      << std::setprecision(1) << std::fixed << T / 1'000'000'000.0 << "B" << rank_suffix() << ".bin";
+  if(_config.snapshot_shards > 0) save_compressed(oss.str(), _config.snapshot_shards);
+  else cereal_save(*this, oss.str());
 }
 
-std::vector<float> get_freq(const PokerState& state, const Board& board, const Hand& hand, 
-                            int n_actions, StrategyStorage<int>& regrets) {
-  int cluster = FlatClusterMap::get_instance()->cluster(state.get_round(), board, hand);
-  size_t base_idx = regrets.index(state, cluster);
-  return calculate_strategy(regrets, base_idx, n_actions);
+long positive_sum(const int* regrets, int n_actions) {
+  long sum = 0;
+  for(int a_idx = 0; a_idx < n_actions; ++a_idx) sum += std::max(regrets[a_idx], 0);
+  return sum;
 }
 
-int BlueprintTrainer::traverse_mccfr_p(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, 
-                                       const omp::HandEvaluator& eval) {
+void BlueprintTrainer::store_regrets(const TreeNode* node, int cluster, size_t base_idx, int n_actions, const int* regrets, 
+                                     long prev_positive) {
+  if(_transport && !_regrets.owns_row(base_idx, n_actions)) {
+    // Rows without room in the cache were read as zero, so their values are deltas.
+    if(!_row_cache.store(base_idx, n_actions, regrets)) _replica_buffers[omp_get_thread_num()].deltas.add_row(base_idx, n_actions, regrets);
+  }
+  else {
+    _regrets.store_row(base_idx, n_actions, regrets);
+    if(_transport) _changed.mark(base_idx, n_actions);
+  }
+  if(!node) count_row_visit(base_idx);
+  long next_positive = positive_sum(regrets, n_actions);
+  add_positive_regret(next_positive - prev_positive);
+  if(!_row_sums.empty()) {
+    long slot = _row_sums.slot(_tree->id(*node), cluster);
+    if(slot >= 0) _row_sums.store(slot, next_positive);
+  }
+}
+
+// Samples an action of an opponent node. Cached rows are sampled from their positive regret sum in a single pass, other 
+// rows from their regret matched strategy.
+int BlueprintTrainer::sample_action(const TreeNode* node, int cluster, size_t base_idx, int n_actions) const {
+  long slot = !_row_sums.empty() && node && !_frozen.contains(base_idx) ? _row_sums.slot(_tree->id(*node), cluster) : -1;
+  if(slot >= 0) {
+    std::array<int, MAX_ACTIONS> regrets;
+    load_regrets(base_idx, n_actions, regrets.data());
+    int a_idx = _row_sums.sample(slot, regrets.data(), n_actions, uniform_float(GlobalRNG::instance()));
+    if(a_idx >= 0) return a_idx;
+  }
+  std::array<float, MAX_ACTIONS> freq;
+  strategy(base_idx, n_actions, freq.data());
+  return sample_action_idx(freq.data(), n_actions);
+}
+
+// Adds values[a_idx] - v to the regret of every explored action of a traverser node.
+void BlueprintTrainer::update_regrets(const TreeNode* node, int cluster, size_t base_idx, int n_actions, const int* values, 
+                                      int v, const bool* explored) {
+  count_visit(node);
+  if(long* hot = hot_deltas(base_idx)) {
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      if(explored[a_idx]) hot[a_idx] += values[a_idx] - v;
+    }
+    return;
+  }
+  std::array<int, MAX_ACTIONS> regrets;
+  load_regrets(base_idx, n_actions, regrets.data());
+  long prev_positive = positive_sum(regrets.data(), n_actions);
+  for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+    if(explored[a_idx]) {
+      int next_r = regrets[a_idx] + values[a_idx] - v;
+      if(next_r > 2'000'000'000) throw std::runtime_error("Regret overflowing!");
+      regrets[a_idx] = std::max(next_r, _config.regret_floor);
+    }
+  }
+  store_regrets(node, cluster, base_idx, n_actions, regrets.data(), prev_positive);
+}
+
+int BlueprintTrainer::traverse_mccfr_p(PokerState& state, const TreeNode* node, int i, const Deal& deal, const omp::HandEvaluator& eval) {
   if(state.is_terminal() || state.get_players()[i].has_folded()) {
-    return utility(state, i, board, hands, eval);
+    return utility(state, i, deal, eval);
   }
   else if(state.get_active() == i) {
-    auto actions = valid_actions(state, _config.action_profile);
-    int cluster = FlatClusterMap::get_instance()->cluster(state.get_round(), board, hands[i]);
-    size_t base_idx = _regrets.index(state, cluster);
-    auto freq = calculate_strategy(_regrets, base_idx, actions.size());
+    std::array<Action, MAX_ACTIONS> actions;
+    std::array<float, MAX_ACTIONS> freq;
+    std::array<int, MAX_ACTIONS> values;
+    std::array<bool, MAX_ACTIONS> explored;
+    int n_actions = node_actions(state, node, actions.data());
+    int cluster = deal.cluster(i, state.get_round());
+    size_t base_idx = node_index(_regrets, state, node, cluster);
+    strategy(base_idx, n_actions, freq.data());
+
+    bool frozen = _frozen.contains(base_idx);
+    std::array<int, MAX_ACTIONS> regrets;
+    if(!frozen) load_regrets(base_idx, n_actions, regrets.data());
+    int v = 0;
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      explored[a_idx] = frozen ? !_frozen.pruned(base_idx + a_idx) : regrets[a_idx] > _config.prune_cutoff;
+      if(explored[a_idx]) {
+        StateDelta delta = state.apply_in_place(actions[a_idx]);
+        values[a_idx] = traverse_mccfr_p(state, next_node(node, a_idx), i, deal, eval);
+        state.undo(delta);
+        v += freq[a_idx] * values[a_idx];
+      }
+    }
+    if(!frozen) update_regrets(node, cluster, base_idx, n_actions, values.data(), v, explored.data());
+    return v;
+  }
+  else {
+    std::array<Action, MAX_ACTIONS> actions;
+    int n_actions = node_actions(state, node, actions.data());
+    int cluster = deal.cluster(state.get_active(), state.get_round());
+    int a_idx = sample_action(node, cluster, node_index(_regrets, state, node, cluster), n_actions);
+    StateDelta delta = state.apply_in_place(actions[a_idx]);
+    int v = traverse_mccfr_p(state, next_node(node, a_idx), i, deal, eval);
+    state.undo(delta);
+    return v;
+  }
+}
 
-    std::unordered_map<Action, int> values;
+// Keeps config.interleave iterations in flight on the calling worker. Iterations run as coroutines which prefetch the 
+// regret row of every node and yield before reading it. Lanes are resumed round-robin, so a row has usually arrived by 
+// the time its traversal continues. Iterations are claimed in chunks of MIN_CHUNK from next_t.
+void BlueprintTrainer::run_interleaved(std::atomic<long>& next_t, long end_t, WorkerContext& worker, bool full_ranges) {
+  while(worker.lanes.size() < _config.interleave) worker.lanes.push_back(std::make_unique<TraversalLane>(_config));
+  long claim_t = 0, claim_end = 0;
+  auto next_iteration = [&]() {
+    while(true) {
+      if(claim_t == claim_end) {
+        claim_t = next_t.fetch_add(MIN_CHUNK, std::memory_order_relaxed);
+        if(claim_t >= end_t) {
+          claim_t = claim_end;
+          return -1L;
+        }
+        claim_end = std::min(claim_t + MIN_CHUNK, end_t);
+      }
+      long t = claim_t++;
+      if(!_transport || t % _transport->size() == _transport->rank()) return t;
+    }
+  };
+  auto start = [&](TraversalLane& lane) {
+    long t = next_iteration();
+    if(t >= 0) lane.task = lane.spawn([&]() { return interleaved_iteration(t, lane, worker, full_ranges); });
+    return t >= 0;
+  };
+
+  int n_active = 0;
+  for(auto& lane : worker.lanes) n_active += start(*lane);
+  while(n_active > 0) {
+    for(auto& lane : worker.lanes) {
+      if(!lane->resume_point) continue;
+      std::swap(GlobalRNG::instance(), lane->rng);
+      worker.count_visits = lane->count_visits;
+      lane->resume();
+      std::swap(GlobalRNG::instance(), lane->rng);
+      if(!lane->task.done()) continue;
+      lane->task.result();
+      lane->task.reset();
+      if(lane->count_visits) merge_visits(worker);
+      if(!_hot_rows.empty() && ++worker.n_iterations % HOT_FLUSH == 0) flush_hot(worker);
+      if(!start(*lane)) --n_active;
+    }
+  }
+}
+
+Task<> BlueprintTrainer::interleaved_iteration(long t, TraversalLane& lane, WorkerContext& worker, bool full_ranges) {
+  GlobalRNG::seed(_config.seed, t);
+  lane.count_visits = worker.count_visits = (_config.hot_row_values > 0 || _config.reorder_rows) && t % HOT_SAMPLE == 0;
+  if(t % (_config.log_interval) == 0) queue_metrics(t);
+  for(int i = 0; i < _config.poker.n_players; ++i) {
+    if(i == 0 || !_config.shared_deal) deal_cards(lane.deck, lane.deal, worker.eval, full_ranges);
+    lane.state = _config.init_state;
+    if(t % _config.strategy_interval == 0 && _frozen.empty()) update_strategy(lane.state, root_node(), i, lane.deal);
+    bool prune = t > _config.prune_thresh && uniform_float(GlobalRNG::instance()) >= 0.05f;
+    co_await traverse_interleaved(lane.state, root_node(), i, lane.deal, worker.eval, prune);
+  }
+}
+
+// Same traversal as traverse_mccfr_p with pruning and as traverse_mccfr without.
+Task<int> BlueprintTrainer::traverse_interleaved(PokerState& state, const TreeNode* node, int i, const Deal& deal, 
+                                                 const omp::HandEvaluator& eval, bool prune) {
+  if(state.is_terminal() || state.get_players()[i].has_folded()) co_return utility(state, i, deal, eval);
+  std::array<Action, MAX_ACTIONS> actions;
+  std::array<float, MAX_ACTIONS> freq;
+  int n_actions = node_actions(state, node, actions.data());
+  int cluster = deal.cluster(state.get_active(), state.get_round());
+  size_t base_idx = _regrets.index(*node, cluster);
+  if(!_frozen.contains(base_idx)) {
+    prefetch_regrets(base_idx);
+    co_await yield_lane();
+  }
+  if(state.get_active() == i) {
+    strategy(base_idx, n_actions, freq.data());
+    std::array<int, MAX_ACTIONS> values;
+    std::array<bool, MAX_ACTIONS> explored;
+    bool frozen = _frozen.contains(base_idx);
+    if(prune && !frozen) {
+      std::array<int, MAX_ACTIONS> regrets;
+      load_regrets(base_idx, n_actions, regrets.data());
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) explored[a_idx] = regrets[a_idx] > _config.prune_cutoff;
+    }
+    else {
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) explored[a_idx] = !prune || !_frozen.pruned(base_idx + a_idx);
+    }
     int v = 0;
-    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
-      Action a = actions[a_idx];
-      if(_regrets[base_idx + a_idx].load() > _config.prune_cutoff) {
-        int v_a = traverse_mccfr_p(state.apply(a), i, board, hands, eval);
-        values[a] = v_a;
-        v += freq[a_idx] * v_a;
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      if(explored[a_idx]) {
+        StateDelta delta = state.apply_in_place(actions[a_idx]);
+        values[a_idx] = co_await traverse_interleaved(state, next_node(node, a_idx), i, deal, eval, prune);
+        state.undo(delta);
+        v += freq[a_idx] * values[a_idx];
+      }
+    }
+    if(!frozen) update_regrets(node, cluster, base_idx, n_actions, values.data(), v, explored.data());
+    co_return v;
+  }
+  else {
+    int a_idx = sample_action(node, cluster, base_idx, n_actions);
+    StateDelta delta = state.apply_in_place(actions[a_idx]);
+    int v = co_await traverse_interleaved(state, next_node(node, a_idx), i, deal, eval, prune);
+    state.undo(delta);
+    co_return v;
+  }
+}
+
+void BlueprintTrainer::traverse_public_chance(PokerState& state, int i, const PublicDeal& deal, WorkerContext& worker) {
+  float reach[N_HANDS];
+  float values[N_HANDS];
+  float total = 0.0f;
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+    reach[h_idx] = deal.blocked[h_idx] ? 0.0f : _range_weights[1 - i][h_idx];
+    total += reach[h_idx];
+  }
+  if(total == 0.0f) return;
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) reach[h_idx] /= total;
+  traverse_pcs(state, root_node(), i, deal, reach, values, worker, 0);
+}
+
+PcsFrame& BlueprintTrainer::pcs_frame(WorkerContext& worker, int depth) const {
+  while(worker.pcs_frames.size() <= depth) {
+    worker.pcs_frames.push_back(std::make_unique<PcsFrame>(_max_actions, _regrets.n_clusters()));
+  }
+  return *worker.pcs_frames[depth];
+}
+
+// frame.freq[a_idx * N_HANDS + h_idx] is the probability of action a_idx with combination h_idx. Combinations of one cluster
+// share a row, so each row is loaded once.
+void BlueprintTrainer::hand_strategies(const PokerState& state, const TreeNode* node, const PublicDeal& deal, int n_actions, 
+                                       PcsFrame& frame) {
+  int round = state.get_round();
+  float* freq = frame.freq.data();
+  float* cluster_freq = frame.cluster_freq.data();
+  uint8_t* ready = frame.ready.data();
+  std::fill(frame.ready.begin(), frame.ready.end(), 0);
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+    if(deal.blocked[h_idx]) {
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) freq[a_idx * N_HANDS + h_idx] = 0.0f;
+      continue;
+    }
+    int cluster = deal.cluster(h_idx, round);
+    if(!ready[cluster]) {
+      strategy(node_index(_regrets, state, node, cluster), n_actions, cluster_freq + cluster * n_actions);
+      ready[cluster] = true;
+    }
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) freq[a_idx * N_HANDS + h_idx] = cluster_freq[cluster * n_actions + a_idx];
+  }
+}
+
+// Public chance sampling: values[h_idx] is the counterfactual value of the traverser holding h_idx, given the reach of 
+// every opponent combination. Regrets of a cluster get the summed regrets of its combinations, weighted by the initial 
+// range of the traverser.
+void BlueprintTrainer::traverse_pcs(PokerState& state, const TreeNode* node, int i, const PublicDeal& deal, const float* reach, 
+                                    float* values, WorkerContext& worker, int depth) {
+  if(state.is_terminal() || state.get_players()[i].has_folded()) {
+    const Player& player = state.get_players()[i];
+    float base = player.get_chips() - _config.poker.n_chips;
+    if(player.has_folded() || state.get_winner() != -1) {
+      deal.fold_values(reach, base + (state.get_winner() == i ? state.get_pot() : 0), values);
+    }
+    else {
+      deal.showdown_values(reach, base, state.get_pot(), values);
+    }
+    return;
+  }
+
+  std::array<Action, MAX_ACTIONS> actions;
+  int n_actions = node_actions(state, node, actions.data());
+  PcsFrame& frame = pcs_frame(worker, depth);
+  hand_strategies(state, node, deal, n_actions, frame);
+  const float* freq = frame.freq.data();
+  if(state.get_active() == i) {
+    float* action_values = frame.action_values.data();
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      StateDelta delta = state.apply_in_place(actions[a_idx]);
+      traverse_pcs(state, next_node(node, a_idx), i, deal, reach, action_values + a_idx * N_HANDS, worker, depth + 1);
+      state.undo(delta);
+    }
+    std::fill(values, values + N_HANDS, 0.0f);
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      const float* f = freq + a_idx * N_HANDS;
+      const float* v = action_values + a_idx * N_HANDS;
+      #pragma omp simd
+      for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) values[h_idx] += f[h_idx] * v[h_idx];
+    }
+    if(_frozen.contains(node_index(_regrets, state, node, 0))) return;
+    count_visit(node);
+
+    int round = state.get_round();
+    int n_clusters = _regrets.n_clusters();
+    float* deltas = frame.deltas.data();
+    uint8_t* touched = frame.touched.data();
+    std::fill(deltas, deltas + n_clusters * n_actions, 0.0f);
+    std::fill(touched, touched + n_clusters, 0);
+    const auto& weights = _range_weights[i];
+    for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+      if(deal.blocked[h_idx] || weights[h_idx] == 0.0f) continue;
+      int cluster = deal.cluster(h_idx, round);
+      touched[cluster] = 1;
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        deltas[cluster * n_actions + a_idx] += weights[h_idx] * (action_values[a_idx * N_HANDS + h_idx] - values[h_idx]);
       }
     }
-    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
-      Action a = actions[a_idx];
-      if(values.find(a) != values.end()) {
-        int next_r = _regrets[base_idx + a_idx].load() + values[a] - v;
+    for(int cluster = 0; cluster < n_clusters; ++cluster) {
+      if(!touched[cluster]) continue;
+      size_t base_idx = node_index(_regrets, state, node, cluster);
+      if(long* hot = hot_deltas(base_idx)) {
+        for(int a_idx = 0; a_idx < n_actions; ++a_idx) hot[a_idx] += std::lround(deltas[cluster * n_actions + a_idx]);
+        continue;
+      }
+      std::array<int, MAX_ACTIONS> regrets;
+      load_regrets(base_idx, n_actions, regrets.data());
+      long prev_positive = positive_sum(regrets.data(), n_actions);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        long next_r = regrets[a_idx] + std::lround(deltas[cluster * n_actions + a_idx]);
         if(next_r > 2'000'000'000) throw std::runtime_error("Regret overflowing!");
-        _regrets[base_idx + a_idx].store(std::max(next_r, _config.regret_floor));
+        regrets[a_idx] = std::max<long>(next_r, _config.regret_floor);
       }
+      store_regrets(node, cluster, base_idx, n_actions, regrets.data(), prev_positive);
     }
-    return v;
   }
   else {
-    auto actions = valid_actions(state, _config.action_profile);
-    auto freq = get_freq(state, board, hands[state.get_active()], actions.size(), _regrets);
-    Action a = actions[sample_action_idx(freq)];
-    return traverse_mccfr_p(state.apply(a), i, board, hands, eval);
+    float* child_reach = frame.child_reach.data();
+    float* child_values = frame.child_values.data();
+    std::fill(values, values + N_HANDS, 0.0f);
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      const float* f = freq + a_idx * N_HANDS;
+      float reach_sum = 0.0f;
+      #pragma omp simd reduction(+:reach_sum)
+      for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+        child_reach[h_idx] = reach[h_idx] * f[h_idx];
+        reach_sum += child_reach[h_idx];
+      }
+      // Values are linear in the reach of the opponent, unreached subtrees contribute nothing.
+      if(reach_sum == 0.0f) continue;
+      StateDelta delta = state.apply_in_place(actions[a_idx]);
+      traverse_pcs(state, next_node(node, a_idx), i, deal, child_reach, child_values, worker, depth + 1);
+      state.undo(delta);
+      #pragma omp simd
+      for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) values[h_idx] += child_values[h_idx];
+    }
   }
 }
 
@@ -268,14 +761,14 @@ std::string relative_history_str(const PokerState& state, const BlueprintTrainer
   return state.get_action_history().slice(config.init_state.get_action_history().size()).to_string();
 }
 
-int BlueprintTrainer::traverse_mccfr(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval) {
+int BlueprintTrainer::traverse_mccfr(PokerState& state, const TreeNode* node, int i, const Deal& deal, const omp::HandEvaluator& eval) {
   if(state.is_terminal() || state.get_players()[i].has_folded()) {
-    int u = utility(state, i, board, hands, eval);
+    int u = utility(state, i, deal, eval);
     if(_verbose) {
       std::cout << "Terminal: " << relative_history_str(state, _config) << "\n";
       std::cout << "\tHands: ";
       for(int p_idx = 0; p_idx < state.get_players().size(); ++p_idx) {
-        std::cout << hands[p_idx].to_string() << " ";
+        std::cout << deal.hands[p_idx].to_string() << " ";
       }
       std::cout << "\n";
       std::cout << "\tu(z) = " << u << "\n";
@@ -283,91 +776,574 @@ int BlueprintTrainer::traverse_mccfr(const PokerState& state, int i, const Board
     return u;
   }
   else if(state.get_active() == i) {
-    auto actions = valid_actions(state, _config.action_profile);
-    int cluster = FlatClusterMap::get_instance()->cluster(state.get_round(), board, hands[i]);
+    std::array<Action, MAX_ACTIONS> actions;
+    std::array<float, MAX_ACTIONS> freq;
+    std::array<int, MAX_ACTIONS> values;
+    int n_actions = node_actions(state, node, actions.data());
+    int cluster = deal.cluster(i, state.get_round());
     if(_verbose) std::cout << "Cluster " << state.get_active() << ": " << cluster << "\n";
-    size_t base_idx = _regrets.index(state, cluster);
-    auto freq = calculate_strategy(_regrets, base_idx, actions.size());
+    size_t base_idx = node_index(_regrets, state, node, cluster);
+    strategy(base_idx, n_actions, freq.data());
 
-    std::unordered_map<Action, int> values;
     int v = 0;
-    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
-      Action a = actions[a_idx];
-      int v_a = traverse_mccfr(state.apply(a), i, board, hands, eval);
-      values[a] = v_a;
-      v += freq[a_idx] * v_a;
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      StateDelta delta = state.apply_in_place(actions[a_idx]);
+      values[a_idx] = traverse_mccfr(state, next_node(node, a_idx), i, deal, eval);
+      state.undo(delta);
+      v += freq[a_idx] * values[a_idx];
       if(_verbose) {
         std::cout << "Action EV: " << relative_history_str(state, _config) << "\n";
-        std::cout << "\tu(" << a.to_string() << ") @ " << std::setprecision(2) << std::fixed << freq[a_idx] << " = " << v_a << "\n";
+        std::cout << "\tu(" << actions[a_idx].to_string() << ") @ " << std::setprecision(2) << std::fixed << freq[a_idx] << " = " << values[a_idx] << "\n";
       }
     }
     if(_verbose) {
       std::cout << "Net EV: " << relative_history_str(state, _config) << "\n";
       std::cout << "\tu(sigma) = " << v << "\n";
     }
-    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
-      int dR = values[actions[a_idx]] - v;
-      int next_r = _regrets[base_idx + a_idx].load() + dR;
+    if(_frozen.contains(base_idx)) return v;
+    count_visit(node);
+    if(long* hot = hot_deltas(base_idx)) {
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) hot[a_idx] += values[a_idx] - v;
+      return v;
+    }
+    std::array<int, MAX_ACTIONS> regrets;
+    load_regrets(base_idx, n_actions, regrets.data());
+    long prev_positive = positive_sum(regrets.data(), n_actions);
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      int dR = values[a_idx] - v;
+      int next_r = regrets[a_idx] + dR;
       if(next_r > 2'000'000'000) throw std::runtime_error("Regret overflowing!");
-      _regrets[base_idx + a_idx].store(std::max(next_r, _config.regret_floor));
+      regrets[a_idx] = std::max(next_r, _config.regret_floor);
       if(_verbose) {
         std::cout << "\tR(" << actions[a_idx].to_string() << ") = " << dR << "\n";
-        std::cout << "\tcum R(" << actions[a_idx].to_string() << ") = " << _regrets[base_idx + a_idx].load() << "\n";
+        std::cout << "\tcum R(" << actions[a_idx].to_string() << ") = " << regrets[a_idx] << "\n";
       }
     }
+    store_regrets(node, cluster, base_idx, n_actions, regrets.data(), prev_positive);
     return v;
   }
   else {
-    auto actions = valid_actions(state, _config.action_profile);
-    auto freq = get_freq(state, board, hands[state.get_active()], actions.size(), _regrets);
+    std::array<Action, MAX_ACTIONS> actions;
+    std::array<float, MAX_ACTIONS> freq;
+    int n_actions = node_actions(state, node, actions.data());
+    int cluster = deal.cluster(state.get_active(), state.get_round());
+    size_t base_idx = node_index(_regrets, state, node, cluster);
+    int a_idx;
     if(_verbose) {
+      strategy(base_idx, n_actions, freq.data());
       std::cout << "Sampling: " << relative_history_str(state, _config) << "\n\t";
-      for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
         std::cout << std::setprecision(2) << std::fixed << actions[a_idx].to_string() << "=" << freq[a_idx] << " ";
       }
       std::cout << "\n";
+      a_idx = sample_action_idx(freq.data(), n_actions);
+    }
+    else {
+      a_idx = sample_action(node, cluster, base_idx, n_actions);
     }
-    Action a = actions[sample_action_idx(freq)];
+    Action a = actions[a_idx];
     if(_verbose) std::cout << "\tSampled: " << a.to_string() << "\n";
-    return traverse_mccfr(state.apply(a), i, board, hands, eval);
+    StateDelta delta = state.apply_in_place(a);
+    int v = traverse_mccfr(state, next_node(node, a_idx), i, deal, eval);
+    state.undo(delta);
+    return v;
   }
 }
 
-void BlueprintTrainer::update_strategy(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands) {
+void BlueprintTrainer::update_strategy(PokerState& state, const TreeNode* node, int i, const Deal& deal) {
   if(state.get_winner() != -1 || state.get_round() > 0 || state.get_players()[i].has_folded()) {
     return;
   }
   else if(state.get_active() == i) {
-    auto actions = valid_actions(state, _config.action_profile);
-    int cluster = FlatClusterMap::get_instance()->cluster(state.get_round(), board, hands[i]);
-    if(hands[i].cards()[0] % 4 == hands[i].cards()[1] % 4 && cluster < 91) {
-      throw std::runtime_error("Bad cluster for suited hand: " + hands[i].to_string());
-    }
-    size_t regret_base_idx = _regrets.index(state, cluster);
-    auto freq = calculate_strategy(_regrets, regret_base_idx, actions.size());
-    int a_idx = sample_action_idx(freq);
+    std::array<Action, MAX_ACTIONS> actions;
+    std::array<float, MAX_ACTIONS> freq;
+    int n_actions = node_actions(state, node, actions.data());
+    int cluster = deal.cluster(i, state.get_round());
+    if(deal.hands[i].cards()[0] % 4 == deal.hands[i].cards()[1] % 4 && cluster < 91) {
+      throw std::runtime_error("Bad cluster for suited hand: " + deal.hands[i].to_string());
+    }
+    size_t regret_base_idx = node_index(_regrets, state, node, cluster);
+    strategy(regret_base_idx, n_actions, freq.data());
+    int a_idx = sample_action_idx(freq.data(), n_actions);
     if(_verbose_update) {
       std::cout << "Update strategy: " << relative_history_str(state, _config) << "\n";
-      std::cout << "\t" << hands[i].to_string() << ": (cluster=" << cluster << ")\n\t";
-      for(int ai = 0; ai < actions.size(); ++ai) {
+      std::cout << "\t" << deal.hands[i].to_string() << ": (cluster=" << cluster << ")\n\t";
+      for(int ai = 0; ai < n_actions; ++ai) {
         std::cout << actions[ai].to_string() << "=" << std::setprecision(2) << std::fixed << freq[ai] << "  ";
       }
       std::cout << "\n";
     }
 
-    #pragma omp critical
-    _phi[_phi.index(state, cluster, a_idx)] += 1.0f;
+    size_t phi_idx = node_index(_phi, state, node, cluster, a_idx);
+    // A single thread applies the increments directly, in the same order as an unbuffered run.
+    if(_phi_buffering && omp_get_max_threads() > 1) {
+      _phi_buffers[omp_get_thread_num()].add(phi_idx);
+    }
+    else {
+      #pragma omp critical
+      add_phi(phi_idx);
+    }
 
-    update_strategy(state.apply(actions[a_idx]), i, board, hands);
+    StateDelta delta = state.apply_in_place(actions[a_idx]);
+    update_strategy(state, next_node(node, a_idx), i, deal);
+    state.undo(delta);
   }
   else {
-    for(Action action : valid_actions(state, _config.action_profile)) {
-      update_strategy(state.apply(action), i, board, hands);
+    std::array<Action, MAX_ACTIONS> actions;
+    int n_actions = node_actions(state, node, actions.data());
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      StateDelta delta = state.apply_in_place(actions[a_idx]);
+      update_strategy(state, next_node(node, a_idx), i, deal);
+      state.undo(delta);
     }
   }
 }
 
-int BlueprintTrainer::utility(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval) const {
+template <class F>
+void FrozenStrategy::freeze_tree(const GameTree& tree, int n_clusters, int prune_cutoff, F&& load_row) {
+  std::vector<const TreeNode*> nodes;
+  tree.walk([&](const PokerState& state, const TreeNode& node) {
+    if(node.round == 0) nodes.push_back(&node);
+  });
+  _freq.resize(tree.round_offset(1) * n_clusters);
+  _pruned.resize(_freq.size());
+  #pragma omp parallel for schedule(dynamic)
+  for(size_t n_idx = 0; n_idx < nodes.size(); ++n_idx) {
+    int n_actions = nodes[n_idx]->n_actions;
+    for(int cluster = 0; cluster < n_clusters; ++cluster) {
+      size_t base_idx = nodes[n_idx]->offset * n_clusters + cluster * n_actions;
+      std::array<int, MAX_ACTIONS> values;
+      load_row(base_idx, n_actions, values.data());
+      regret_matching(values.data(), n_actions, _freq.data() + base_idx);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) _pruned[base_idx + a_idx] = values[a_idx] <= prune_cutoff;
+    }
+  }
+}
+
+FrozenStrategy::FrozenStrategy(const StrategyStorage<int>& regrets, const GameTree& tree, int prune_cutoff) {
+  if(!regrets.is_presized()) throw std::runtime_error("FrozenStrategy --- Freezing requires pre-sized regrets.");
+  freeze_tree(tree, regrets.n_clusters(), prune_cutoff, [&](size_t base_idx, int n_actions, int* values) {
+    regrets.load_row(base_idx, n_actions, values);
+  });
+}
+
+FrozenStrategy::FrozenStrategy(const std::vector<int>& preflop, const GameTree& tree, int n_clusters, int prune_cutoff) {
+  if(preflop.size() != tree.round_offset(1) * n_clusters) throw std::runtime_error("FrozenStrategy --- Preflop regrets don't match the tree.");
+  freeze_tree(tree, n_clusters, prune_cutoff, [&](size_t base_idx, int n_actions, int* values) {
+    std::copy(preflop.begin() + base_idx, preflop.begin() + base_idx + n_actions, values);
+  });
+}
+
+static void collect_preflop(const PokerState& state, const StrategyStorage<int>& regrets, std::vector<std::pair<size_t, int>>& rows) {
+  if(state.is_terminal() || state.get_round() > 0) return;
+  // Histories are only added when they are visited, so unvisited histories have no visited descendants either.
+  size_t idx = regrets.find(state.get_action_history());
+  if(idx == StrategyStorage<int>::NO_HISTORY) return;
+  std::array<Action, MAX_ACTIONS> actions;
+  int n_actions = valid_actions(state, regrets.action_profile(), actions.data());
+  rows.emplace_back(idx, n_actions);
+  for(int a_idx = 0; a_idx < n_actions; ++a_idx) collect_preflop(state.apply(actions[a_idx]), regrets, rows);
+}
+
+FrozenStrategy::FrozenStrategy(const StrategyStorage<int>& regrets, const PokerState& init_state, int prune_cutoff) {
+  if(regrets.is_presized()) throw std::runtime_error("FrozenStrategy --- Freezing pre-sized regrets requires a tree.");
+  std::vector<std::pair<size_t, int>> histories;
+  collect_preflop(init_state, regrets, histories);
+  std::sort(histories.begin(), histories.end());
+  size_t n_values = 0;
+  for(const auto& [idx, n_actions] : histories) {
+    size_t n = static_cast<size_t>(n_actions) * regrets.n_clusters();
+    _ranges.push_back(Range{idx, idx + n, n_values});
+    n_values += n;
+  }
+  _freq.resize(n_values);
+  _pruned.resize(n_values);
+  #pragma omp parallel for schedule(dynamic)
+  for(size_t h_idx = 0; h_idx < histories.size(); ++h_idx) {
+    int n_actions = histories[h_idx].second;
+    for(int cluster = 0; cluster < regrets.n_clusters(); ++cluster) {
+      size_t base_idx = histories[h_idx].first + cluster * n_actions;
+      size_t offset = _ranges[h_idx].offset + cluster * n_actions;
+      std::array<int, MAX_ACTIONS> values;
+      regrets.load_row(base_idx, n_actions, values.data());
+      regret_matching(values.data(), n_actions, _freq.data() + offset);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) _pruned[offset + a_idx] = values[a_idx] <= prune_cutoff;
+    }
+  }
+}
+
+// Preflop rows are read by every traversal of every thread. Once frozen, traversals read the packed table instead, which 
+// no thread writes, so its cache lines are shared by all cores.
+// Ranks of a distributed run send the preflop regrets they own to all other ranks, block by block.
+void BlueprintTrainer::freeze_preflop() {
+  if(_transport) {
+    std::vector<int> preflop(_tree->round_offset(1) * _regrets.n_clusters());
+    ReplicaBatch owned;
+    for(size_t block = 0; block << OWNER_BITS < preflop.size(); ++block) {
+      if(value_owner(block << OWNER_BITS, _transport->size()) != _transport->rank()) continue;
+      owned.blocks.push_back(block);
+      for(size_t idx = block << OWNER_BITS; idx < std::min((block + 1) << OWNER_BITS, preflop.size()); ++idx) {
+        preflop[idx] = _regrets.get(idx);
+        owned.row_values.push_back(preflop[idx]);
+      }
+    }
+    std::string msg = owned.pack();
+    std::vector<std::string> out(_transport->size(), msg);
+    out[_transport->rank()].clear();
+    for(const auto& in : all_to_all(*_transport, out)) {
+      if(in.empty()) continue;
+      ReplicaBatch batch = ReplicaBatch::unpack(in);
+      size_t v_idx = 0;
+      for(size_t block : batch.blocks) {
+        for(size_t idx = block << OWNER_BITS; idx < std::min((block + 1) << OWNER_BITS, preflop.size()); ++idx) {
+          preflop[idx] = batch.row_values[v_idx++];
+        }
+      }
+    }
+    _frozen = FrozenStrategy{preflop, *_tree, _regrets.n_clusters(), _config.prune_cutoff};
+  }
+  else {
+    _frozen = _tree ? FrozenStrategy{_regrets, *_tree, _config.prune_cutoff} : FrozenStrategy{_regrets, _config.init_state, _config.prune_cutoff};
+  }
+  std::cout << "Froze " << _frozen.size() << " preflop values.\n";
+}
+
+void BlueprintTrainer::strategy(size_t base_idx, int n_actions, float* freq) const {
+  if(_frozen.contains(base_idx)) {
+    std::copy(_frozen.row(base_idx), _frozen.row(base_idx) + n_actions, freq);
+  }
+  else {
+    std::array<int, MAX_ACTIONS> regrets;
+    load_regrets(base_idx, n_actions, regrets.data());
+    regret_matching(regrets.data(), n_actions, freq);
+  }
+}
+
+void BlueprintTrainer::select_hot_rows(long n_sampled) {
+  std::unordered_map<uint32_t, long> visits;
+  for(auto& worker : _workers) {
+    if(!worker) continue;
+    for(const auto& [id, count] : worker->visits) visits[id] += count;
+    worker->visits.clear();
+  }
+  // Rows of a node updated by at least one in eight iterations.
+  _hot_rows = HotRows{*_tree, visits, _regrets.n_clusters(), _config.regret_precision, std::max(1L, n_sampled / 8), 
+                      static_cast<size_t>(_config.hot_row_values)};
+  std::cout << "Hot rows: " << _hot_rows.n_nodes() << " nodes, " << _hot_rows.n_values() << " values.\n";
+}
+
+void BlueprintTrainer::count_row_visit(size_t base_idx) {
+  if(!_config.reorder_rows || omp_get_thread_num() >= _workers.size()) return;
+  auto& worker = _workers[omp_get_thread_num()];
+  if(worker && worker->count_visits) worker->row_visit_log.add(base_idx);
+}
+
+// Reordering happens at a checkpoint, between intervals, when no worker uses the regrets.
+void BlueprintTrainer::reorder_regrets() {
+  std::unordered_map<size_t, long> visits;
+  for(auto& worker : _workers) {
+    if(!worker) continue;
+    for(const auto& [idx, count] : worker->row_visits) visits[idx] += count;
+    worker->row_visits.clear();
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  ReorderStats stats = _regrets.reorder(visits, _config.init_state, MODEL_CACHE_BYTES);
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << "Reordered regrets in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms: " 
+            << stats.hot_histories << " hot histories, modeled miss rate " << std::setprecision(1) << std::fixed 
+            << 100.0 * stats.miss_rate_before << "% -> " << 100.0 * stats.miss_rate_after << "%, measured sweep " 
+            << stats.sweep_ns_before << " ns -> " << stats.sweep_ns_after << " ns per row.\n";
+  // Reordering moves the frozen rows. Their regrets are no longer updated, so refreezing yields the same strategy.
+  if(!_frozen.empty()) freeze_preflop();
+}
+
+void BlueprintTrainer::count_visit(const TreeNode* node) {
+  if(_config.hot_row_values == 0 || !node || omp_get_thread_num() >= _workers.size()) return;
+  auto& worker = _workers[omp_get_thread_num()];
+  if(worker && worker->count_visits) worker->visit_log.add(_tree->id(*node));
+}
+
+void BlueprintTrainer::merge_visits(WorkerContext& worker) {
+  for(size_t k_idx = 0; k_idx < worker.visit_log.n; ++k_idx) ++worker.visits[worker.visit_log.keys[k_idx]];
+  for(size_t k_idx = 0; k_idx < worker.row_visit_log.n; ++k_idx) ++worker.row_visits[worker.row_visit_log.keys[k_idx]];
+  worker.visit_log.n = 0;
+  worker.row_visit_log.n = 0;
+}
+
+long* BlueprintTrainer::hot_deltas(size_t base_idx) {
+  if(_hot_rows.empty()) return nullptr;
+  long slot = _hot_rows.slot(base_idx);
+  return slot < 0 ? nullptr : _workers[omp_get_thread_num()]->hot_deltas.data() + slot;
+}
+
+void BlueprintTrainer::flush_hot(WorkerContext& worker) {
+  add_positive_regret(_hot_rows.flush(_regrets, worker.hot_deltas.data(), _config.regret_floor));
+  if(!_row_sums.empty()) {
+    for(uint32_t id : _hot_rows.node_ids()) _row_sums.refresh(_regrets, _tree->node(id), id);
+  }
+}
+
+// Sums the buffered increments of all threads, in parallel over the phi values.
+void BlueprintTrainer::merge_phi() {
+  size_t n_values = 0;
+  for(const auto& buffer : _phi_buffers) n_values = std::max(n_values, buffer.deltas.size());
+  #pragma omp parallel for schedule(static)
+  for(size_t idx = 0; idx < n_values; ++idx) {
+    float delta = 0.0f;
+    for(auto& buffer : _phi_buffers) {
+      if(idx >= buffer.deltas.size()) continue;
+      delta += buffer.deltas[idx];
+      buffer.deltas[idx] = 0.0f;
+    }
+    if(delta == 0.0f) continue;
+    if(_transport && value_owner(idx, _transport->size()) != _transport->rank()) {
+      #pragma omp critical
+      _remote_phi[idx] += delta;
+    }
+    else {
+      _phi[idx] += delta;
+    }
+  }
+}
+
+void BlueprintTrainer::add_phi(size_t idx) {
+  if(_transport && value_owner(idx, _transport->size()) != _transport->rank()) _remote_phi[idx] += 1.0f;
+  else _phi[idx] += 1.0f;
+}
+
+void BlueprintTrainer::set_transport(std::unique_ptr<Transport> transport) {
+  if(transport && !_config.compile_tree) throw std::runtime_error("BlueprintTrainer --- Distributed training requires a compiled tree.");
+  if(_transport) throw std::runtime_error("BlueprintTrainer --- Trainer is already distributed.");
+  _transport = std::move(transport);
+  if(_transport) {
+    partition();
+    if(!_row_sums.empty()) _row_sums.rebuild(_regrets, *_tree);
+  }
+}
+
+// Called before the storage is allocated, or afterwards to release the values of other ranks.
+void BlueprintTrainer::partition() {
+  _regrets.partition(_transport->rank(), _transport->size());
+  _phi.partition(_transport->rank(), _transport->size());
+  _row_cache = RowCache{static_cast<size_t>(_config.cache_values)};
+  _changed = BlockMarks{_tree->round_offset(4) * _regrets.n_clusters()};
+}
+
+std::string BlueprintTrainer::rank_suffix() const {
+  return _transport ? "_rank" + std::to_string(_transport->rank()) : "";
+}
+
+void BlueprintTrainer::refresh_row_sum(size_t base_idx, int n_actions) {
+  long slot = _row_sums.row_slot(base_idx);
+  if(slot < 0) return;
+  std::array<int, MAX_ACTIONS> regrets;
+  load_regrets(base_idx, n_actions, regrets.data());
+  _row_sums.store(slot, positive_sum(regrets.data(), n_actions));
+}
+
+// Four rounds of all-to-all exchanges. The deltas of remote rows and average strategy increments are sent to their 
+// owners, which apply them and announce the owned blocks that changed since the last synchronization. The row cache is 
+// then rebuilt and every rank requests the rows it has not fetched yet from their owners. Rows of two owners are sent to
+// both, each owner applies and replies with the values it owns. Row sums are refreshed for the changed rows only.
+void BlueprintTrainer::sync_replicas() {
+  auto sync_start = std::chrono::high_resolution_clock::now();
+  int n_ranks = _transport->size();
+  int rank = _transport->rank();
+  auto add_row = [&](std::vector<ReplicaBatch>& batches, size_t base_idx, int n_actions, const long* values) {
+    int first = value_owner(base_idx, n_ranks), last = value_owner(base_idx + n_actions - 1, n_ranks);
+    batches[first].add_row(base_idx, n_actions, values);
+    if(last != first) batches[last].add_row(base_idx, n_actions, values);
+  };
+  std::vector<ReplicaBatch> updates(n_ranks);
+  _row_cache.for_each_delta([&](size_t base_idx, int n_actions, const long* deltas) { add_row(updates, base_idx, n_actions, deltas); });
+  for(auto& buffer : _replica_buffers) {
+    const ReplicaBatch& deltas = buffer.deltas;
+    for(size_t r_idx = 0, v_idx = 0; r_idx < deltas.row_idxs.size(); v_idx += deltas.row_actions[r_idx++]) {
+      add_row(updates, deltas.row_idxs[r_idx], deltas.row_actions[r_idx], deltas.row_values.data() + v_idx);
+    }
+    buffer.deltas = ReplicaBatch{};
+  }
+  for(const auto& [idx, value] : _remote_phi) {
+    ReplicaBatch& batch = updates[value_owner(idx, n_ranks)];
+    batch.phi_idxs.push_back(idx);
+    batch.phi_values.push_back(value);
+  }
+  _remote_phi.clear();
+
+  std::vector<std::pair<size_t, int>> changed_rows;
+  auto apply = [&](const ReplicaBatch& batch) {
+    for(size_t r_idx = 0, v_idx = 0; r_idx < batch.row_idxs.size(); ++r_idx) {
+      size_t base_idx = batch.row_idxs[r_idx];
+      int n_actions = batch.row_actions[r_idx];
+      for(size_t idx = base_idx; idx < base_idx + n_actions; ++idx, ++v_idx) {
+        if(!_regrets.owns(idx)) continue;
+        long next_r = _regrets.get(idx) + batch.row_values[v_idx];
+        if(next_r > 2'000'000'000) throw std::runtime_error("Regret overflowing!");
+        _regrets.set(idx, std::max<long>(next_r, _config.regret_floor));
+        _changed.mark_block(idx >> OWNER_BITS);
+      }
+      if(_regrets.owns_row(base_idx, n_actions)) changed_rows.emplace_back(base_idx, n_actions);
+    }
+    for(size_t u_idx = 0; u_idx < batch.phi_idxs.size(); ++u_idx) _phi[batch.phi_idxs[u_idx]] += batch.phi_values[u_idx];
+  };
+  std::vector<std::string> out(n_ranks);
+  for(int r = 0; r < n_ranks; ++r) {
+    if(r != rank) out[r] = updates[r].pack();
+  }
+  size_t sent_bytes = 0;
+  auto exchange = [&](const std::vector<std::string>& msgs) {
+    for(const auto& msg : msgs) sent_bytes += msg.size();
+    return all_to_all(*_transport, msgs);
+  };
+  apply(updates[rank]);
+  for(const auto& msg : exchange(out)) {
+    if(!msg.empty()) apply(ReplicaBatch::unpack(msg));
+  }
+
+  ReplicaBatch changed;
+  changed.blocks = _changed.blocks();
+  std::string changed_msg = changed.pack();
+  for(int r = 0; r < n_ranks; ++r) out[r] = r != rank ? changed_msg : "";
+  for(const auto& msg : exchange(out)) {
+    if(msg.empty()) continue;
+    for(size_t block : ReplicaBatch::unpack(msg).blocks) _changed.mark_block(block);
+  }
+
+  _row_cache = _row_cache.rebuild([&](size_t base_idx, int n_actions) { return _changed.test(base_idx, n_actions); });
+  std::vector<std::pair<size_t, int>> rows = _row_cache.unfetched();
+  std::vector<ReplicaBatch> requests(n_ranks);
+  // Position of every requested row in rows, per owner.
+  std::vector<std::vector<size_t>> requested(n_ranks);
+  std::vector<int> values(rows.size() * MAX_ACTIONS);
+  for(size_t r_idx = 0; r_idx < rows.size(); ++r_idx) {
+    auto [base_idx, n_actions] = rows[r_idx];
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) values[r_idx * MAX_ACTIONS + a_idx] = _regrets.get(base_idx + a_idx);
+    add_row(requests, base_idx, n_actions, static_cast<const long*>(nullptr));
+    for(int r = 0; r < n_ranks; ++r) {
+      if(requests[r].row_idxs.size() > requested[r].size()) requested[r].push_back(r_idx);
+    }
+  }
+  for(int r = 0; r < n_ranks; ++r) out[r] = r != rank ? requests[r].pack() : "";
+  std::vector<std::string> in = exchange(out);
+  for(int r = 0; r < n_ranks; ++r) {
+    if(in[r].empty()) continue;
+    ReplicaBatch request = ReplicaBatch::unpack(in[r]);
+    ReplicaBatch reply;
+    for(size_t r_idx = 0; r_idx < request.row_idxs.size(); ++r_idx) {
+      std::array<long, MAX_ACTIONS> owned;
+      for(int a_idx = 0; a_idx < request.row_actions[r_idx]; ++a_idx) owned[a_idx] = _regrets.get(request.row_idxs[r_idx] + a_idx);
+      reply.add_row(request.row_idxs[r_idx], request.row_actions[r_idx], owned.data());
+    }
+    out[r] = reply.pack();
+  }
+  in = exchange(out);
+  for(int r = 0; r < n_ranks; ++r) {
+    if(in[r].empty()) continue;
+    ReplicaBatch reply = ReplicaBatch::unpack(in[r]);
+    for(size_t q_idx = 0, v_idx = 0; q_idx < reply.row_idxs.size(); v_idx += reply.row_actions[q_idx++]) {
+      size_t r_idx = requested[r][q_idx];
+      for(int a_idx = 0; a_idx < reply.row_actions[q_idx]; ++a_idx) {
+        if(value_owner(reply.row_idxs[q_idx] + a_idx, n_ranks) == r) values[r_idx * MAX_ACTIONS + a_idx] = reply.row_values[v_idx + a_idx];
+      }
+    }
+  }
+  for(size_t r_idx = 0; r_idx < rows.size(); ++r_idx) _row_cache.fill(rows[r_idx].first, values.data() + r_idx * MAX_ACTIONS);
+  _changed.clear();
+  if(!_row_sums.empty()) {
+    for(const auto& [base_idx, n_actions] : changed_rows) refresh_row_sum(base_idx, n_actions);
+    for(const auto& [base_idx, n_actions] : rows) refresh_row_sum(base_idx, n_actions);
+  }
+  auto sync_end = std::chrono::high_resolution_clock::now();
+  std::cout << "Rank sync: " << sent_bytes / 1'000'000.0 << " MB sent in " 
+            << std::chrono::duration_cast<std::chrono::milliseconds>(sync_end - sync_start).count() << " ms, fetched " 
+            << rows.size() << " of " << _row_cache.n_rows() << " cached rows.\n";
+}
+
+void BlueprintTrainer::save_delta(const std::string& fn) const {
+  std::cout << "Saving delta to " << fn << '\n';
+  std::ofstream os(fn, std::ios::binary);
+  cereal::BinaryOutputArchive oarchive(os);
+  oarchive(_config, _t);
+  _regrets.save_delta(oarchive);
+  _phi.save_delta(oarchive);
+}
+
+void BlueprintTrainer::load_delta(const std::string& fn) {
+  std::cout << "Loading delta from " << fn << '\n';
+  std::ifstream is(fn, std::ios::binary);
+  cereal::BinaryInputArchive iarchive(is);
+  BlueprintTrainerConfig config;
+  long t;
+  iarchive(config, t);
+  if(config != _config) throw std::runtime_error("BlueprintTrainer --- Delta was taken with a different config.");
+  if(t < _t) throw std::runtime_error("BlueprintTrainer --- Deltas have to be applied in order.");
+  _regrets.load_delta(iarchive);
+  _phi.load_delta(iarchive);
+  _t = t;
+  if(!_row_sums.empty()) _row_sums.rebuild(_regrets, *_tree);
+}
+
+void BlueprintTrainer::save_compressed(const std::string& fn, int n_shards) const {
+  std::cout << "Saving compressed snapshot to " << fn << '\n';
+  std::ofstream os(fn, std::ios::binary);
+  os.write(COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+  cereal::BinaryOutputArchive oarchive(os);
+  oarchive(_config, _t);
+  pluribus::save_compressed(_regrets, oarchive, fn + ".regrets", n_shards);
+  pluribus::save_compressed(_phi, oarchive, fn + ".phi", n_shards);
+}
+
+void BlueprintTrainer::load_compressed(const std::string& fn) {
+  std::cout << "Loading compressed snapshot from " << fn << '\n';
+  std::ifstream is(fn, std::ios::binary);
+  char magic[sizeof(COMPRESSED_MAGIC)];
+  if(!is.read(magic, sizeof(magic)) || std::memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) != 0) {
+    throw std::runtime_error("BlueprintTrainer --- Not a compressed snapshot: " + fn);
+  }
+  cereal::BinaryInputArchive iarchive(is);
+  iarchive(_config, _t);
+  std::filesystem::path dir = std::filesystem::path{fn}.parent_path();
+  pluribus::load_compressed(_regrets, iarchive, dir);
+  pluribus::load_compressed(_phi, iarchive, dir);
+  init_tree();
+}
+
+BlueprintTrainer load_snapshot(const std::string& base_fn, const std::vector<std::string>& delta_fns) {
+  BlueprintTrainer trainer;
+  if(is_compressed_snapshot(base_fn)) {
+    trainer.load_compressed(base_fn);
+  }
+  else {
+    std::cout << "Loading from " << base_fn << '\n';
+    std::ifstream is(base_fn, std::ios::binary);
+    cereal::BinaryInputArchive iarchive(is);
+    iarchive(trainer);
+  }
+  for(const auto& fn : delta_fns) trainer.load_delta(fn);
+  return trainer;
+}
+
+void merge_replicas(const std::vector<std::string>& rank_fns, const std::string& fn) {
+  if(rank_fns.empty()) throw std::runtime_error("merge_replicas --- No snapshots given.");
+  int n_ranks = rank_fns.size();
+  auto merged = cereal_load<BlueprintTrainer>(rank_fns[0]);
+  if(!merged.get_regrets().is_presized()) throw std::runtime_error("merge_replicas --- Distributed runs require a compiled tree.");
+  for(int rank = 1; rank < n_ranks; ++rank) {
+    auto trainer = cereal_load<BlueprintTrainer>(rank_fns[rank]);
+    if(trainer.get_regrets().size() != merged.get_regrets().size() || trainer.get_phi().size() != merged.get_phi().size()) {
+      throw std::runtime_error("merge_replicas --- Ranks were trained on different trees.");
+    }
+    trainer.get_regrets().for_each([&](size_t idx, int value) {
+      if(value_owner(idx, n_ranks) == rank) merged.get_regrets().set(idx, value);
+    });
+    trainer.get_phi().for_each([&](size_t idx, float value) {
+      if(value_owner(idx, n_ranks) == rank) merged.get_phi().set(idx, value);
+    });
+  }
+  cereal_save(merged, fn);
+}
+
+int BlueprintTrainer::utility(const PokerState& state, int i, const Deal& deal, const omp::HandEvaluator& eval) const {
   if(state.get_players()[i].has_folded()) {
     return state.get_players()[i].get_chips() - _config.poker.n_chips;
   }
@@ -375,19 +1351,13 @@ int BlueprintTrainer::utility(const PokerState& state, int i, const Board& board
     return state.get_players()[i].get_chips() - _config.poker.n_chips + (state.get_winner() == i ? state.get_pot() : 0);
   }
   else if(state.get_round() >= 4) {
-    return state.get_players()[i].get_chips() - _config.poker.n_chips + showdown_payoff(state, i, board, hands, eval);
+    return state.get_players()[i].get_chips() - _config.poker.n_chips + deal.showdown_payoff(state, i, _config.poker.n_chips);
   }
   else {
     throw std::runtime_error("Non-terminal state does not have utility.");
   }
 }
 
-int BlueprintTrainer::showdown_payoff(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval) const {
-  if(state.get_players()[i].has_folded()) return 0;
-  std::vector<uint8_t> win_idxs = winners(state, hands, board, eval);
-  return std::find(win_idxs.begin(), win_idxs.end(), i) != win_idxs.end() ? state.get_pot() / win_idxs.size() : 0;
-}
-
 void log_preflop_strategy(const BlueprintTrainer& trainer, bool force_regrets, nlohmann::json& metrics) {
   PokerState state = trainer.get_config().init_state;
   Board board("2c2d2h3c3h");
@@ -404,20 +1374,143 @@ void log_preflop_strategy(const BlueprintTrainer& trainer, bool force_regrets, n
   }
 }
 
-void BlueprintTrainer::log_metrics(long t) {
-  long avg_regret = 0;
-  for(auto& r : _regrets.data()) avg_regret += std::max(r.load(), 0);
-  avg_regret /= t;
-  std::cout << std::setprecision(1) << std::fixed << "t=" << t / 1'000'000.0 << "M    " << "avg_regret=" << avg_regret << "\n";
+void BlueprintTrainer::save_snapshot(const std::string& fn, bool delta) {
+  auto stall_start = std::chrono::high_resolution_clock::now();
+  auto save = [&](const std::string& save_fn) {
+    if(delta) save_delta(save_fn);
+    else if(_config.snapshot_shards > 0) save_compressed(save_fn, _config.snapshot_shards);
+    else cereal_save(*this, save_fn);
+  };
+  if(delta) {
+    std::cout << "Delta pages: " << _regrets.dirty_pages().size() << "/" << _regrets.n_pages() << " regrets, " 
+              << _phi.dirty_pages().size() << "/" << _phi.n_pages() << " phi.\n";
+  }
+  if(_config.async_snapshots) {
+    // The forked child shares all pages copy-on-write, so it sees the trainer as of this moment while training resumes. 
+    // Worker threads are idle between intervals. The child only serializes before calling _exit and may not enter OpenMP 
+    // regions, libgomp hangs in a forked child once the parent used OpenMP.
+    reap_snapshot(true);
+    // Full snapshots settle every page, which is done in parallel here so the child has no pages left to settle. Deltas 
+    // write raw pages and must not settle, settled pages would become dirty. Compact pages are written decoded by both and 
+    // are settled here, so that the child rounds none of them differently from the parent.
+    if(!delta) {
+      _regrets.settle_all();
+      _phi.settle_all();
+    }
+    else {
+      _regrets.settle_compact();
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if(pid == 0) {
+      // The child must never return into the training loop, failures are reported through its exit status.
+      try {
+        std::string tmp_fn = fn + ".tmp";
+        save(tmp_fn);
+        _exit(std::rename(tmp_fn.c_str(), fn.c_str()) == 0 ? 0 : 1);
+      }
+      catch(...) {
+        _exit(1);
+      }
+    }
+    else if(pid > 0) {
+      _snapshot_pid = pid;
+      _snapshot_fn = fn;
+    }
+    else {
+      std::cout << "Snapshot fork failed, saving synchronously.\n";
+      save(fn);
+    }
+  }
+  else {
+    save(fn);
+  }
+  if(delta) {
+    _regrets.clear_dirty();
+    _phi.clear_dirty();
+    ++_n_deltas;
+  }
+  else {
+    _regrets.mark_checkpoint();
+    _phi.mark_checkpoint();
+    _n_deltas = 0;
+  }
+  auto stall_end = std::chrono::high_resolution_clock::now();
+  std::cout << "Snapshot stall: " << std::chrono::duration_cast<std::chrono::milliseconds>(stall_end - stall_start).count() << " ms.\n";
+}
+
+void BlueprintTrainer::reap_snapshot(bool block) {
+  if(_snapshot_pid <= 0) return;
+  int status;
+  pid_t pid = waitpid(_snapshot_pid, &status, block ? 0 : WNOHANG);
+  if(pid == 0) return;
+  if(pid == _snapshot_pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    std::cout << "Snapshot saved: " << _snapshot_fn << "\n";
+  }
+  else {
+    // The dirty pages were cleared when the child was forked, so later deltas would miss the pages of this snapshot.
+    std::cout << "Snapshot failed: " << _snapshot_fn << ", the next snapshot is full.\n";
+    _n_deltas = -1;
+  }
+  _snapshot_pid = -1;
+}
+
+void BlueprintTrainer::start_metrics() {
+  _metrics = std::make_unique<MetricsChannel>(omp_get_max_threads());
+  long positive_regret = 0;
+  _regrets.for_each([&](size_t idx, int r) { positive_regret += std::max(r, 0); });
+  _metrics->positive_regret[0].value.store(positive_regret);
+  _metrics->thread = std::thread{[this]() {
+    MetricsSample sample;
+    while(true) {
+      if(_metrics->queue.pop(sample)) {
+        log_metrics(sample);
+        _metrics->pending.fetch_sub(1);
+      }
+      else if(_metrics->stop.load()) {
+        return;
+      }
+      else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+  }};
+}
+
+void BlueprintTrainer::queue_metrics(long t) {
+  _metrics->pending.fetch_add(1);
+  if(!_metrics->queue.push(MetricsSample{t, _metrics->sum_positive_regret()})) {
+    _metrics->pending.fetch_sub(1);
+    _metrics->dropped.fetch_add(1);
+  }
+}
+
+// Waits for all queued samples, so that discounting and forked snapshots never run concurrently with the metrics thread.
+void BlueprintTrainer::flush_metrics() {
+  while(_metrics->pending.load() > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void BlueprintTrainer::stop_metrics() {
+  _metrics->stop.store(true);
+  if(_metrics->thread.joinable()) _metrics->thread.join();
+}
+
+void BlueprintTrainer::log_metrics(const MetricsSample& sample) {
+  auto metrics_start = std::chrono::high_resolution_clock::now();
+  long avg_regret = sample.positive_regret / sample.t;
+  std::cout << std::setprecision(1) << std::fixed << "t=" << sample.t / 1'000'000.0 << "M    " << "avg_regret=" << avg_regret << "\n";
 
   nlohmann::json metrics = {
     {"avg_regret", static_cast<int>(avg_regret)},
-    {"t (M)", static_cast<float>(t / 1'000'000.0)}
+    {"t (M)", static_cast<float>(sample.t / 1'000'000.0)}
   };
   log_preflop_strategy(*this, true, metrics);
   log_preflop_strategy(*this, false, metrics);
+  auto metrics_end = std::chrono::high_resolution_clock::now();
+  metrics["metrics_ms"] = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(metrics_end - metrics_start).count());
+  metrics["metrics_dropped"] = static_cast<int>(_metrics->dropped.load());
   std::ostringstream metrics_fn;
-  metrics_fn << std::setprecision(1) << std::fixed << t / 1'000'000.0 << ".json";
+  metrics_fn << std::setprecision(1) << std::fixed << sample.t / 1'000'000.0 << ".json";
   write_to_file(_metrics_dir / metrics_fn.str(), metrics.dump());
 
   if(_wb) {
@@ -1,22 +1,38 @@
 #pragma once
 
 #include <array>
+#include <algorithm>
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include <atomic>
 #include <memory>
 #include <filesystem>
+#include <thread>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <omp.h>
 #include <cereal/cereal.hpp>
+#include <cereal/types/array.hpp>
 #include <libwandb_cpp.h>
 #include <tbb/concurrent_vector.h>
 #include <tbb/concurrent_unordered_map.h>
+#include <boost/lockfree/queue.hpp>
 #include <pluribus/range.hpp>
 #include <pluribus/cereal_ext.hpp>
 #include <pluribus/poker.hpp>
 #include <pluribus/infoset.hpp>
 #include <pluribus/storage.hpp>
+#include <pluribus/tree.hpp>
+#include <pluribus/deal.hpp>
+#include <pluribus/simd.hpp>
+#include <pluribus/replica.hpp>
+#include <pluribus/transport.hpp>
+#include <pluribus/hot.hpp>
+#include <pluribus/sums.hpp>
+#include <pluribus/coro.hpp>
+#include <pluribus/rng.hpp>
 
 
 namespace pluribus {
@@ -24,34 +40,25 @@ namespace pluribus {
 // using PreflopMap = tbb::concurrent_unordered_map<InformationSet, tbb::concurrent_vector<float>>;
 
 template <class T>
-std::vector<float> calculate_strategy(const StrategyStorage<T>& data, size_t base_idx, int n_actions) {
-  T sum = 0;
-  for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
-    sum += std::max(data[base_idx + a_idx].load(), static_cast<T>(0));
-  }
+void calculate_strategy(const StrategyStorage<T>& data, size_t base_idx, int n_actions, float* freq) {
+  std::array<T, MAX_ACTIONS> values;
+  data.load_row(base_idx, n_actions, values.data());
+  regret_matching(values.data(), n_actions, freq);
+}
 
-  std::vector<float> freq;
-  freq.reserve(n_actions);
-  if(sum > 0) {
-    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
-      freq.push_back(std::max(data[base_idx + a_idx].load(), static_cast<T>(0)) / static_cast<double>(sum));
-    }
-  }
-  else {
-    for(int i = 0; i < n_actions; ++i) {
-      freq.push_back(1.0 / n_actions);
-    }
-  }
+template <class T>
+std::vector<float> calculate_strategy(const StrategyStorage<T>& data, size_t base_idx, int n_actions) {
+  std::vector<float> freq(n_actions);
+  calculate_strategy(data, base_idx, n_actions, freq.data());
   return freq;
 }
 
 template <class T>
 void lcfr_discount(StrategyStorage<T>& regrets, double d) {
-  for(auto& e : regrets.data()) {
-    e.store(e.load() * d);
-  }
+  regrets.discount(d);
 }
 
+int sample_action_idx(const float* freq, int n_actions);
 int sample_action_idx(const std::vector<float>& freq);
 
 struct BlueprintTimingConfig {
@@ -80,10 +87,43 @@ struct BlueprintTrainerConfig {
     log_interval = timings.log_interval_m * it_per_min;
   }
 
+  // Archives start with LAYOUT_TAG and the layout version, followed by the original fields and the fields of every later
+  // version. Archives from before the tag start with poker.n_players, which is never negative, and end after regret_floor.
+  // Fields they don't have keep their defaults. New fields go at the end behind a new version.
+  static constexpr int LAYOUT_TAG = -0x504c5242;
+  static constexpr uint32_t LAYOUT_VERSION = 2;
+
   template <class Archive>
-  void serialize(Archive& ar) {
-    ar(poker, action_profile, init_ranges, init_board, init_state, strategy_interval, preflop_threshold, snapshot_interval, 
+  void save(Archive& ar) const {
+    ar(LAYOUT_TAG, LAYOUT_VERSION);
+    ar(poker, action_profile, init_ranges, init_board, init_state, strategy_interval, preflop_threshold, snapshot_interval,
+       prune_thresh, lcfr_thresh, discount_interval, log_interval, prune_cutoff, regret_floor);
+    ar(compile_tree, shared_deal, huge_pages, regret_precision, async_snapshots, seed, public_sampling, numa, sync_interval,
+       delta_snapshots, snapshot_shards, hot_row_values, interleave, row_sums, reorder_rows);
+    ar(cache_values);
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    *this = BlueprintTrainerConfig{};
+    int tag;
+    uint32_t version = 0;
+    ar(tag);
+    if(tag == LAYOUT_TAG) {
+      ar(version, poker);
+      if(version > LAYOUT_VERSION) throw std::runtime_error("BlueprintTrainerConfig --- Unsupported layout version.");
+    }
+    else {
+      poker.n_players = tag;
+      ar(poker.n_chips, poker.ante);
+    }
+    ar(action_profile, init_ranges, init_board, init_state, strategy_interval, preflop_threshold, snapshot_interval,
        prune_thresh, lcfr_thresh, discount_interval, log_interval, prune_cutoff, regret_floor);
+    if(version >= 1) {
+      ar(compile_tree, shared_deal, huge_pages, regret_precision, async_snapshots, seed, public_sampling, numa, sync_interval,
+         delta_snapshots, snapshot_shards, hot_row_values, interleave, row_sums, reorder_rows);
+    }
+    if(version >= 2) ar(cache_values);
   }
 
   PokerConfig poker;
@@ -100,50 +140,355 @@ struct BlueprintTrainerConfig {
   long log_interval;
   int prune_cutoff = -300'000'000;
   int regret_floor = -310'000'000;
+  bool compile_tree = false;
+  bool shared_deal = false;
+  bool huge_pages = false;
+  // Precision of the regrets of each round. Compact rounds require compile_tree and can't be distributed.
+  std::array<Precision, 4> regret_precision = {Precision::INT32, Precision::INT32, Precision::INT32, Precision::INT32};
+  // Write snapshots from a forked child while training continues. Pages written in the meantime are copied, so peak memory 
+  // can grow by up to the size of the trainer.
+  bool async_snapshots = false;
+  // The generator is reseeded from (seed, t) at every iteration, so the cards and samples of an iteration don't depend 
+  // on the thread count. Archives from before the seed was serialized load with the default seed. Their iterations were 
+  // not seeded, so training continues from them like from any other snapshot.
+  uint64_t seed = 42;
+  // Heads-up only. Sample only the board and traverse with the range vectors of both players instead of sampling hands. 
+  // Every iteration updates the regrets of all clusters of the traverser that the board allows.
+  bool public_sampling = false;
+  // Pin the workers round-robin to the NUMA nodes and interleave the pages of the pre-sized storage across them. Requires 
+  // compile_tree.
+  bool numa = false;
+  // Iterations between the synchronizations of the ranks of a distributed run.
+  long sync_interval = 100'000;
+  // Number of delta snapshots between two full snapshots. Deltas only hold the pages changed since the previous snapshot 
+  // and require compile_tree. The preflop snapshot is always full.
+  int delta_snapshots = 0;
+  // Full snapshots are written as this many compressed shards, one thread each. 0 writes a single cereal archive.
+  int snapshot_shards = 0;
+  // Regret values per thread that are updated through private accumulators. The most visited rows are picked after every
+  // interval. 0 updates all rows directly. Requires compile_tree and is ignored by distributed runs.
+  long hot_row_values = 0;
+  // Iterations each worker keeps in flight. Above 1, traversals prefetch every regret row and switch to another iteration
+  // while it loads. Requires compile_tree and doesn't support public_sampling.
+  int interleave = 1;
+  // Caches the positive regret sum of every full precision row, so that opponent nodes sample without regret matching. 
+  // Requires compile_tree.
+  bool row_sums = false;
+  // Lazy regrets are reordered after every snapshot, so that the sampled histories are contiguous in depth first order.
+  // Requires lazy regrets and is ignored by distributed runs, whose values are owned by regret index.
+  bool reorder_rows = false;
+  // Regret values of other ranks which a rank of a distributed run caches between synchronizations, at 24 bytes each.
+  long cache_values = long{1} << 22;
+};
+
+struct MetricsSample {
+  long t;
+  long positive_regret;
+};
+
+// Training threads keep the positive regret sum up to date in per-thread counters and queue samples without blocking. 
+// The metrics thread does the expensive work of each sample and exports it. Samples are dropped if the queue is full.
+struct MetricsChannel {
+  struct alignas(64) Counter {
+    std::atomic<long> value = 0;
+  };
+
+  explicit MetricsChannel(int n_threads) : positive_regret(n_threads) {}
+  ~MetricsChannel() {
+    stop.store(true);
+    if(thread.joinable()) thread.join();
+  }
+
+  long sum_positive_regret() const {
+    long sum = 0;
+    for(const auto& counter : positive_regret) sum += counter.value.load(std::memory_order_relaxed);
+    return sum;
+  }
+
+  boost::lockfree::queue<MetricsSample, boost::lockfree::capacity<64>> queue;
+  std::vector<Counter> positive_regret;
+  std::atomic<int> pending = 0;
+  std::atomic<long> dropped = 0;
+  std::atomic<bool> stop = false;
+  std::thread thread;
+};
+
+// An iteration in flight on a worker that interleaves iterations. Every lane deals and samples with its own generator,
+// which is swapped in while the lane runs.
+struct TraversalLane : Lane {
+  explicit TraversalLane(const BlueprintTrainerConfig& config) : deck{config.init_board}, deal{config.poker.n_players} {}
+
+  Deck deck;
+  Deal deal;
+  PokerState state;
+  RNG rng{0};
+  bool count_visits = false;
+  Task<> task;
+};
+
+// Scratch of one level of a public chance sampling traversal, sized for the widest node so each level is allocated once.
+struct PcsFrame {
+  PcsFrame(int max_actions, int n_clusters) : freq(max_actions * N_HANDS), action_values(max_actions * N_HANDS), 
+      deltas(n_clusters * max_actions), cluster_freq(n_clusters * max_actions), touched(n_clusters), ready(n_clusters), 
+      child_reach(N_HANDS), child_values(N_HANDS) {}
+
+  std::vector<float> freq;
+  std::vector<float> action_values;
+  std::vector<float> deltas;
+  std::vector<float> cluster_freq;
+  std::vector<uint8_t> touched;
+  std::vector<uint8_t> ready;
+  std::vector<float> child_reach;
+  std::vector<float> child_values;
+};
+
+// Keys counted by sampled iterations since the log was last merged. Sized once, so counting doesn't allocate. Keys past 
+// the capacity are dropped, which only loses visits of iterations that update more than CAPACITY rows.
+struct VisitLog {
+  static constexpr size_t CAPACITY = size_t{1} << 16;
+
+  void add(size_t key) { if(n < keys.size()) keys[n++] = key; }
+
+  std::vector<size_t> keys = std::vector<size_t>(CAPACITY);
+  size_t n = 0;
+};
+
+// Scratch state of one worker. Kept across intervals, so every worker sets up its evaluator, deck and deals once.
+struct alignas(64) WorkerContext {
+  explicit WorkerContext(const BlueprintTrainerConfig& config) : deck{config.init_board}, deal{config.poker.n_players} {}
+
+  omp::HandEvaluator eval;
+  Deck deck;
+  Deal deal;
+  PublicDeal public_deal;
+  PokerState state;
+  // Sampled regret updates per node id since hot rows were last picked.
+  std::unordered_map<uint32_t, long> visits;
+  // Sampled regret updates per row of lazy regrets since they were last reordered.
+  std::unordered_map<size_t, long> row_visits;
+  // Node ids and lazy rows updated by sampled iterations, merged into the counts above between iterations.
+  VisitLog visit_log;
+  VisitLog row_visit_log;
+  bool count_visits = false;
+  // Pending regret deltas of the hot rows, indexed by HotRows::slot.
+  std::vector<long> hot_deltas;
+  long n_iterations = 0;
+  std::vector<std::unique_ptr<TraversalLane>> lanes;
+  // Public chance sampling scratch indexed by depth, recursion frames only hold pointers into it.
+  std::vector<std::unique_ptr<PcsFrame>> pcs_frames;
+};
+
+// Phi increments of a thread, dense over the phi values. Only preflop rows have phi values, so the deltas stay small.
+struct alignas(64) PhiBuffer {
+  std::vector<float> deltas;
+
+  void add(size_t idx) {
+    if(idx >= deltas.size()) deltas.resize(std::max(idx + 1, 2 * deltas.size()), 0.0f);
+    deltas[idx] += 1.0f;
+  }
+};
+
+// Regret matched strategy of the preflop rows, frozen at the preflop threshold. Preflop rows of pre-sized regrets come 
+// first in tree order, so the table is indexed like the regrets. Preflop histories of lazy regrets are scattered, their 
+// rows are packed and found through the sorted index ranges of the histories. Actions whose regret was below the prune 
+// cutoff stay prunable.
+class FrozenStrategy {
+public:
+  FrozenStrategy() = default;
+  FrozenStrategy(const StrategyStorage<int>& regrets, const GameTree& tree, int prune_cutoff);
+  // Freezes the preflop histories of lazy regrets that were visited from init_state.
+  FrozenStrategy(const StrategyStorage<int>& regrets, const PokerState& init_state, int prune_cutoff);
+  // Freezes preflop regrets gathered from all ranks of a distributed run, in the layout of the tree.
+  FrozenStrategy(const std::vector<int>& preflop, const GameTree& tree, int n_clusters, int prune_cutoff);
+
+  bool empty() const { return _freq.empty(); }
+  size_t size() const { return _freq.size(); }
+  bool contains(size_t idx) const { return _ranges.empty() ? idx < _freq.size() : packed(idx) >= 0; }
+  const float* row(size_t base_idx) const { return _freq.data() + (_ranges.empty() ? base_idx : packed(base_idx)); }
+  bool pruned(size_t idx) const { return _pruned[_ranges.empty() ? idx : packed(idx)]; }
+
+private:
+  template <class F>
+  void freeze_tree(const GameTree& tree, int n_clusters, int prune_cutoff, F&& load_row);
+
+  struct Range {
+    size_t begin;
+    size_t end;
+    size_t offset;
+  };
+
+  // Index of a lazy regret in the packed table, or -1 if it isn't frozen.
+  long packed(size_t idx) const {
+    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), idx, [](size_t i, const Range& range) { return i < range.begin; });
+    if(it == _ranges.begin()) return -1;
+    --it;
+    return idx < it->end ? static_cast<long>(it->offset + idx - it->begin) : -1;
+  }
+
+  std::vector<float> _freq;
+  std::vector<uint8_t> _pruned;
+  std::vector<Range> _ranges;
 };
 
 class BlueprintTrainer {
 public:
-  BlueprintTrainer(const BlueprintTrainerConfig& config = BlueprintTrainerConfig{}, bool enable_wandb = false, const std::string& snapshot_dir = "snapshots", const std::string& metrics_dir = "metrics");
+  BlueprintTrainer(const BlueprintTrainerConfig& config = BlueprintTrainerConfig{}, bool enable_wandb = false, const std::string& snapshot_dir = "snapshots", const std::string& metrics_dir = "metrics", 
+                   std::unique_ptr<Transport> transport = nullptr);
   void mccfr_p(long T);
   bool operator==(const BlueprintTrainer& other) const;
   const StrategyStorage<int>& get_regrets() const { return _regrets; }
   StrategyStorage<int>& get_regrets() { return _regrets; }
   const StrategyStorage<float>& get_phi() const { return _phi; }
+  StrategyStorage<float>& get_phi() { return _phi; }
   const BlueprintTrainerConfig& get_config() const { return _config; }
+  const GameTree* get_tree() const { return _tree.get(); }
+  // Node of a state in the compiled tree, nullptr without one. Rows of compiled trainers are indexed by node.
+  const TreeNode* find_node(const PokerState& state) const { return _tree ? _tree->find(state.get_action_history()) : nullptr; }
+  size_t regret_index(const PokerState& state, int cluster, int action = 0) const {
+    const TreeNode* node = find_node(state);
+    return node ? _regrets.index(*node, cluster, action) : _regrets.index(state, cluster, action);
+  }
+  size_t phi_index(const PokerState& state, int cluster, int action = 0) const {
+    const TreeNode* node = find_node(state);
+    if(node && node->round > 0) throw std::runtime_error("BlueprintTrainer --- Average strategy is only stored preflop.");
+    return node ? _phi.index(*node, cluster, action) : _phi.index(state, cluster, action);
+  }
   void set_snapshot_dir(std::string snapshot_dir) { _snapshot_dir = snapshot_dir; }
   void set_metrics_dir(std::string metrics_dir) { _metrics_dir = metrics_dir; }
   void set_verbose(bool verbose) { _verbose = verbose; }
   void set_verbose_update(bool verbose_update) { _verbose_update = verbose_update; }
+  // Without buffering, average strategy increments are applied to _phi directly under a critical section.
+  void set_phi_buffering(bool phi_buffering) { _phi_buffering = phi_buffering; }
+  // Trains as one rank of a distributed run. Every rank runs the iterations t with t % size == rank and merges the updates
+  // of the values given by value_owner. Ranks only allocate the values they own and read the others through a RowCache
+  // of config.cache_values, so the game that fits in memory grows with the ranks. Trainers given a transport at 
+  // construction never allocate the other values, trainers given one later release them.
+  void set_transport(std::unique_ptr<Transport> transport);
+  void save_delta(const std::string& fn) const;
+  void load_delta(const std::string& fn);
+  // Snapshot of an index file fn and n_shards compressed shards of the values of each storage next to it, which are
+  // written and read in parallel.
+  void save_compressed(const std::string& fn, int n_shards) const;
+  void load_compressed(const std::string& fn);
+  bool is_distributed() const { return _transport != nullptr; }
+  const RowCache& get_row_cache() const { return _row_cache; }
+  // Samples the action of the player to act at node (nullptr without a compiled tree) from the current strategy.
+  int sample_action(const TreeNode* node, int cluster, size_t base_idx, int n_actions) const;
 
   template <class Archive>
   void serialize(Archive& ar) {
     ar(_regrets, _phi, _config, _t);
+    if(Archive::is_loading::value) init_tree();
   }
 
 private:
-  int traverse_mccfr_p(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval);
-  int traverse_mccfr(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval);
-  void update_strategy(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands);
-  int utility(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval) const;
-  int showdown_payoff(const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval) const;
-  void log_metrics(long t);
+  void init_tree();
+  int node_actions(const PokerState& state, const TreeNode* node, Action* actions) const;
+  void deal_cards(Deck& deck, Deal& deal, const omp::HandEvaluator& eval, bool full_ranges) const;
+  void run_iteration(long t, WorkerContext& worker, bool full_ranges);
+  void run_interleaved(std::atomic<long>& next_t, long end_t, WorkerContext& worker, bool full_ranges);
+  Task<> interleaved_iteration(long t, TraversalLane& lane, WorkerContext& worker, bool full_ranges);
+  Task<int> traverse_interleaved(PokerState& state, const TreeNode* node, int i, const Deal& deal, const omp::HandEvaluator& eval, 
+                                 bool prune);
+  void update_regrets(const TreeNode* node, int cluster, size_t base_idx, int n_actions, const int* values, int v, 
+                      const bool* explored);
+  const TreeNode* root_node() const { return _tree ? &_tree->root() : nullptr; }
+  const TreeNode* next_node(const TreeNode* node, int a_idx) const { return node ? _tree->child(*node, a_idx) : nullptr; }
+  int traverse_mccfr_p(PokerState& state, const TreeNode* node, int i, const Deal& deal, const omp::HandEvaluator& eval);
+  int traverse_mccfr(PokerState& state, const TreeNode* node, int i, const Deal& deal, const omp::HandEvaluator& eval);
+  void traverse_public_chance(PokerState& state, int i, const PublicDeal& deal, WorkerContext& worker);
+  void traverse_pcs(PokerState& state, const TreeNode* node, int i, const PublicDeal& deal, const float* reach, float* values, 
+                    WorkerContext& worker, int depth);
+  void hand_strategies(const PokerState& state, const TreeNode* node, const PublicDeal& deal, int n_actions, PcsFrame& frame);
+  PcsFrame& pcs_frame(WorkerContext& worker, int depth) const;
+  void update_strategy(PokerState& state, const TreeNode* node, int i, const Deal& deal);
+  void merge_phi();
+  void add_phi(size_t idx);
+  void freeze_preflop();
+  void select_hot_rows(long n_sampled);
+  void count_visit(const TreeNode* node);
+  void count_row_visit(size_t base_idx);
+  void merge_visits(WorkerContext& worker);
+  void reorder_regrets();
+  long* hot_deltas(size_t base_idx);
+  void flush_hot(WorkerContext& worker);
+  void strategy(size_t base_idx, int n_actions, float* freq) const;
+  // Regret rows owned by other ranks are read from the row cache.
+  void load_regrets(size_t base_idx, int n_actions, int* regrets) const {
+    if(!_transport || _regrets.owns_row(base_idx, n_actions)) _regrets.load_row(base_idx, n_actions, regrets);
+    else _row_cache.load(base_idx, n_actions, regrets);
+  }
+  void prefetch_regrets(size_t base_idx) const {
+    if(!_transport || _regrets.owns(base_idx)) _regrets.prefetch_row(base_idx);
+    else _row_cache.prefetch_row(base_idx);
+  }
+  void refresh_row_sum(size_t base_idx, int n_actions);
+  void store_regrets(const TreeNode* node, int cluster, size_t base_idx, int n_actions, const int* regrets, long prev_positive);
+  void partition();
+  void sync_replicas();
+  std::string rank_suffix() const;
+  int utility(const PokerState& state, int i, const Deal& deal, const omp::HandEvaluator& eval) const;
+  void save_snapshot(const std::string& fn, bool delta = false);
+  void reap_snapshot(bool block);
+  void start_metrics();
+  void queue_metrics(long t);
+  void flush_metrics();
+  void stop_metrics();
+  void log_metrics(const MetricsSample& sample);
+  void add_positive_regret(long delta) {
+    auto& counter = _metrics->positive_regret[omp_get_thread_num()].value;
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+  }
 
 #ifdef UNIT_TEST
-  friend int call_traverse_mccfr(BlueprintTrainer& trainer, const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, 
+  friend int call_traverse_mccfr(BlueprintTrainer& trainer, PokerState& state, int i, const Deal& deal, 
                                  const omp::HandEvaluator& eval);
-  friend void call_update_strategy(BlueprintTrainer& trainer, const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands);
+  friend void call_update_strategy(BlueprintTrainer& trainer, PokerState& state, int i, const Deal& deal);
+  friend void call_run_iteration(BlueprintTrainer& trainer, long t, bool full_ranges);
+  friend void call_run_interval(BlueprintTrainer& trainer, long init_t, long end_t, bool full_ranges);
 #endif
   StrategyStorage<int> _regrets;
   StrategyStorage<float> _phi;
   BlueprintTrainerConfig _config;
+  std::unique_ptr<GameTree> _tree;
   std::filesystem::path _snapshot_dir;
   std::filesystem::path _metrics_dir;
   std::unique_ptr<wandb::Session> _wb;
   wandb::Run _wb_run;
   long _t;
+  int _max_actions;
   bool _verbose = false;
   bool _verbose_update = false;
+  pid_t _snapshot_pid = -1;
+  std::string _snapshot_fn;
+  // Delta snapshots since the last full snapshot, -1 until this run took a full snapshot and after a failed snapshot.
+  int _n_deltas = -1;
+  std::unique_ptr<MetricsChannel> _metrics;
+  // Average strategy increments of each thread, replayed into _phi in order by merge_phi.
+  std::vector<PhiBuffer> _phi_buffers;
+  bool _phi_buffering = true;
+  std::vector<std::unique_ptr<WorkerContext>> _workers;
+  // Empty until the preflop threshold. Preflop regrets and the average strategy are no longer updated once it is set.
+  FrozenStrategy _frozen;
+  // Empty unless config.row_sums is set.
+  RowSums _row_sums;
+  HotRows _hot_rows;
+  // Weight of every hole card combination in the initial range of each player, used by public chance sampling.
+  std::vector<std::array<float, N_HANDS>> _range_weights;
+  std::unique_ptr<Transport> _transport;
+  RowCache _row_cache;
+  std::vector<ReplicaBuffer> _replica_buffers;
+  // Owned blocks whose regrets changed since the last synchronization.
+  BlockMarks _changed;
+  // Average strategy increments of values owned by other ranks, sent at the next synchronization.
+  std::unordered_map<size_t, float> _remote_phi;
 };
 
+// Merges the snapshots of a distributed run, given in the order of their ranks, into one snapshot in fn. Every value is
+// taken from the rank that owns it, the snapshot of a rank holds zeros for all other values.
+void merge_replicas(const std::vector<std::string>& rank_fns, const std::string& fn);
+
+// Rebuilds a snapshot from a full snapshot, either a cereal archive or compressed, and the deltas taken after it, in order.
+BlueprintTrainer load_snapshot(const std::string& base_fn, const std::vector<std::string>& delta_fns);
+
 }
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <numeric>
+#include <numa.h>
+#include <numaif.h>
+#include <unistd.h>
+#include <pluribus/numa.hpp>
+
+namespace pluribus {
+
+int n_numa_nodes() {
+  return numa_available() < 0 ? 1 : numa_num_configured_nodes();
+}
+
+void pin_to_node(int node) {
+  if(numa_available() < 0) return;
+  if(numa_run_on_node(node) != 0) std::cout << "NUMA --- Failed to pin thread to node " << node << ".\n";
+}
+
+void interleave_pages(void* ptr, size_t bytes) {
+  if(numa_available() < 0 || n_numa_nodes() < 2) return;
+  numa_interleave_memory(ptr, bytes, numa_all_nodes_ptr);
+}
+
+std::vector<size_t> page_nodes(const void* ptr, size_t bytes, size_t max_samples) {
+  std::vector<size_t> pages(n_numa_nodes(), 0);
+  if(!ptr || bytes == 0) return pages;
+  size_t page_sz = sysconf(_SC_PAGESIZE);
+  uintptr_t begin = reinterpret_cast<uintptr_t>(ptr) / page_sz * page_sz;
+  size_t n_pages = (reinterpret_cast<uintptr_t>(ptr) + bytes - begin + page_sz - 1) / page_sz;
+  size_t step = std::max<size_t>(1, n_pages / max_samples);
+  std::vector<void*> samples;
+  for(size_t page = 0; page < n_pages; page += step) samples.push_back(reinterpret_cast<void*>(begin + page * page_sz));
+  std::vector<int> status(samples.size(), -1);
+  if(numa_available() < 0 || move_pages(0, samples.size(), samples.data(), nullptr, status.data(), 0) != 0) {
+    pages[0] = samples.size() * step;
+    return pages;
+  }
+  for(int node : status) {
+    if(node >= 0 && node < pages.size()) pages[node] += step;
+  }
+  return pages;
+}
+
+double remote_ratio(const std::vector<size_t>& pages, int n_threads) {
+  size_t total = std::accumulate(pages.begin(), pages.end(), size_t{0});
+  if(total == 0 || n_threads == 0) return 0.0;
+  double remote = 0.0;
+  for(int t = 0; t < n_threads; ++t) remote += 1.0 - static_cast<double>(pages[t % pages.size()]) / total;
+  return remote / n_threads;
+}
+
+std::string placement_str(const std::vector<size_t>& pages) {
+  size_t total = std::accumulate(pages.begin(), pages.end(), size_t{0});
+  std::ostringstream oss;
+  oss << std::setprecision(1) << std::fixed;
+  for(int node = 0; node < pages.size(); ++node) {
+    oss << (node > 0 ? ", " : "") << "node " << node << ": " << (total > 0 ? 100.0 * pages[node] / total : 0.0) << "%";
+  }
+  return oss.str();
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace pluribus {
+
+// Thin wrappers around libnuma. Without NUMA support the machine is a single node and placement calls do nothing.
+int n_numa_nodes();
+// Restricts the calling thread to the cpus of node.
+void pin_to_node(int node);
+// Interleaves the pages of [ptr, ptr + bytes) across all nodes. Must be called before the pages are first touched.
+void interleave_pages(void* ptr, size_t bytes);
+// Number of resident pages on each node, estimated from up to max_samples evenly spaced pages.
+std::vector<size_t> page_nodes(const void* ptr, size_t bytes, size_t max_samples = 4096);
+// Expected share of accesses to remote pages for n_threads threads pinned round-robin to the nodes, assuming every thread 
+// accesses all pages uniformly.
+double remote_ratio(const std::vector<size_t>& pages, int n_threads);
+std::string placement_str(const std::vector<size_t>& pages);
+
+}
@@ -57,6 +57,7 @@ void Player::reset(int chips) {
 }
 
 PokerState::PokerState(int n_players, int chips, int ante) : _pot{150}, _max_bet{100}, _bet_level{1}, _round{0}, _winner{-1} {
+  assert(n_players <= MAX_PLAYERS && "Too many players.");
   _players.reserve(n_players);
   for(int i = 0; i < n_players; ++i) {
     _players.push_back(Player{chips});
@@ -84,24 +85,54 @@ PokerState::PokerState(int n_players, int chips, int ante) : _pot{150}, _max_bet
 
 PokerState::PokerState(const PokerConfig& config) : PokerState{config.n_players, config.n_chips, config.ante} {}
 
-PokerState PokerState::next_state(Action action) const {
+void PokerState::next_state(Action action) {
   const Player& player = get_players()[get_active()];
-  if(action == Action::ALL_IN) return bet(player.get_chips());
-  if(action == Action::FOLD) return fold();
-  if(action == Action::CHECK_CALL) return player.get_betsize() == _max_bet ? check() : call();
-  return bet(total_bet_size(*this, action) - player.get_betsize());
+  if(action == Action::ALL_IN) bet(player.get_chips());
+  else if(action == Action::FOLD) fold();
+  else if(action == Action::CHECK_CALL) player.get_betsize() == _max_bet ? check() : call();
+  else bet(total_bet_size(*this, action) - player.get_betsize());
 }
 
 PokerState PokerState::apply(Action action) const {
-  PokerState state = next_state(action);
-  state._actions.push_back(action);
+  PokerState state = *this;
+  state.apply_in_place(action);
   return state;
 }
 
+StateDelta PokerState::apply_in_place(Action action) {
+  StateDelta delta;
+  std::copy(_players.begin(), _players.end(), delta.players.begin());
+  delta.pot = _pot;
+  delta.max_bet = _max_bet;
+  delta.active = _active;
+  delta.round = _round;
+  delta.bet_level = _bet_level;
+  delta.winner = _winner;
+  next_state(action);
+  _actions.push_back(action);
+  return delta;
+}
+
+void PokerState::undo(const StateDelta& delta) {
+  if(_round != delta.round) {
+    for(int i = 0; i < _players.size(); ++i) {
+      if(i != delta.active) _players[i] = delta.players[i];
+    }
+  }
+  _players[delta.active] = delta.players[delta.active];
+  _pot = delta.pot;
+  _max_bet = delta.max_bet;
+  _active = delta.active;
+  _round = delta.round;
+  _bet_level = delta.bet_level;
+  _winner = delta.winner;
+  _actions.pop_back();
+}
+
 PokerState PokerState::apply(const ActionHistory& action_history) const {
   PokerState state = *this;
   for(int i = 0; i < action_history.size(); ++i) {
-    state = state.apply(action_history.get(i));
+    state.apply_in_place(action_history.get(i));
   }
   return state;
 }
@@ -146,7 +177,7 @@ std::string PokerConfig::to_string() const {
   return oss.str();
 }
 
-PokerState PokerState::bet(int amount) const {
+void PokerState::bet(int amount) {
   if(verbose) std::cout << std::fixed << std::setprecision(2) << "Player " << static_cast<int>(_active) << " (" 
                         << (_players[_active].get_chips() / 100.0) << "): " << (_bet_level == 0 ? "Bet " : "Raise to ")
                         << ((amount + _players[_active].get_betsize()) / 100.0) << " bb\n";
@@ -155,16 +186,14 @@ PokerState PokerState::bet(int amount) const {
   assert(amount + _players[_active].get_betsize() > _max_bet && 
          "Attempted to bet but the players new betsize does not exceed the existing maximum bet.");
   assert(_winner == -1 && find_winner(*this) == -1 && "Attempted to bet but there are no opponents left.");
-  PokerState state = *this;
-  state._players[_active].invest(amount);
-  state._pot += amount;
-  state._max_bet = state._players[_active].get_betsize();
-  ++state._bet_level;
-  state.next_player();
-  return state;
+  _players[_active].invest(amount);
+  _pot += amount;
+  _max_bet = _players[_active].get_betsize();
+  ++_bet_level;
+  next_player();
 }
 
-PokerState PokerState::call() const {
+void PokerState::call() {
   int amount = _max_bet - _players[_active].get_betsize();
   if(verbose) std::cout << std::fixed << std::setprecision(2) << "Player " << static_cast<int>(_active) << " (" 
                         << (_players[_active].get_chips() / 100.0) << "): Call " << (amount / 100.0) << " bb\n";
@@ -173,42 +202,36 @@ PokerState PokerState::call() const {
   assert(_max_bet > _players[_active].get_betsize() && "Attempted call but player has already placed the maximum bet.");
   assert(_players[_active].get_chips() >= amount && "Not enough chips to call.");
   assert(_winner == -1 && find_winner(*this) == -1 && "Attempted to call but there are no opponents left.");
-  PokerState state = *this;
-  state._players[_active].invest(amount);
-  state._pot += amount;
-  state.next_player();
-  return state;
+  _players[_active].invest(amount);
+  _pot += amount;
+  next_player();
 }
 
-PokerState PokerState::check() const {
+void PokerState::check() {
   if(verbose) std::cout << std::fixed << std::setprecision(2) << "Player " << static_cast<int>(_active) << " (" 
                         << (_players[_active].get_chips() / 100.0) << "): Check\n";
   assert(!_players[_active].has_folded() && "Attempted to check but player already folded.");
   assert(_players[_active].get_betsize() == _max_bet && "Attempted check but a unmatched bet exists.");
   assert(_max_bet == 0 || (_round == 0 && _active == big_blind_idx(*this)) && "Attempted to check but a bet exists");
   assert(_winner == -1 && find_winner(*this) == -1 && "Attempted to check but there are no opponents left.");
-  PokerState state = *this;
-  state.next_player();
-  return state;
+  next_player();
 }
 
-PokerState PokerState::fold() const {
+void PokerState::fold() {
   if(verbose) std::cout << std::fixed << std::setprecision(2) << "Player " << static_cast<int>(_active) << " (" 
                         << (_players[_active].get_chips() / 100.0) << "): Fold\n";
   assert(!_players[_active].has_folded() && "Attempted to fold but player already folded.");
   assert(_max_bet > 0 && "Attempted fold but no bet exists.");
   assert(_players[_active].get_betsize() < _max_bet && "Attempted to fold but player can check");
   assert(_winner == -1 && find_winner(*this) == -1 && "Attempted to fold but there are no opponents left.");
-  PokerState state = *this;
-  state._players[_active].fold();
-  state._winner = find_winner(state);
-  if(state._winner == -1) {
-    state.next_player();
+  _players[_active].fold();
+  _winner = find_winner(*this);
+  if(_winner == -1) {
+    next_player();
   }
   else if(verbose) {
-    std::cout << "Only player " << static_cast<int>(state._winner) << " is remaining.\n";
+    std::cout << "Only player " << static_cast<int>(_winner) << " is remaining.\n";
   }
-  return state;
 }
 
 uint8_t increment(uint8_t i, uint8_t max_val) {
@@ -260,28 +283,40 @@ int total_bet_size(const PokerState& state, Action action) {
   }
 }
 
+bool is_valid(const PokerState& state, const Player& player, Action a) {
+  if(a == Action::CHECK_CALL) return true;
+  if(a == Action::FOLD) return player.get_betsize() < state.get_max_bet();
+  int total_bet = total_bet_size(state, a);
+  int required = total_bet - player.get_betsize();
+  return required <= player.get_chips() && total_bet > state.get_max_bet();
+}
+
+int valid_actions(const PokerState& state, const ActionProfile& profile, Action* valid) {
+  const std::vector<Action>& actions = profile.get_actions(state.get_round(), state.get_bet_level(), state.get_active());
+  const Player& player = state.get_players()[state.get_active()];
+  int n_valid = 0;
+  for(Action a : actions) {
+    if(is_valid(state, player, a)) valid[n_valid++] = a;
+  }
+  return n_valid;
+}
+
+int n_valid_actions(const PokerState& state, const ActionProfile& profile) {
+  const std::vector<Action>& actions = profile.get_actions(state.get_round(), state.get_bet_level(), state.get_active());
+  const Player& player = state.get_players()[state.get_active()];
+  int n_valid = 0;
+  for(Action a : actions) {
+    if(is_valid(state, player, a)) ++n_valid;
+  }
+  return n_valid;
+}
+
 std::vector<Action> valid_actions(const PokerState& state, const ActionProfile& profile) {
   const std::vector<Action>& actions = profile.get_actions(state.get_round(), state.get_bet_level(), state.get_active());
   std::vector<Action> valid;
   const Player& player = state.get_players()[state.get_active()];
   for(Action a : actions) {
-    if(a == Action::CHECK_CALL) {
-      valid.push_back(a);
-      continue;
-    }
-    else if(a == Action::FOLD) {
-      if(player.get_betsize() < state.get_max_bet()) {
-        valid.push_back(a);
-      }
-      continue;
-    }
-    else {
-      int total_bet = total_bet_size(state, a);
-      int required = total_bet - player.get_betsize();
-      if(required <= player.get_chips() && total_bet > state.get_max_bet()) {
-        valid.push_back(a);
-      }
-    }
+    if(is_valid(state, player, a)) valid.push_back(a);
   }
   return valid;
 }
@@ -88,6 +88,8 @@ inline Hand canonicalize(const Hand& hand) {
   return hand.cards()[0] > hand.cards()[1] ? hand : Hand{hand.cards()[1], hand.cards()[0]};
 }
 
+constexpr int MAX_PLAYERS = 9;
+
 class Player {
 public:
   Player(int chips = 10'000) : _chips{chips} {};
@@ -132,6 +134,8 @@ struct PokerConfig {
   int ante = 0;
 };
 
+struct StateDelta;
+
 class PokerState {
 public:
   PokerState(int n_players = 2, int chips = 10'000, int ante = 0);
@@ -154,6 +158,8 @@ public:
   inline bool is_terminal() const { return get_winner() != -1 || get_round() >= 4; };
   PokerState apply(Action action) const;
   PokerState apply(const ActionHistory& action_history) const;
+  StateDelta apply_in_place(Action action);
+  void undo(const StateDelta& delta);
   std::string to_string() const;
   
   template <class Archive>
@@ -171,16 +177,30 @@ private:
   uint8_t _bet_level;
   int8_t _winner;
 
-  PokerState bet(int amount) const;
-  PokerState call() const;
-  PokerState check() const;
-  PokerState fold() const;
-  PokerState next_state(Action action) const;
+  void bet(int amount);
+  void call();
+  void check();
+  void fold();
+  void next_state(Action action);
   void next_player();
   void next_round();
 };
 
+// Everything PokerState::apply_in_place overwrites. Only the acting player changes unless the action ends the round, 
+// in which case every player's bet size was reset and undo restores all players.
+struct StateDelta {
+  std::array<Player, MAX_PLAYERS> players;
+  int pot;
+  int max_bet;
+  uint8_t active;
+  uint8_t round;
+  uint8_t bet_level;
+  int8_t winner;
+};
+
 int total_bet_size(const PokerState& state, Action action);
+int valid_actions(const PokerState& state, const ActionProfile& profile, Action* valid);
+int n_valid_actions(const PokerState& state, const ActionProfile& profile);
 std::vector<Action> valid_actions(const PokerState& state, const ActionProfile& profile);
 
 std::vector<uint8_t> winners(const PokerState& state, const std::vector<Hand>& hands, const Board board_cards, const omp::HandEvaluator& eval);
@@ -1,4 +1,5 @@
 #include <numeric>
+#include <stdexcept>
 #include <pluribus/rng.hpp>
 #include <pluribus/range.hpp>
 #include <pluribus/poker.hpp>
@@ -30,16 +31,29 @@ float PokerRange::n_combos() const {
 }
 
 Hand PokerRange::sample(std::unordered_set<uint8_t> dead_cards) const {
+  uint64_t dead_mask = 0;
+  for(uint8_t card : dead_cards) dead_mask |= uint64_t{1} << card;
+  return sample_masked(dead_mask);
+}
+
+Hand PokerRange::sample_masked(uint64_t dead_cards) const {
   // TODO: Alias Method with Precomputed Table for performance
-  std::vector<float> masked_weights = _weights;
-  for(int i = 0; i < masked_weights.size(); ++i) {
-    Hand hand = HoleCardIndexer::get_instance()->hand(i);
-    if(dead_cards.find(hand.cards()[0]) != dead_cards.end() || dead_cards.find(hand.cards()[1]) != dead_cards.end()) {
-      masked_weights[i] = 0.0f;
-    }
+  auto indexer = HoleCardIndexer::get_instance();
+  auto is_live = [&](const Hand& hand) { return !((dead_cards >> hand.cards()[0] | dead_cards >> hand.cards()[1]) & 1); };
+  double total = 0.0;
+  for(int i = 0; i < _weights.size(); ++i) {
+    if(_weights[i] > 0.0f && is_live(indexer->hand(i))) total += _weights[i];
+  }
+  if(total <= 0.0) throw std::runtime_error("PokerRange --- No live hand to sample.");
+  double x = uniform_float(GlobalRNG::instance()) * total;
+  int last = -1;
+  for(int i = 0; i < _weights.size(); ++i) {
+    if(_weights[i] <= 0.0f || !is_live(indexer->hand(i))) continue;
+    last = i;
+    x -= _weights[i];
+    if(x < 0.0) break;
   }
-  std::discrete_distribution<> dist(masked_weights.begin(), masked_weights.end());
-  return HoleCardIndexer::get_instance()->hand(dist(GlobalRNG::instance()));
+  return indexer->hand(last);
 }
 
 PokerRange& PokerRange::operator+=(const PokerRange& other) { 
@@ -50,6 +50,8 @@ public:
   const std::vector<float>& weights() { return _weights; }
   float n_combos() const;
   Hand sample(std::unordered_set<uint8_t> dead_cards = {}) const;
+  // Samples a hand without any card whose bit is set in dead_cards. Doesn't allocate.
+  Hand sample_masked(uint64_t dead_cards) const;
 
   PokerRange& operator+=(const PokerRange& other);
   PokerRange& operator*=(const PokerRange& other);
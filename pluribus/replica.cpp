@@ -0,0 +1,134 @@
+#include <bit>
+#include <stdexcept>
+#include <pluribus/replica.hpp>
+
+namespace pluribus {
+
+BlockMarks::BlockMarks(size_t n_values) : _n_words{((n_values >> OWNER_BITS) + 64) / 64} {
+  _words = std::make_unique<std::atomic<uint64_t>[]>(_n_words);
+  clear();
+}
+
+std::vector<size_t> BlockMarks::blocks() const {
+  std::vector<size_t> blocks;
+  for(size_t w_idx = 0; w_idx < _n_words; ++w_idx) {
+    uint64_t word = _words[w_idx].load(std::memory_order_relaxed);
+    while(word) {
+      blocks.push_back(w_idx * 64 + std::countr_zero(word));
+      word &= word - 1;
+    }
+  }
+  return blocks;
+}
+
+void BlockMarks::clear() {
+  for(size_t w_idx = 0; w_idx < _n_words; ++w_idx) _words[w_idx].store(0, std::memory_order_relaxed);
+}
+
+RowCache::RowCache(size_t capacity) : _capacity{capacity} {
+  if(_capacity == 0) return;
+  if(_capacity >= NO_ROOM) throw std::runtime_error("RowCache --- Capacity out of range.");
+  _n_slots = std::bit_ceil(_capacity);
+  _shift = 64 - std::countr_zero(_n_slots);
+  _slots = std::make_unique<Slot[]>(_n_slots);
+  _values = std::make_unique<std::atomic<int>[]>(_capacity);
+  _fetched = std::make_unique<int[]>(_capacity);
+}
+
+RowCache::RowCache(RowCache&& other) noexcept
+    : _capacity{other._capacity}, _n_slots{other._n_slots}, _shift{other._shift}, _slots{std::move(other._slots)},
+      _values{std::move(other._values)}, _fetched{std::move(other._fetched)}, _n_rows{other._n_rows.load()},
+      _n_values{other._n_values.load()} {
+  other._capacity = 0;
+  other._n_slots = 0;
+}
+
+RowCache& RowCache::operator=(RowCache&& other) noexcept {
+  _capacity = other._capacity;
+  _n_slots = other._n_slots;
+  _shift = other._shift;
+  _slots = std::move(other._slots);
+  _values = std::move(other._values);
+  _fetched = std::move(other._fetched);
+  _n_rows.store(other._n_rows.load());
+  _n_values.store(other._n_values.load());
+  other._capacity = 0;
+  other._n_slots = 0;
+  return *this;
+}
+
+// Linear probing. The thread which claims the key of an empty slot reserves the values of the row, the others wait until
+// the offset is published. Keys are never removed while a cache is in use, so a probe ends at the first empty slot.
+long RowCache::find_or_add(size_t base_idx, int n_actions, bool use) const {
+  if(_n_slots == 0) return -1;
+  for(size_t s_idx = home(base_idx);; s_idx = (s_idx + 1) & (_n_slots - 1)) {
+    Slot& slot = _slots[s_idx];
+    size_t key = slot.key.load(std::memory_order_acquire);
+    if(key == EMPTY) {
+      if(_n_rows.load(std::memory_order_relaxed) >= _n_slots / 2) return -1;
+      if(!slot.key.compare_exchange_strong(key, base_idx, std::memory_order_acq_rel) && key != base_idx) continue;
+      if(key == EMPTY) {
+        _n_rows.fetch_add(1, std::memory_order_relaxed);
+        slot.n_actions = n_actions;
+        if(use) slot.flags.store(USED, std::memory_order_relaxed);
+        size_t offset = _n_values.fetch_add(n_actions, std::memory_order_relaxed);
+        if(offset + n_actions > _capacity) {
+          slot.offset.store(NO_ROOM, std::memory_order_release);
+          return -1;
+        }
+        for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+          _values[offset + a_idx].store(0, std::memory_order_relaxed);
+          _fetched[offset + a_idx] = 0;
+        }
+        slot.offset.store(offset, std::memory_order_release);
+        return offset;
+      }
+    }
+    if(key != base_idx) continue;
+    if(use && !(slot.flags.load(std::memory_order_relaxed) & USED)) slot.flags.fetch_or(USED, std::memory_order_relaxed);
+    uint32_t offset;
+    while((offset = slot.offset.load(std::memory_order_acquire)) == PENDING);
+    return offset == NO_ROOM ? -1 : static_cast<long>(offset);
+  }
+}
+
+std::vector<std::pair<size_t, int>> RowCache::unfetched() const {
+  std::vector<std::pair<size_t, int>> rows;
+  for(size_t s_idx = 0; s_idx < _n_slots; ++s_idx) {
+    if(slot_offset(s_idx) >= 0 && !(_slots[s_idx].flags.load(std::memory_order_relaxed) & FETCHED)) {
+      rows.emplace_back(_slots[s_idx].key.load(std::memory_order_relaxed), _slots[s_idx].n_actions);
+    }
+  }
+  return rows;
+}
+
+void RowCache::fill(size_t base_idx, const int* values) {
+  for(size_t s_idx = home(base_idx);; s_idx = (s_idx + 1) & (_n_slots - 1)) {
+    Slot& slot = _slots[s_idx];
+    size_t key = slot.key.load(std::memory_order_relaxed);
+    if(key == EMPTY) throw std::runtime_error("RowCache --- Filled a row which is not cached.");
+    if(key != base_idx) continue;
+    long offset = slot_offset(s_idx);
+    if(offset < 0) throw std::runtime_error("RowCache --- Filled a row without room.");
+    for(int a_idx = 0; a_idx < slot.n_actions; ++a_idx) {
+      _values[offset + a_idx].store(values[a_idx], std::memory_order_relaxed);
+      _fetched[offset + a_idx] = values[a_idx];
+    }
+    slot.flags.fetch_or(FETCHED, std::memory_order_relaxed);
+    return;
+  }
+}
+
+void RowCache::discount(double d) {
+  for(size_t s_idx = 0; s_idx < _n_slots; ++s_idx) {
+    long offset = slot_offset(s_idx);
+    if(offset < 0) continue;
+    for(int a_idx = 0; a_idx < _slots[s_idx].n_actions; ++a_idx) {
+      _values[offset + a_idx].store(_values[offset + a_idx].load(std::memory_order_relaxed) * d, std::memory_order_relaxed);
+      _fetched[offset + a_idx] *= d;
+    }
+    _slots[s_idx].flags.fetch_and(~FETCHED, std::memory_order_relaxed);
+  }
+}
+
+}
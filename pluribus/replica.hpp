@@ -0,0 +1,230 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cereal/cereal.hpp>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/vector.hpp>
+#include <pluribus/actions.hpp>
+
+namespace pluribus {
+
+// Every rank of a distributed run allocates only the regrets and average strategy values it owns. Values are owned in
+// blocks of 2^OWNER_BITS consecutive indices dealt round-robin to the ranks, so every rank owns a similar share of every
+// round. Rows of other ranks are read and written through a RowCache.
+constexpr int OWNER_BITS = 12;
+
+inline int value_owner(size_t idx, int n_ranks) { return (idx >> OWNER_BITS) % n_ranks; }
+
+// Values sent between ranks at a synchronization. Rows are sent as their first index, their number of actions and one
+// value per action: regret deltas to the owners, read requests without values and the replies of the owners, which only
+// fill the values they own. Average strategy increments are sent to the owners and owners announce the blocks they
+// changed.
+struct ReplicaBatch {
+  std::vector<size_t> row_idxs;
+  std::vector<uint8_t> row_actions;
+  std::vector<long> row_values;
+  std::vector<size_t> phi_idxs;
+  std::vector<float> phi_values;
+  std::vector<size_t> blocks;
+
+  template <class T>
+  void add_row(size_t base_idx, int n_actions, const T* values) {
+    row_idxs.push_back(base_idx);
+    row_actions.push_back(n_actions);
+    if(values) row_values.insert(row_values.end(), values, values + n_actions);
+  }
+
+  std::string pack() const {
+    std::ostringstream os;
+    {
+      cereal::BinaryOutputArchive oarchive(os);
+      oarchive(*this);
+    }
+    return os.str();
+  }
+
+  static ReplicaBatch unpack(const std::string& msg) {
+    std::istringstream is(msg);
+    cereal::BinaryInputArchive iarchive(is);
+    ReplicaBatch batch;
+    iarchive(batch);
+    return batch;
+  }
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar(row_idxs, row_actions, row_values, phi_idxs, phi_values, blocks);
+  }
+};
+
+// Deltas of remote rows of one thread which found no room in the row cache.
+struct alignas(64) ReplicaBuffer {
+  ReplicaBatch deltas;
+};
+
+// One bit per owner block, set by the writers of the block. Marking a block that is already marked is a single load.
+class BlockMarks {
+public:
+  BlockMarks() = default;
+  explicit BlockMarks(size_t n_values);
+
+  void mark(size_t base_idx, int n_actions) {
+    mark_block(base_idx >> OWNER_BITS);
+    mark_block((base_idx + n_actions - 1) >> OWNER_BITS);
+  }
+  void mark_block(size_t block) {
+    std::atomic<uint64_t>& word = _words[block / 64];
+    uint64_t bit = uint64_t{1} << block % 64;
+    if(!(word.load(std::memory_order_relaxed) & bit)) word.fetch_or(bit, std::memory_order_relaxed);
+  }
+  bool test(size_t base_idx, int n_actions) const {
+    return test_block(base_idx >> OWNER_BITS) || test_block((base_idx + n_actions - 1) >> OWNER_BITS);
+  }
+  bool test_block(size_t block) const { return _words[block / 64].load(std::memory_order_relaxed) >> block % 64 & 1; }
+  std::vector<size_t> blocks() const;
+  void clear();
+
+private:
+  std::unique_ptr<std::atomic<uint64_t>[]> _words;
+  size_t _n_words = 0;
+};
+
+// Bounded cache of regret rows owned by other ranks, filled by batched reads at every synchronization. A row that isn't
+// cached reads as zero and is added on its first access, the next synchronization fetches it from its owners. Writes
+// update the cached values, the difference to the fetched values is sent to the owners at the next synchronization. Rows
+// are added lock-free until the values or half of the slots are taken, later rows get no room until the cache is
+// rebuilt. Lookups and additions are logically const, since a new row reads like a missing one.
+class RowCache {
+public:
+  RowCache() = default;
+  // capacity is the number of cached values.
+  explicit RowCache(size_t capacity);
+  RowCache(RowCache&& other) noexcept;
+  RowCache& operator=(RowCache&& other) noexcept;
+
+  bool empty() const { return _capacity == 0; }
+  size_t capacity() const { return _capacity; }
+  size_t n_rows() const { return _n_rows.load(std::memory_order_relaxed); }
+
+  // Copies a cached row, zero if it has not been fetched yet. Returns false if the row has no room.
+  bool load(size_t base_idx, int n_actions, int* values) const {
+    long offset = find_or_add(base_idx, n_actions);
+    if(offset < 0) {
+      std::fill(values, values + n_actions, 0);
+      return false;
+    }
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) values[a_idx] = _values[offset + a_idx].load(std::memory_order_relaxed);
+    return true;
+  }
+
+  // Returns false if the row has no room, its values then are deltas to zero.
+  bool store(size_t base_idx, int n_actions, const int* values) {
+    long offset = find_or_add(base_idx, n_actions);
+    if(offset < 0) return false;
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) _values[offset + a_idx].store(values[a_idx], std::memory_order_relaxed);
+    return true;
+  }
+
+  void prefetch_row(size_t base_idx) const { __builtin_prefetch(&_slots[home(base_idx)]); }
+
+  // Calls f(base_idx, n_actions, deltas) for every row written since it was fetched.
+  template <class F>
+  void for_each_delta(F&& f) const {
+    for(size_t s_idx = 0; s_idx < _n_slots; ++s_idx) {
+      long offset = slot_offset(s_idx);
+      if(offset < 0) continue;
+      int n_actions = _slots[s_idx].n_actions;
+      std::array<long, MAX_ACTIONS> deltas;
+      bool changed = false;
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        deltas[a_idx] = static_cast<long>(_values[offset + a_idx].load(std::memory_order_relaxed)) - _fetched[offset + a_idx];
+        changed = changed || deltas[a_idx] != 0;
+      }
+      if(changed) f(_slots[s_idx].key.load(std::memory_order_relaxed), n_actions, deltas.data());
+    }
+  }
+
+  // Cache for the next interval, once the deltas were sent. Rows used since the last synchronization are kept, fetched
+  // rows first. Kept rows that need no refresh are copied, the other rows read as zero until they are filled.
+  // needs_fetch(base_idx, n_actions) tells if a fetched row changed at its owners.
+  template <class F>
+  RowCache rebuild(F&& needs_fetch) const {
+    RowCache next{_capacity};
+    for(bool fetched : {true, false}) {
+      for(size_t s_idx = 0; s_idx < _n_slots; ++s_idx) {
+        const Slot& slot = _slots[s_idx];
+        size_t base_idx = slot.key.load(std::memory_order_relaxed);
+        if(base_idx == EMPTY || !(slot.flags.load(std::memory_order_relaxed) & USED)) continue;
+        long offset = slot_offset(s_idx);
+        bool is_fetched = offset >= 0 && slot.flags.load(std::memory_order_relaxed) & FETCHED;
+        if(is_fetched != fetched) continue;
+        if(next.find_or_add(base_idx, slot.n_actions, false) < 0) return next;
+        if(is_fetched && !needs_fetch(base_idx, slot.n_actions)) {
+          std::array<int, MAX_ACTIONS> values;
+          for(int a_idx = 0; a_idx < slot.n_actions; ++a_idx) values[a_idx] = _values[offset + a_idx].load(std::memory_order_relaxed);
+          next.fill(base_idx, values.data());
+        }
+      }
+    }
+    return next;
+  }
+
+  // Rows which have not been fetched yet, in slot order.
+  std::vector<std::pair<size_t, int>> unfetched() const;
+  // Sets the fetched values of a row. Rows may be filled once.
+  void fill(size_t base_idx, const int* values);
+  // Scales all rows like a discount of their owners. Rows are fetched again at the next synchronization, since the owners
+  // round each of their pages by the factors it missed at once.
+  void discount(double d);
+  // Calls f(base_idx, n_actions, values) for every fetched row.
+  template <class F>
+  void for_each_row(F&& f) const {
+    for(size_t s_idx = 0; s_idx < _n_slots; ++s_idx) {
+      long offset = slot_offset(s_idx);
+      if(offset < 0 || !(_slots[s_idx].flags.load(std::memory_order_relaxed) & FETCHED)) continue;
+      std::array<int, MAX_ACTIONS> values;
+      for(int a_idx = 0; a_idx < _slots[s_idx].n_actions; ++a_idx) values[a_idx] = _values[offset + a_idx].load(std::memory_order_relaxed);
+      f(_slots[s_idx].key.load(std::memory_order_relaxed), _slots[s_idx].n_actions, values.data());
+    }
+  }
+
+private:
+  static constexpr size_t EMPTY = SIZE_MAX;
+  static constexpr uint32_t PENDING = UINT32_MAX;
+  static constexpr uint32_t NO_ROOM = UINT32_MAX - 1;
+  static constexpr uint8_t USED = 1;
+  static constexpr uint8_t FETCHED = 2;
+
+  struct Slot {
+    std::atomic<size_t> key{EMPTY};
+    std::atomic<uint32_t> offset{PENDING};
+    uint8_t n_actions = 0;
+    std::atomic<uint8_t> flags{0};
+  };
+
+  size_t home(size_t base_idx) const { return (base_idx * 0x9E3779B97F4A7C15ull) >> _shift; }
+  long slot_offset(size_t s_idx) const {
+    if(_slots[s_idx].key.load(std::memory_order_relaxed) == EMPTY) return -1;
+    uint32_t offset = _slots[s_idx].offset.load(std::memory_order_acquire);
+    return offset >= NO_ROOM ? -1 : static_cast<long>(offset);
+  }
+  // Offset of the values of a row, or -1 if it has no room. Rows found by a traversal are marked as used.
+  long find_or_add(size_t base_idx, int n_actions, bool use = true) const;
+
+  size_t _capacity = 0;
+  size_t _n_slots = 0;
+  int _shift = 64;
+  std::unique_ptr<Slot[]> _slots;
+  std::unique_ptr<std::atomic<int>[]> _values;
+  std::unique_ptr<int[]> _fetched;
+  mutable std::atomic<size_t> _n_rows{0};
+  mutable std::atomic<size_t> _n_values{0};
+};
+
+}
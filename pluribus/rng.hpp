@@ -1,12 +1,43 @@
+#pragma once
+
 #include <iostream>
 #include <random>
 #include <thread>
+#include <atomic>
+#include <cstdint>
+#include <omp/Random.h>
+
+using RNG = omp::XoroShiro128Plus;
+
+// SplitMix64 finalizer. Turns correlated keys like consecutive iterations into well mixed generator seeds.
+inline uint64_t splitmix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+inline uint64_t stream_seed(uint64_t seed, uint64_t stream) {
+  return splitmix64(splitmix64(seed) + stream);
+}
+
+// Uniform float in [0, 1) from the high bits, which are the strongest bits of xoroshiro128+.
+inline float uniform_float(RNG& rng) {
+  return (rng() >> 40) * 0x1.0p-24f;
+}
 
 class GlobalRNG {
 public:
-  static std::mt19937& instance() {
-    thread_local std::mt19937 rng(42);
-    // thread_local std::mt19937 rng(std::random_device{}());
+  // Every thread starts on its own stream. Streams with the top bit set are reserved for threads.
+  static RNG& instance() {
+    static std::atomic<uint64_t> n_threads = 0;
+    thread_local RNG rng{stream_seed(42, (1ull << 63) | n_threads++)};
     return rng;
   }
+
+  // Restarts the generator of the calling thread at the stream of (seed, stream). Reseeding with the iteration as the
+  // stream makes the draws of each iteration independent of which thread runs it.
+  static void seed(uint64_t seed, uint64_t stream) {
+    instance() = RNG{stream_seed(seed, stream)};
+  }
 };
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <immintrin.h>
+#include <pluribus/simd.hpp>
+
+namespace pluribus {
+
+bool has_avx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+bool has_avx512() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f");
+}
+
+template <class T>
+void scalar_kernel(const T* values, int n, float* freq) {
+  float sum = 0.0f;
+  for(int a_idx = 0; a_idx < n; ++a_idx) sum += std::max(static_cast<float>(values[a_idx]), 0.0f);
+  if(sum > 0.0f) {
+    float inv = 1.0f / sum;
+    for(int a_idx = 0; a_idx < n; ++a_idx) freq[a_idx] = std::max(static_cast<float>(values[a_idx]), 0.0f) * inv;
+  }
+  else {
+    std::fill(freq, freq + n, 1.0f / n);
+  }
+}
+
+void regret_matching_scalar(const int* values, int n, float* freq) { scalar_kernel(values, n, freq); }
+void regret_matching_scalar(const float* values, int n, float* freq) { scalar_kernel(values, n, freq); }
+
+__attribute__((target("avx2"))) inline __m256i avx2_tail_mask(int remaining) {
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+__attribute__((target("avx2"))) inline __m256 avx2_positive(const int* values, __m256i mask) {
+  return _mm256_cvtepi32_ps(_mm256_max_epi32(_mm256_maskload_epi32(values, mask), _mm256_setzero_si256()));
+}
+
+__attribute__((target("avx2"))) inline __m256 avx2_positive(const float* values, __m256i mask) {
+  return _mm256_max_ps(_mm256_maskload_ps(values, mask), _mm256_setzero_ps());
+}
+
+template <class T>
+__attribute__((target("avx2"))) void avx2_kernel(const T* values, int n, float* freq) {
+  __m256 acc = _mm256_setzero_ps();
+  for(int a_idx = 0; a_idx < n; a_idx += 8) {
+    acc = _mm256_add_ps(acc, avx2_positive(values + a_idx, avx2_tail_mask(n - a_idx)));
+  }
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+  float sum = _mm_cvtss_f32(half);
+
+  __m256 scale = _mm256_set1_ps(sum > 0.0f ? 1.0f / sum : 0.0f);
+  for(int a_idx = 0; a_idx < n; a_idx += 8) {
+    __m256i mask = avx2_tail_mask(n - a_idx);
+    __m256 f = sum > 0.0f ? _mm256_mul_ps(avx2_positive(values + a_idx, mask), scale) : _mm256_set1_ps(1.0f / n);
+    _mm256_maskstore_ps(freq + a_idx, mask, f);
+  }
+}
+
+void regret_matching_avx2(const int* values, int n, float* freq) { avx2_kernel(values, n, freq); }
+void regret_matching_avx2(const float* values, int n, float* freq) { avx2_kernel(values, n, freq); }
+
+__attribute__((target("avx512f"))) inline __mmask16 avx512_tail_mask(int remaining) {
+  return remaining >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << remaining) - 1);
+}
+
+__attribute__((target("avx512f"))) inline __m512 avx512_positive(const int* values, __mmask16 mask) {
+  return _mm512_cvtepi32_ps(_mm512_max_epi32(_mm512_maskz_loadu_epi32(mask, values), _mm512_setzero_si512()));
+}
+
+__attribute__((target("avx512f"))) inline __m512 avx512_positive(const float* values, __mmask16 mask) {
+  return _mm512_max_ps(_mm512_maskz_loadu_ps(mask, values), _mm512_setzero_ps());
+}
+
+template <class T>
+__attribute__((target("avx512f"))) void avx512_kernel(const T* values, int n, float* freq) {
+  __m512 acc = _mm512_setzero_ps();
+  for(int a_idx = 0; a_idx < n; a_idx += 16) {
+    acc = _mm512_add_ps(acc, avx512_positive(values + a_idx, avx512_tail_mask(n - a_idx)));
+  }
+  float sum = _mm512_reduce_add_ps(acc);
+
+  __m512 scale = _mm512_set1_ps(sum > 0.0f ? 1.0f / sum : 0.0f);
+  for(int a_idx = 0; a_idx < n; a_idx += 16) {
+    __mmask16 mask = avx512_tail_mask(n - a_idx);
+    __m512 f = sum > 0.0f ? _mm512_mul_ps(avx512_positive(values + a_idx, mask), scale) : _mm512_set1_ps(1.0f / n);
+    _mm512_mask_storeu_ps(freq + a_idx, mask, f);
+  }
+}
+
+void regret_matching_avx512(const int* values, int n, float* freq) { avx512_kernel(values, n, freq); }
+void regret_matching_avx512(const float* values, int n, float* freq) { avx512_kernel(values, n, freq); }
+
+template <class T>
+using Kernel = void (*)(const T*, int, float*);
+
+template <class T>
+Kernel<T> select_kernel() {
+  if(has_avx512()) return regret_matching_avx512;
+  if(has_avx2()) return regret_matching_avx2;
+  return regret_matching_scalar;
+}
+
+const Kernel<int> int_kernel = select_kernel<int>();
+const Kernel<float> float_kernel = select_kernel<float>();
+
+void regret_matching(const int* values, int n, float* freq) { int_kernel(values, n, freq); }
+void regret_matching(const float* values, int n, float* freq) { float_kernel(values, n, freq); }
+
+}
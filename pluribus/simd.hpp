@@ -0,0 +1,21 @@
+#pragma once
+
+namespace pluribus {
+
+// Regret matching of one contiguous row: freq[a] = max(R[a], 0) / sum_b max(R[b], 0), or 1 / n if no regret is positive.
+// regret_matching dispatches to the widest kernel the CPU supports. The vector kernels mask the tail of the row, so rows
+// need no padding and exactly n values are read and n frequencies written.
+void regret_matching(const int* values, int n, float* freq);
+void regret_matching(const float* values, int n, float* freq);
+
+void regret_matching_scalar(const int* values, int n, float* freq);
+void regret_matching_scalar(const float* values, int n, float* freq);
+void regret_matching_avx2(const int* values, int n, float* freq);
+void regret_matching_avx2(const float* values, int n, float* freq);
+void regret_matching_avx512(const int* values, int n, float* freq);
+void regret_matching_avx512(const float* values, int n, float* freq);
+
+bool has_avx2();
+bool has_avx512();
+
+}
@@ -5,6 +5,7 @@
 #include <tqdm/tqdm.hpp>
 #include <omp/HandEvaluator.h>
 #include <pluribus/util.hpp>
+#include <pluribus/rng.hpp>
 #include <pluribus/poker.hpp>
 #include <pluribus/debug.hpp>
 #include <pluribus/simulate.hpp>
@@ -34,7 +35,7 @@ std::vector<long> get_payoffs(const Board& board, const std::vector<Hand>& hands
   return payoffs;
 }
 
-std::vector<long> simulate(const std::vector<Agent*>& agents, const PokerConfig& config, long n_iter) {
+std::vector<long> simulate(const std::vector<Agent*>& agents, const PokerConfig& config, long n_iter, uint64_t seed) {
   std::vector<std::vector<long>> thread_results{agents.size()};
   int ntid = omp_get_max_threads();
   long log_interval = n_iter / ntid / 100;
@@ -49,6 +50,8 @@ std::vector<long> simulate(const std::vector<Agent*>& agents, const PokerConfig&
     int tid = omp_get_thread_num();
     if(tid == 0 && t % log_interval == 0) std::cout << "Sim: " << std::setprecision(1) << std::fixed << t / static_cast<double>(log_interval) << "%\n";
     PokerState state(config);
+    GlobalRNG::seed(seed, t);
+    deck.reset();
     deck.shuffle();
     board.deal(deck);
     for(Hand& hand : hands) hand.deal(deck);
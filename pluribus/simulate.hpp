@@ -1,12 +1,13 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include <pluribus/poker.hpp>
 #include <pluribus/agent.hpp>
 
 namespace pluribus {
 
-std::vector<long> simulate(const std::vector<Agent*>& agents, const PokerConfig& config, long n_iter);
+std::vector<long> simulate(const std::vector<Agent*>& agents, const PokerConfig& config, long n_iter, uint64_t seed = 42);
 std::vector<long> simulate_round(const Board& board, const std::vector<Hand>& hands, const ActionHistory& actions, const PokerConfig& config);
 
 }
@@ -1,7 +1,16 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
 #include <filesystem>
 #include <mutex>
 #include <condition_variable>
@@ -16,6 +25,11 @@
 #include <pluribus/infoset.hpp>
 #include <pluribus/history_index.hpp>
 #include <pluribus/actions.hpp>
+#include <pluribus/tree.hpp>
+#include <pluribus/block.hpp>
+#include <pluribus/compact.hpp>
+#include <pluribus/replica.hpp>
+#include <pluribus/rng.hpp>
 
 namespace pluribus {
 
@@ -42,6 +56,32 @@ struct HistoryEntry {
   std::atomic<bool> ready;
 };
 
+// Miss rate of a cache that holds the capacity most visited lines, given the visits of every line. Layouts are compared 
+// by it, the absolute value is only a model.
+inline double modeled_miss_rate(const std::unordered_map<size_t, long>& line_visits, size_t capacity) {
+  std::vector<long> visits;
+  long total = 0;
+  for(const auto& [line, count] : line_visits) {
+    visits.push_back(count);
+    total += count;
+  }
+  if(total == 0) return 0.0;
+  size_t n_cached = std::min(capacity, visits.size());
+  std::nth_element(visits.begin(), visits.begin() + n_cached, visits.end(), std::greater<>{});
+  long hits = 0;
+  for(size_t l_idx = 0; l_idx < n_cached; ++l_idx) hits += visits[l_idx];
+  return 1.0 - static_cast<double>(hits) / total;
+}
+
+struct ReorderStats {
+  size_t hot_histories = 0;
+  double miss_rate_before = 0.0;
+  double miss_rate_after = 0.0;
+  // Measured nanoseconds per row of the sampled visits, replayed in random order on either layout.
+  double sweep_ns_before = 0.0;
+  double sweep_ns_after = 0.0;
+};
+
 template<class T>
 class StrategyStorage {
 public:
@@ -50,15 +90,27 @@ public:
 
   StrategyStorage(int n_players = 2, int n_clusters = 200) : StrategyStorage{BlueprintActionProfile{n_players}, n_clusters} {}
 
-  StrategyStorage(const StrategyStorage& other) 
-      : _data(other._data), 
-        _history_map(other._history_map), 
-        _action_profile(other._action_profile), 
-        _n_clusters(other._n_clusters) {
-  }
+  // A copy would have to settle pending discounts and duplicate every block, storage is only moved.
+  StrategyStorage(const StrategyStorage& other) = delete;
 
   StrategyStorage(StrategyStorage&& other) noexcept 
       : _data(std::move(other._data)), 
+        _block(std::move(other._block)),
+        _segments(std::move(other._segments)),
+        _precision(other._precision),
+        _floor(other._floor),
+        _presized_size(other._presized_size),
+        _compact_begin(other._compact_begin),
+        _block_end(other._block_end),
+        _rank(other._rank),
+        _n_ranks(other._n_ranks),
+        _huge_pages(other._huge_pages),
+        _interleave(other._interleave),
+        _page_epochs(std::move(other._page_epochs)),
+        _discounts(std::move(other._discounts)),
+        _dirty(std::move(other._dirty)),
+        _checkpoint_epoch(other._checkpoint_epoch),
+        _tree(other._tree),
         _history_map(std::move(other._history_map)), 
         _action_profile(std::move(other._action_profile)), 
         _n_clusters(other._n_clusters) {
@@ -66,23 +118,162 @@ public:
 
   inline const tbb::concurrent_vector<std::atomic<T>>& data() const { return _data; }
   inline tbb::concurrent_vector<std::atomic<T>>& data() { return _data; }
-  inline const tbb::concurrent_unordered_map<ActionHistory, HistoryEntry> history_map() const { return _history_map; }
+  // Only lazy storage has a history map. Pre-sized storage resolves histories through its game tree.
+  inline const tbb::concurrent_unordered_map<ActionHistory, HistoryEntry>& history_map() const { return _history_map; }
   inline const ActionProfile& action_profile() const { return _action_profile; }
   inline int n_clusters() const { return _n_clusters; }
+  // Storage is pre-sized if it was allocated from a game tree. Pre-sized storage never grows and is not bounds checked.
+  inline bool is_presized() const { return _presized_size > 0; }
+  inline size_t size() const { return is_presized() ? _presized_size : _data.size(); }
+  inline bool is_compact() const { return !_segments.empty(); }
+  inline const std::array<Precision, 4>& precision() const { return _precision; }
+  // Values held in memory. Partitioned storage only holds the pages of its rank.
+  inline size_t n_allocated() const { return is_presized() ? _block.size() + size() - std::min(size(), _block_end) : _data.size(); }
+  // Whether a value is held by this rank. Rows of other ranks must not be loaded or stored, get reads them as zero.
+  inline bool owns(size_t idx) const { return _n_ranks == 1 || value_owner(idx, _n_ranks) == _rank; }
+  inline bool owns_row(size_t base_idx, int n_actions) const { return owns(base_idx) && owns(base_idx + n_actions - 1); }
 
+  // Direct access to full precision values. Values of compact rounds have to go through get/set or the row functions.
   std::atomic<T>& operator[](size_t idx) { 
-    if(idx >= _data.size()) throw std::runtime_error("Storage access out of bounds.");
-    return _data[idx]; 
+    settle(idx, 1);
+    mark_dirty(idx, 1);
+    return at(idx);
   }
   const std::atomic<T>& operator[](size_t idx) const { 
-    if(idx >= _data.size()) throw std::runtime_error("Constant storage access out of bounds.");
-    return _data[idx]; 
+    settle(idx, 1);
+    return at(idx);
+  }
+
+  T get(size_t idx) const { 
+    if(idx < _compact_begin) return owns(idx) ? (*this)[idx].load() : T{};
+    return segment(idx).load(idx);
+  }
+  void set(size_t idx, T value) {
+    if(!owns(idx)) throw std::runtime_error("StrategyStorage --- Value is owned by another rank.");
+    if(idx < _compact_begin) {
+      (*this)[idx].store(value);
+    }
+    else {
+      mark_dirty(idx, 1);
+      segment(idx).store(idx, value);
+    }
+  }
+
+  void load_row(size_t base_idx, int n_actions, T* values) const {
+    if(base_idx < _compact_begin) {
+      settle(base_idx, n_actions);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) values[a_idx] = at(base_idx + a_idx).load();
+    }
+    else if constexpr(std::is_same_v<T, int>) {
+      segment(base_idx).load_row(base_idx, n_actions, values);
+    }
+  }
+
+  void store_row(size_t base_idx, int n_actions, const T* values) {
+    mark_dirty(base_idx, n_actions);
+    if(base_idx < _compact_begin) {
+      settle(base_idx, n_actions);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) at(base_idx + a_idx).store(values[a_idx]);
+    }
+    else if constexpr(std::is_same_v<T, int>) {
+      segment(base_idx).store_row(base_idx, n_actions, values);
+    }
+  }
+
+  // Starts loading a row of pre-sized storage into the cache. Rows of lazy storage are only found through the history map
+  // and are not prefetched.
+  void prefetch_row(size_t base_idx) const {
+    if(!is_presized()) return;
+    if(base_idx < _compact_begin) {
+      __builtin_prefetch(&_page_epochs[base_idx >> PAGE_BITS]);
+      __builtin_prefetch(&_block[local(base_idx)]);
+    }
+    else if constexpr(std::is_same_v<T, int>) {
+      segment(base_idx).prefetch_row(base_idx);
+    }
+  }
+
+  // Calls f(idx, value) for every value in storage order. Pages are settled serially as the walk reaches them, since 
+  // snapshots call this from a forked child which can't enter OpenMP regions.
+  template <class F>
+  void for_each(F&& f) const {
+    size_t n_full = std::min(size(), _compact_begin);
+    for(size_t idx = 0; idx < n_full; ++idx) {
+      if(idx % PAGE_SIZE == 0) settle(idx, 1);
+      f(idx, owns(idx) ? at(idx).load() : T{});
+    }
+    if constexpr(std::is_same_v<T, int>) {
+      for(const auto& segment : _segments) {
+        segment->for_each_row([&](size_t base_idx, int n_actions) {
+          std::array<int, MAX_ACTIONS> values;
+          segment->load_row(base_idx, n_actions, values.data());
+          for(int a_idx = 0; a_idx < n_actions; ++a_idx) f(base_idx + a_idx, values[a_idx]);
+        });
+      }
+    }
+  }
+
+  // Brings every page up to the current epoch in parallel. Only for the parent process, a forked child hangs in OpenMP.
+  void settle_all() const {
+    settle_compact();
+    if(!_page_epochs) return;
+    uint32_t epoch = _discounts.size() - 1;
+    #pragma omp parallel for schedule(static)
+    for(size_t page = 0; page < n_block_pages(); ++page) settle_page(page, epoch);
+  }
+
+  // Compact values are always written decoded, so their pages can be settled before any snapshot.
+  void settle_compact() const {
+    for(const auto& segment : _segments) segment->settle_all();
+  }
+
+  // Full precision values of pre-sized storage are discounted lazily: a discount only records the cumulative factor and 
+  // opens a new epoch. Each page is scaled by the factors it missed the first time it is accessed in the new epoch. 
+  // Compact rounds keep epochs of their own. Discounts must not overlap with accesses from other threads.
+  void discount(double d) {
+    if(_page_epochs) {
+      _discounts.push_back(_discounts.back() * d);
+    }
+    else {
+      size_t n_full = std::min(size(), _compact_begin);
+      #pragma omp parallel for schedule(static)
+      for(size_t idx = 0; idx < n_full; ++idx) {
+        std::atomic<T>& e = at(idx);
+        e.store(e.load() * d);
+      }
+    }
+    for(auto& segment : _segments) segment->discount(d);
+    if(is_compact()) mark_dirty(_compact_begin, size() - _compact_begin);
+  }
+
+  // Widens the scale of compact rounds which saturated since the last discount or rescale, so that they don't stay 
+  // clamped once discounting stopped. Must not race with updates.
+  void rescale() {
+    bool rescaled = false;
+    for(auto& segment : _segments) rescaled = segment->rescale() || rescaled;
+    if(rescaled) mark_dirty(_compact_begin, size() - _compact_begin);
+  }
+
+  // Selects the precision of every round before the storage is allocated from a game tree. Compact rounds have to follow 
+  // all INT32 rounds and quantized values never decode below the floor.
+  void set_precision(const std::array<Precision, 4>& precision, T floor) {
+    if(is_presized()) throw std::runtime_error("StrategyStorage --- Cannot change the precision of allocated storage.");
+    for(int round = 0; round < 4; ++round) {
+      if(precision[round] == Precision::INT32) {
+        if(round > 0 && precision[round - 1] != Precision::INT32) throw std::runtime_error("StrategyStorage --- INT32 rounds have to come first.");
+      }
+      else if(!std::is_same_v<T, int>) {
+        throw std::runtime_error("StrategyStorage --- Compact precision requires int values.");
+      }
+    }
+    _precision = precision;
+    _floor = floor;
   }
 
   size_t index(const PokerState& state, int cluster, int action = 0) {
-    auto actions = valid_actions(state, _action_profile);
-    size_t n_actions = actions.size();
-    auto history = state.get_action_history();
+    if(is_presized()) return index(tree_node(state.get_action_history()), cluster, action);
+    size_t n_actions = n_valid_actions(state, _action_profile);
+    const auto& history = state.get_action_history();
   
     // Fast path: no lock if already allocated and marked ready.
     if (auto it = _history_map.find(history); it != _history_map.end() && it->second.ready.load(std::memory_order_acquire)) {
@@ -116,27 +307,553 @@ public:
     }
   }
 
+  size_t index(const TreeNode& node, int cluster, int action = 0) const {
+    return node.offset * _n_clusters + cluster * node.n_actions + action;
+  }
+
+  // Allocates the rows of every node up to max_round in one block at the offsets precomputed by the tree, so that the 
+  // storage can be indexed by tree node without locks. Indexing by state resolves the history through the tree, which 
+  // has to outlive the storage, and the history map is dropped. Values of a non-empty storage are moved into the block if 
+  // they were laid out by the same tree.
+  void allocate(const GameTree& tree, int max_round = 3, bool huge_pages = false, bool interleave = false) {
+    if(is_presized()) throw std::runtime_error("StrategyStorage --- Storage is already pre-sized.");
+    size_t size = tree.round_offset(max_round + 1) * _n_clusters;
+    if(_data.size() > 0 && _data.size() != size) throw std::runtime_error("StrategyStorage --- Storage size does not match the game tree.");
+    for(const auto& [history, entry] : _history_map) {
+      const TreeNode* node = tree.find(history);
+      if(!node || node->offset * _n_clusters != entry.idx) throw std::runtime_error("StrategyStorage --- Storage layout does not match the game tree.");
+    }
+    int first_compact = 0;
+    while(first_compact <= max_round && _precision[first_compact] == Precision::INT32) ++first_compact;
+    size_t block_size = tree.round_offset(first_compact) * _n_clusters;
+    if(_n_ranks > 1 && first_compact <= max_round) throw std::runtime_error("StrategyStorage --- Compact storage can't be partitioned.");
+    AtomicBlock<T> block{local_size(block_size, _rank, _n_ranks), huge_pages, interleave};
+    #pragma omp parallel for schedule(static)
+    for(size_t idx = 0; idx < std::min(_data.size(), block_size); ++idx) {
+      if(owns(idx)) block[local(idx)].store(_data[idx].load());
+    }
+    if constexpr(std::is_same_v<T, int>) {
+      for(int round = first_compact; round <= max_round; ++round) {
+        auto segment = std::make_unique<CompactSegment>(tree, round, _n_clusters, _precision[round], _floor, huge_pages, interleave);
+        if(_data.size() > 0) {
+          int max_abs = 0;
+          for(size_t idx = segment->begin(); idx < segment->end(); ++idx) max_abs = std::max(max_abs, std::abs(_data[idx].load()));
+          segment->fit(max_abs);
+          segment->for_each_row([&](size_t base_idx, int n_actions) {
+            std::array<int, MAX_ACTIONS> values;
+            for(int a_idx = 0; a_idx < n_actions; ++a_idx) values[a_idx] = _data[base_idx + a_idx].load();
+            segment->store_row(base_idx, n_actions, values.data());
+          });
+        }
+        _segments.push_back(std::move(segment));
+      }
+    }
+    tbb::concurrent_vector<std::atomic<T>>{}.swap(_data);
+    tbb::concurrent_unordered_map<ActionHistory, HistoryEntry>{}.swap(_history_map);
+    _tree = &tree;
+    _block = std::move(block);
+    _block_end = block_size;
+    _huge_pages = huge_pages;
+    _interleave = interleave;
+    _page_epochs = std::make_unique<std::atomic<uint32_t>[]>((block_size + PAGE_SIZE - 1) / PAGE_SIZE);
+    _discounts = {1.0};
+    _dirty = std::make_unique<std::atomic<uint8_t>[]>((size + PAGE_SIZE - 1) / PAGE_SIZE);
+    _checkpoint_epoch = 0;
+    _compact_begin = _segments.empty() ? std::numeric_limits<size_t>::max() : block_size;
+    _presized_size = size;
+  }
+
+  // Keeps only the pages owned by one rank of a distributed run, see value_owner. Storage that is not allocated yet 
+  // allocates only these pages, allocated storage moves them into a smaller block.
+  void partition(int rank, int n_ranks) {
+    if(_n_ranks > 1) throw std::runtime_error("StrategyStorage --- Storage is already partitioned.");
+    if(is_compact()) throw std::runtime_error("StrategyStorage --- Compact storage can't be partitioned.");
+    if(is_presized()) {
+      settle_all();
+      AtomicBlock<T> block{local_size(_block_end, rank, n_ranks), _huge_pages, _interleave};
+      #pragma omp parallel for schedule(static)
+      for(size_t idx = 0; idx < _block_end; ++idx) {
+        if(value_owner(idx, n_ranks) == rank) block[local(idx, n_ranks)].store(_block[idx].load());
+      }
+      _block = std::move(block);
+    }
+    _rank = rank;
+    _n_ranks = n_ranks;
+  }
+
+  // Sampled pages of pre-sized storage on each NUMA node.
+  std::vector<size_t> placement() const {
+    std::vector<size_t> pages = page_nodes(_block.data(), _block.bytes());
+    for(const auto& segment : _segments) {
+      std::vector<size_t> segment_pages = segment->placement();
+      for(int node = 0; node < pages.size(); ++node) pages[node] += segment_pages[node];
+    }
+    return pages;
+  }
+
   size_t index(const PokerState& state, int cluster, int action = 0) const {
-    size_t n_actions = valid_actions(state, _action_profile).size();
+    if(is_presized()) return index(tree_node(state.get_action_history()), cluster, action);
+    size_t n_actions = n_valid_actions(state, _action_profile);
     auto it = _history_map.find(state.get_action_history());
     if(it != _history_map.end()) return it->second.idx + cluster * n_actions + action;
     throw std::runtime_error("StrategyStorage --- Indexed out of range.");
   }
 
+  // First index of the rows of a history, or NO_HISTORY if the storage has none.
+  static constexpr size_t NO_HISTORY = std::numeric_limits<size_t>::max();
+  size_t find(const ActionHistory& history) const {
+    if(is_presized()) {
+      const TreeNode* node = _tree->find(history);
+      return node && in_block(*node) ? node->offset * _n_clusters : NO_HISTORY;
+    }
+    auto it = _history_map.find(history);
+    return it != _history_map.end() ? it->second.idx : NO_HISTORY;
+  }
+
+  // Calls f(history, idx) with the first index of the rows of every history in storage. Pre-sized storage walks the nodes
+  // of its rounds in the game tree.
+  template <class F>
+  void for_each_history(F&& f) const {
+    if(is_presized()) {
+      PokerState state = _tree->root_state();
+      walk_histories(state, _tree->root(), f);
+    }
+    else {
+      for(const auto& [history, entry] : _history_map) f(history, entry.idx);
+    }
+  }
+
+  size_t n_histories() const {
+    if(!is_presized()) return _history_map.size();
+    return std::count_if(_tree->nodes().begin(), _tree->nodes().end(), [&](const TreeNode& node) { return in_block(node); });
+  }
+
+  // Pre-sized and lazy storage are equal if they hold the same values at the same index of every history.
   bool operator==(const StrategyStorage& other) const {
-    return _data == other._data &&
-           _history_map == other._history_map &&
+    if(size() != other.size() || n_histories() != other.n_histories()) return false;
+    bool equal = true;
+    for_each([&](size_t idx, T value) { equal = equal && value == other.get(idx); });
+    for_each_history([&](const ActionHistory& history, size_t idx) { equal = equal && other.find(history) == idx; });
+    return equal &&
            _action_profile == other._action_profile &&
            _n_clusters == other._n_clusters;
   }
 
+  // Pre-sized storage is saved in the lazy format and loaded as lazy storage. BlueprintTrainer moves it back into a block.
+  // Compact rounds are saved at full precision.
   template <class Archive>
-  void serialize(Archive& ar) {
+  void save(Archive& ar) const {
+    if(is_presized()) {
+      size_t n_values = size();
+      ar(n_values);
+      for_each([&](size_t idx, T value) { ar(value); });
+      save_histories(ar);
+      ar(_action_profile, _n_clusters);
+    }
+    else {
+      ar(_data, _history_map, _action_profile, _n_clusters);
+    }
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
     ar(_data, _history_map, _action_profile, _n_clusters);
   }
 
+  // Everything but the values, for snapshot backends which store the values in bulk. Loading the layout resizes the
+  // storage, which stays lazy like storage loaded from a cereal archive.
+  template <class Archive>
+  void save_layout(Archive& ar) const {
+    size_t n_values = size();
+    ar(n_values);
+    save_histories(ar);
+    ar(_action_profile, _n_clusters);
+  }
+
+  template <class Archive>
+  void load_layout(Archive& ar) {
+    if(is_presized()) throw std::runtime_error("StrategyStorage --- Cannot load a layout into pre-sized storage.");
+    size_t n_values;
+    ar(n_values, _history_map, _action_profile, _n_clusters);
+    tbb::concurrent_vector<std::atomic<T>>{}.swap(_data);
+    _data.grow_by(n_values);
+  }
+
+  // Copies the values [idx, idx + n) at full precision. Disjoint ranges can be copied and filled concurrently.
+  void copy_values(size_t idx, size_t n, T* values) const {
+    for(size_t v_idx = 0; v_idx < n; ++v_idx) values[v_idx] = get(idx + v_idx);
+  }
+
+  void fill_values(size_t idx, size_t n, const T* values) {
+    if(is_presized()) throw std::runtime_error("StrategyStorage --- Bulk fills require lazy storage.");
+    for(size_t v_idx = 0; v_idx < n; ++v_idx) _data[idx + v_idx].store(values[v_idx], std::memory_order_relaxed);
+  }
+
+  // Lazy storage hands out rows in order of first touch, which interleaves hot and cold histories. Reordering moves the 
+  // visited histories to the front in depth first order of the game tree, each on a new cache line, so a parent is 
+  // followed by its children and the rows of a sampled path share pages. The unvisited histories follow in their previous
+  // order from a new page on. visits maps regret indices to sampled visit counts. The values are permuted in place and 
+  // the history map is rewritten under the grow lock, no other thread may use the storage meanwhile.
+  // The returned miss rates model a cache of cache_bytes before and after the move, the sweep times are measured.
+  ReorderStats reorder(const std::unordered_map<size_t, long>& visits, const PokerState& init_state, size_t cache_bytes) {
+    if(is_presized()) throw std::runtime_error("StrategyStorage --- Only lazy storage can be reordered.");
+    constexpr size_t LINE_VALUES = 64 / sizeof(T);
+    constexpr size_t PAGE_VALUES = 4096 / sizeof(T);
+    struct Block {
+      size_t idx;
+      size_t n_values;
+      long visits;
+      size_t next_idx;
+      HistoryEntry* entry;
+      const ActionHistory* history;
+    };
+    std::lock_guard<std::mutex> lock(_grow_mutex);
+    size_t prev_size = _data.size();
+    std::vector<Block> blocks;
+    for(auto& [history, entry] : _history_map) blocks.push_back(Block{entry.idx, 0, 0, 0, &entry, &history});
+    std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.idx < b.idx; });
+    size_t init_size = init_state.get_action_history().size();
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(size_t b_idx = 0; b_idx < blocks.size(); ++b_idx) {
+      PokerState state = init_state;
+      const ActionHistory& history = *blocks[b_idx].history;
+      for(int h_idx = init_size; h_idx < history.size(); ++h_idx) state.apply_in_place(history.get(h_idx));
+      blocks[b_idx].n_values = _n_clusters * n_valid_actions(state, _action_profile);
+    }
+
+    auto block_of = [&](size_t idx) -> Block& {
+      return *std::prev(std::upper_bound(blocks.begin(), blocks.end(), idx, [](size_t i, const Block& b) { return i < b.idx; }));
+    };
+    // Every visit of a row touches the lines of the row.
+    auto add_lines = [](std::unordered_map<size_t, long>& lines, size_t idx, size_t n_actions, long count) {
+      for(size_t line = idx / LINE_VALUES; line <= (idx + n_actions - 1) / LINE_VALUES; ++line) lines[line] += count;
+    };
+    std::unordered_map<size_t, long> lines_before;
+    long total_visits = 0;
+    for(const auto& [idx, count] : visits) {
+      if(blocks.empty() || idx < blocks.front().idx || idx >= prev_size) continue;
+      Block& block = block_of(idx);
+      block.visits += count;
+      total_visits += count;
+      add_lines(lines_before, idx, block.n_values / _n_clusters, count);
+    }
+
+    // Histories sort before their extensions, so sorting them depth first only needs a lexicographic comparison.
+    std::vector<Block*> order;
+    for(auto& block : blocks) order.push_back(&block);
+    std::stable_sort(order.begin(), order.end(), [](const Block* a, const Block* b) {
+      if((a->visits > 0) != (b->visits > 0)) return a->visits > 0;
+      if(a->visits == 0) return false;
+      const auto& a_actions = a->history->get_history();
+      const auto& b_actions = b->history->get_history();
+      return std::lexicographical_compare(a_actions.begin(), a_actions.end(), b_actions.begin(), b_actions.end(), 
+                                          [](const Action& x, const Action& y) { return x.get_bet_type() < y.get_bet_type(); });
+    });
+    ReorderStats stats;
+    size_t n_values = 0;
+    bool first_cold = true;
+    for(Block* block : order) {
+      size_t align = 1;
+      if(block->visits > 0) {
+        align = LINE_VALUES;
+        ++stats.hot_histories;
+      }
+      else if(first_cold) {
+        align = PAGE_VALUES;
+        first_cold = false;
+      }
+      n_values = (n_values + align - 1) / align * align;
+      block->next_idx = n_values;
+      n_values += block->n_values;
+    }
+
+    // Up to MAX_SWEEP sampled visits, in proportion to their counts.
+    constexpr long MAX_SWEEP = 1 << 20;
+    struct Access {
+      size_t prev_idx;
+      size_t next_idx;
+      size_t n_actions;
+    };
+    std::vector<Access> accesses;
+    double sweep_scale = std::min(1.0, static_cast<double>(MAX_SWEEP) / std::max(total_visits, 1L));
+    for(const auto& [idx, count] : visits) {
+      if(blocks.empty() || idx < blocks.front().idx || idx >= prev_size) continue;
+      const Block& block = block_of(idx);
+      Access access{idx, block.next_idx + idx - block.idx, block.n_values / _n_clusters};
+      for(long n = std::max(1L, std::lround(count * sweep_scale)); n > 0; --n) accesses.push_back(access);
+    }
+    RNG sweep_rng{splitmix64(prev_size)};
+    std::shuffle(accesses.begin(), accesses.end(), sweep_rng);
+    using Sum = std::conditional_t<std::is_integral_v<T>, uint64_t, double>;
+    auto sweep = [&](bool after, Sum& sum) {
+      double best_ns = std::numeric_limits<double>::max();
+      for(int pass = 0; pass < 2; ++pass) {
+        sum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for(const Access& access : accesses) {
+          size_t idx = after ? access.next_idx : access.prev_idx;
+          for(size_t a_idx = 0; a_idx < access.n_actions; ++a_idx) sum += static_cast<Sum>(_data[idx + a_idx].load(std::memory_order_relaxed));
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        best_ns = std::min(best_ns, std::chrono::duration<double, std::nano>(end - start).count());
+      }
+      return accesses.empty() ? 0.0 : best_ns / accesses.size();
+    };
+    Sum sum_before, sum_after;
+    stats.sweep_ns_before = sweep(false, sum_before);
+
+    // Values follow the cycles of the permutation, so the only extra memory is a bit per value that marks the values 
+    // already taken from their previous index. Padding and indices past the previous layout hold no values, a chain that 
+    // reaches one ends there.
+    if(n_values > prev_size) _data.grow_by(n_values - prev_size);
+    auto source_of = [&](size_t idx) -> const Block* {
+      if(blocks.empty() || idx < blocks.front().idx) return nullptr;
+      const Block& block = block_of(idx);
+      return idx < block.idx + block.n_values ? &block : nullptr;
+    };
+    std::vector<bool> taken(prev_size, false);
+    for(const auto& block : blocks) {
+      if(block.next_idx == block.idx) continue;
+      for(size_t v_idx = 0; v_idx < block.n_values; ++v_idx) {
+        if(taken[block.idx + v_idx]) continue;
+        taken[block.idx + v_idx] = true;
+        T value = _data[block.idx + v_idx].load(std::memory_order_relaxed);
+        size_t idx = block.next_idx + v_idx;
+        const Block* next;
+        while((next = source_of(idx)) && !taken[idx]) {
+          taken[idx] = true;
+          value = _data[idx].exchange(value, std::memory_order_relaxed);
+          idx = next->next_idx + idx - next->idx;
+        }
+        _data[idx].store(value, std::memory_order_relaxed);
+      }
+    }
+    if(n_values < prev_size) _data.resize(n_values);
+    for(const auto& block : blocks) block.entry->idx = block.next_idx;
+
+    std::unordered_map<size_t, long> lines_after;
+    for(const auto& [idx, count] : visits) {
+      if(blocks.empty() || idx < blocks.front().idx || idx >= prev_size) continue;
+      const Block& block = block_of(idx);
+      add_lines(lines_after, block.next_idx + idx - block.idx, block.n_values / _n_clusters, count);
+    }
+    stats.miss_rate_before = modeled_miss_rate(lines_before, cache_bytes / 64);
+    stats.miss_rate_after = modeled_miss_rate(lines_after, cache_bytes / 64);
+    stats.sweep_ns_after = sweep(true, sum_after);
+    if(sum_after != sum_before) throw std::runtime_error("StrategyStorage --- Reordering moved the wrong values.");
+    return stats;
+  }
+
+  // Pre-sized storage tracks the pages changed since the last checkpoint. Writes and discounts mark pages dirty. 
+  size_t n_pages() const { return (size() + PAGE_SIZE - 1) / PAGE_SIZE; }
+  std::vector<size_t> dirty_pages() const {
+    std::vector<size_t> pages;
+    if(!_dirty) return pages;
+    for(size_t page = 0; page < n_pages(); ++page) {
+      if(_dirty[page].load(std::memory_order_relaxed)) pages.push_back(page);
+    }
+    return pages;
+  }
+
+  // Called once a full snapshot was taken. A forked snapshot settles its own copy of the pages, so pages still behind the
+  // current epoch stay dirty and the next delta records their raw values.
+  void mark_checkpoint() {
+    if(!_dirty) return;
+    _checkpoint_epoch = _discounts.size() - 1;
+    for(size_t page = 0; page < n_pages(); ++page) {
+      bool behind = page < n_block_pages() && _page_epochs[page].load(std::memory_order_relaxed) != _checkpoint_epoch;
+      _dirty[page].store(behind, std::memory_order_relaxed);
+    }
+  }
+
+  // Called once a delta was taken.
+  void clear_dirty() {
+    if(!_dirty) return;
+    for(size_t page = 0; page < n_pages(); ++page) _dirty[page].store(0, std::memory_order_relaxed);
+  }
+
+  // Delta checkpoints hold the dirty pages only. Full precision values are written raw together with the discount epoch 
+  // of their page, so a rebuilt storage settles to exactly the same values. Compact values are written at full precision 
+  // like in full snapshots.
+  template <class Archive>
+  void save_delta(Archive& ar) const {
+    if(!_dirty) throw std::runtime_error("StrategyStorage --- Delta checkpoints require pre-sized storage.");
+    size_t n_values = size();
+    std::vector<size_t> pages = dirty_pages();
+    ar(n_values, _checkpoint_epoch, _discounts, pages);
+    for(size_t page : pages) {
+      uint32_t epoch = page < n_block_pages() ? _page_epochs[page].load() : 0;
+      ar(epoch);
+      for(size_t idx = page << PAGE_BITS; idx < std::min((page + 1) << PAGE_BITS, size()); ++idx) {
+        T value = idx >= _block_end ? get(idx) : owns(idx) ? _block[local(idx)].load() : T{};
+        ar(value);
+      }
+    }
+  }
+
+  // Applies a delta to the storage rebuilt from its base snapshot or from the previous delta.
+  template <class Archive>
+  void load_delta(Archive& ar) {
+    if(!_dirty) throw std::runtime_error("StrategyStorage --- Delta checkpoints require pre-sized storage.");
+    size_t n_values;
+    uint32_t checkpoint_epoch;
+    std::vector<double> discounts;
+    std::vector<size_t> pages;
+    ar(n_values, checkpoint_epoch, discounts, pages);
+    if(n_values != size()) throw std::runtime_error("StrategyStorage --- Delta does not match the storage size.");
+    // Storage fresh from the base snapshot holds the values the base settled at the epoch of the checkpoint.
+    if(_discounts.size() == 1) {
+      for(size_t page = 0; page < n_block_pages(); ++page) _page_epochs[page].store(checkpoint_epoch);
+    }
+    _discounts = std::move(discounts);
+    _checkpoint_epoch = checkpoint_epoch;
+    for(size_t page : pages) {
+      uint32_t epoch;
+      ar(epoch);
+      if(page < n_block_pages()) _page_epochs[page].store(epoch);
+      for(size_t idx = page << PAGE_BITS; idx < std::min((page + 1) << PAGE_BITS, size()); ++idx) {
+        T value;
+        ar(value);
+        if(idx < _block_end) {
+          if(owns(idx)) _block[local(idx)].store(value);
+        }
+        else if constexpr(std::is_same_v<T, int>) segment(idx).store(idx, value);
+      }
+    }
+  }
+
 private:
+  static constexpr int PAGE_BITS = 12;
+  static_assert(PAGE_BITS == OWNER_BITS, "Partitioned storage keeps whole pages.");
+  static constexpr size_t PAGE_SIZE = size_t{1} << PAGE_BITS;
+  static constexpr uint32_t LOCKED_EPOCH = std::numeric_limits<uint32_t>::max();
+
+  std::atomic<T>& at(size_t idx) {
+    if(is_presized()) return _block[local(idx)];
+    if(idx >= _data.size()) throw std::runtime_error("Storage access out of bounds.");
+    return _data[idx]; 
+  }
+  const std::atomic<T>& at(size_t idx) const { 
+    if(is_presized()) return _block[local(idx)];
+    if(idx >= _data.size()) throw std::runtime_error("Constant storage access out of bounds.");
+    return _data[idx]; 
+  }
+
+  size_t n_block_pages() const { return (_block_end + PAGE_SIZE - 1) / PAGE_SIZE; }
+
+  // Position of a value in the block, which packs the pages of the rank in order.
+  static size_t local(size_t idx, int n_ranks) { 
+    return n_ranks == 1 ? idx : ((idx >> PAGE_BITS) / n_ranks << PAGE_BITS) | (idx & (PAGE_SIZE - 1)); 
+  }
+  size_t local(size_t idx) const { return local(idx, _n_ranks); }
+  static size_t local_size(size_t n_values, int rank, int n_ranks) {
+    size_t n_pages = (n_values + PAGE_SIZE - 1) / PAGE_SIZE;
+    return n_ranks == 1 ? n_values : (n_pages + n_ranks - 1 - rank) / n_ranks * PAGE_SIZE;
+  }
+
+  // Nodes of later rounds than the storage was allocated for lie past its end, and so do all of their descendants.
+  bool in_block(const TreeNode& node) const { return node.offset * _n_clusters < size(); }
+
+  const TreeNode& tree_node(const ActionHistory& history) const {
+    const TreeNode* node = _tree->find(history);
+    if(!node || !in_block(*node)) throw std::runtime_error("StrategyStorage --- History is not part of the pre-sized game tree.");
+    return *node;
+  }
+
+  template <class F>
+  void walk_histories(PokerState& state, const TreeNode& node, F& f) const {
+    if(!in_block(node)) return;
+    f(state.get_action_history(), node.offset * _n_clusters);
+    for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) {
+      const TreeNode* next = _tree->child(node, a_idx);
+      if(!next) continue;
+      StateDelta delta = state.apply_in_place(_tree->actions(node)[a_idx]);
+      walk_histories(state, *next, f);
+      state.undo(delta);
+    }
+  }
+
+  // Histories are written in the format of the history map, so that snapshots of pre-sized storage load as lazy storage.
+  template <class Archive>
+  void save_histories(Archive& ar) const {
+    if(!is_presized()) {
+      ar(_history_map);
+      return;
+    }
+    size_t n = n_histories();
+    ar(n);
+    for_each_history([&](const ActionHistory& history, size_t idx) {
+      HistoryEntry entry{idx, true};
+      ar(history, entry);
+    });
+  }
+
+  void mark_dirty(size_t idx, size_t n) const {
+    if(!_dirty) return;
+    for(size_t page = idx >> PAGE_BITS; page <= (idx + n - 1) >> PAGE_BITS; ++page) {
+      if(!_dirty[page].load(std::memory_order_relaxed)) _dirty[page].store(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Brings the pages of [idx, idx + n) up to the current epoch.
+  void settle(size_t idx, int n) const {
+    if(!_page_epochs || idx >= _block_end) return;
+    uint32_t epoch = _discounts.size() - 1;
+    size_t first = idx >> PAGE_BITS, last = (idx + n - 1) >> PAGE_BITS;
+    if(_page_epochs[first].load(std::memory_order_acquire) != epoch) settle_page(first, epoch);
+    if(last != first && _page_epochs[last].load(std::memory_order_acquire) != epoch) settle_page(last, epoch);
+  }
+
+  // The first thread to lock the page scales it, the others wait until the page is stamped with the current epoch.
+  void settle_page(size_t page, uint32_t epoch) const {
+    std::atomic<uint32_t>& stamp = _page_epochs[page];
+    uint32_t page_epoch = stamp.load(std::memory_order_acquire);
+    while(page_epoch != epoch) {
+      if(page_epoch == LOCKED_EPOCH) {
+        page_epoch = stamp.load(std::memory_order_acquire);
+      }
+      else if(stamp.compare_exchange_weak(page_epoch, LOCKED_EPOCH, std::memory_order_acquire)) {
+        double factor = _discounts[epoch] / _discounts[page_epoch];
+        // Scaling leaves the represented values unchanged, so settling is logically const.
+        AtomicBlock<T>& block = const_cast<AtomicBlock<T>&>(_block);
+        if(owns(page << PAGE_BITS)) {
+          for(size_t idx = page << PAGE_BITS; idx < std::min((page + 1) << PAGE_BITS, _block_end); ++idx) {
+            block[local(idx)].store(block[local(idx)].load(std::memory_order_relaxed) * factor, std::memory_order_relaxed);
+          }
+          mark_dirty(page << PAGE_BITS, 1);
+        }
+        stamp.store(epoch, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  const CompactSegment& segment(size_t idx) const {
+    for(const auto& segment : _segments) {
+      if(idx < segment->end()) return *segment;
+    }
+    throw std::runtime_error("StrategyStorage --- Compact index out of range.");
+  }
+  CompactSegment& segment(size_t idx) { return const_cast<CompactSegment&>(std::as_const(*this).segment(idx)); }
+
   tbb::concurrent_vector<std::atomic<T>> _data;
+  AtomicBlock<T> _block;
+  std::vector<std::unique_ptr<CompactSegment>> _segments;
+  std::array<Precision, 4> _precision{};
+  T _floor = 0;
+  size_t _presized_size = 0;
+  size_t _compact_begin = std::numeric_limits<size_t>::max();
+  // End of the full precision values in _block.
+  size_t _block_end = 0;
+  int _rank = 0;
+  int _n_ranks = 1;
+  bool _huge_pages = false;
+  bool _interleave = false;
+  std::unique_ptr<std::atomic<uint32_t>[]> _page_epochs;
+  std::vector<double> _discounts{1.0};
+  std::unique_ptr<std::atomic<uint8_t>[]> _dirty;
+  uint32_t _checkpoint_epoch = 0;
+  const GameTree* _tree = nullptr;
   tbb::concurrent_unordered_map<ActionHistory, HistoryEntry> _history_map;
   ActionProfile _action_profile;
   int _n_clusters;
@@ -0,0 +1,40 @@
+#include <algorithm>
+#include <stdexcept>
+#include <pluribus/sums.hpp>
+
+namespace pluribus {
+
+RowSums::RowSums(const GameTree& tree, int n_clusters, const std::array<Precision, 4>& precision) 
+    : _row_begin(tree.size(), UNCACHED), _n_clusters{n_clusters} {
+  for(uint32_t id = 0; id < tree.size(); ++id) {
+    if(precision[tree.node(id).round] != Precision::INT32) continue;
+    if(_n_rows + n_clusters >= UNCACHED) throw std::runtime_error("RowSums --- Too many rows.");
+    _row_begin[id] = _n_rows;
+    _n_rows += n_clusters;
+    const TreeNode& node = tree.node(id);
+    if(node.n_actions > 0) _nodes.push_back(CachedNode{node.offset * n_clusters, (node.offset + node.n_actions) * n_clusters, node.n_actions, id});
+  }
+  std::sort(_nodes.begin(), _nodes.end(), [](const CachedNode& a, const CachedNode& b) { return a.begin < b.begin; });
+  _sums = std::make_unique<std::atomic<float>[]>(_n_rows);
+  for(size_t r_idx = 0; r_idx < _n_rows; ++r_idx) _sums[r_idx].store(0.0f, std::memory_order_relaxed);
+}
+
+void RowSums::refresh(const StrategyStorage<int>& regrets, const TreeNode& node, uint32_t node_id) {
+  if(_row_begin[node_id] == UNCACHED) return;
+  std::array<int, MAX_ACTIONS> values;
+  for(int cluster = 0; cluster < _n_clusters; ++cluster) {
+    size_t base_idx = regrets.index(node, cluster);
+    if(!regrets.owns_row(base_idx, node.n_actions)) continue;
+    regrets.load_row(base_idx, node.n_actions, values.data());
+    long sum = 0;
+    for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) sum += std::max(values[a_idx], 0);
+    store(_row_begin[node_id] + cluster, sum);
+  }
+}
+
+void RowSums::rebuild(const StrategyStorage<int>& regrets, const GameTree& tree) {
+  #pragma omp parallel for schedule(dynamic, 1024)
+  for(uint32_t id = 0; id < tree.size(); ++id) refresh(regrets, tree.node(id), id);
+}
+
+}
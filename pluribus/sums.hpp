@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <pluribus/tree.hpp>
+#include <pluribus/storage.hpp>
+
+namespace pluribus {
+
+// Positive regret sum of every full precision row, stored by the writers of the row. Sampling an action from a row 
+// then takes a single pass over it, without regret matching. A sum is a hint: sample() only trusts it when it covers the
+// row, which keeps sampling unbiased when the sum is stale after a discount or a concurrent update. Rows of compact 
+// rounds and rows without positive regret fall back to the caller.
+class RowSums {
+public:
+  static constexpr uint32_t UNCACHED = UINT32_MAX;
+
+  RowSums() = default;
+  RowSums(const GameTree& tree, int n_clusters, const std::array<Precision, 4>& precision);
+
+  bool empty() const { return _n_rows == 0; }
+  size_t n_rows() const { return _n_rows; }
+  // Slot of the row of a node and cluster, or -1 if the row isn't cached.
+  long slot(uint32_t node_id, int cluster) const {
+    uint32_t begin = _row_begin[node_id];
+    return begin == UNCACHED ? -1 : static_cast<long>(begin) + cluster;
+  }
+  // Slot of the row at a regret index, or -1 if the row isn't cached.
+  long row_slot(size_t base_idx) const {
+    auto it = std::upper_bound(_nodes.begin(), _nodes.end(), base_idx, [](size_t i, const CachedNode& node) { return i < node.begin; });
+    if(it == _nodes.begin()) return -1;
+    --it;
+    return base_idx < it->end ? static_cast<long>(_row_begin[it->id] + (base_idx - it->begin) / it->n_actions) : -1;
+  }
+  float load(long slot) const { return _sums[slot].load(std::memory_order_relaxed); }
+  // Rounds up, so that the stored sum still covers the row.
+  void store(long slot, long sum) {
+    float f = sum;
+    if(static_cast<double>(f) < static_cast<double>(sum)) f = std::nextafter(f, std::numeric_limits<float>::infinity());
+    _sums[slot].store(f, std::memory_order_relaxed);
+  }
+
+  // Samples an action index from the positive regrets of a row with the cached sum of the row. Returns -1 if the target 
+  // falls past the positive regrets or the sum is below the positive sum of the row, the caller then samples from the 
+  // regret matched strategy. The pass always runs to the end, so a sum that understates the row is never trusted. r is 
+  // uniform in [0, 1).
+  int sample(long slot, const int* regrets, int n_actions, float r) const {
+    float sum = load(slot);
+    if(sum <= 0.0f) return -1;
+    long target = static_cast<long>(r * sum);
+    long acc = 0;
+    int sampled = -1;
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      acc += std::max(regrets[a_idx], 0);
+      if(sampled < 0 && target < acc) sampled = a_idx;
+    }
+    return static_cast<double>(acc) > sum ? -1 : sampled;
+  }
+
+  // Recomputes the sums of all rows of a node. Rows owned by other ranks are skipped.
+  void refresh(const StrategyStorage<int>& regrets, const TreeNode& node, uint32_t node_id);
+  // Recomputes every sum.
+  void rebuild(const StrategyStorage<int>& regrets, const GameTree& tree);
+
+private:
+  struct CachedNode {
+    size_t begin;
+    size_t end;
+    int n_actions;
+    uint32_t id;
+  };
+
+  std::vector<uint32_t> _row_begin;
+  // Cached nodes in the order of their regrets.
+  std::vector<CachedNode> _nodes;
+  std::unique_ptr<std::atomic<float>[]> _sums;
+  size_t _n_rows = 0;
+  int _n_clusters = 0;
+};
+
+}
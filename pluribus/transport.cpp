@@ -0,0 +1,157 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <exception>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <pluribus/transport.hpp>
+
+namespace pluribus {
+
+std::vector<std::string> all_to_all(Transport& transport, const std::vector<std::string>& out) {
+  int n = transport.size();
+  int rank = transport.rank();
+  if(out.size() != n) throw std::runtime_error("Transport --- All-to-all requires one message per rank.");
+  // Errors of either direction are rethrown once the sender was joined, a throwing or unjoined thread would terminate.
+  std::exception_ptr send_error;
+  std::thread sender{[&]() {
+    try {
+      for(int step = 1; step < n; ++step) {
+        int dst = (rank + step) % n;
+        transport.send(dst, out[dst]);
+      }
+    }
+    catch(...) {
+      send_error = std::current_exception();
+    }
+  }};
+  std::vector<std::string> in(n);
+  std::exception_ptr recv_error;
+  try {
+    for(int step = 1; step < n; ++step) {
+      int src = (rank - step + n) % n;
+      in[src] = transport.recv(src);
+    }
+  }
+  catch(...) {
+    recv_error = std::current_exception();
+  }
+  sender.join();
+  if(recv_error) std::rethrow_exception(recv_error);
+  if(send_error) std::rethrow_exception(send_error);
+  return in;
+}
+
+static void write_all(int fd, const char* data, size_t n) {
+  while(n > 0) {
+    ssize_t written = ::send(fd, data, n, MSG_NOSIGNAL);
+    if(written < 0 && errno == EINTR) continue;
+    if(written <= 0) throw std::runtime_error("SocketTransport --- Write failed: " + std::string{strerror(errno)});
+    data += written;
+    n -= written;
+  }
+}
+
+static void read_all(int fd, char* data, size_t n) {
+  while(n > 0) {
+    ssize_t n_read = read(fd, data, n);
+    if(n_read < 0 && errno == EINTR) continue;
+    if(n_read == 0) throw std::runtime_error("SocketTransport --- Peer closed the connection.");
+    if(n_read < 0) throw std::runtime_error("SocketTransport --- Read failed: " + std::string{strerror(errno)});
+    data += n_read;
+    n -= n_read;
+  }
+}
+
+SocketTransport::~SocketTransport() {
+  for(int fd : _fds) {
+    if(fd >= 0) close(fd);
+  }
+}
+
+void SocketTransport::send(int dst, const std::string& msg) {
+  uint64_t n = msg.size();
+  write_all(_fds[dst], reinterpret_cast<const char*>(&n), sizeof(n));
+  write_all(_fds[dst], msg.data(), msg.size());
+}
+
+std::string SocketTransport::recv(int src) {
+  uint64_t n;
+  read_all(_fds[src], reinterpret_cast<char*>(&n), sizeof(n));
+  std::string msg(n, '\0');
+  read_all(_fds[src], msg.data(), n);
+  return msg;
+}
+
+std::vector<std::unique_ptr<SocketTransport>> SocketTransport::mesh(int n) {
+  std::vector<std::vector<int>> fds(n, std::vector<int>(n, -1));
+  for(int a = 0; a < n; ++a) {
+    for(int b = a + 1; b < n; ++b) {
+      int pair[2];
+      if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) throw std::runtime_error("SocketTransport --- socketpair failed.");
+      fds[a][b] = pair[0];
+      fds[b][a] = pair[1];
+    }
+  }
+  std::vector<std::unique_ptr<SocketTransport>> transports;
+  for(int rank = 0; rank < n; ++rank) transports.push_back(std::make_unique<SocketTransport>(rank, fds[rank]));
+  return transports;
+}
+
+static sockaddr_un socket_address(const std::string& dir, int rank) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  std::string path = dir + "/rank_" + std::to_string(rank) + ".sock";
+  if(path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("SocketTransport --- Socket path too long: " + path);
+  std::strcpy(addr.sun_path, path.c_str());
+  return addr;
+}
+
+std::unique_ptr<SocketTransport> SocketTransport::connect(const std::string& dir, int rank, int n) {
+  std::vector<int> fds(n, -1);
+  sockaddr_un own_addr = socket_address(dir, rank);
+  unlink(own_addr.sun_path);
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&own_addr), sizeof(own_addr)) != 0 || listen(listen_fd, n) != 0) {
+    throw std::runtime_error("SocketTransport --- Failed to listen on " + std::string{own_addr.sun_path});
+  }
+
+  int32_t own_rank = rank;
+  for(int peer = 0; peer < rank; ++peer) {
+    sockaddr_un addr = socket_address(dir, peer);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    while(fds[peer] < 0) {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        fds[peer] = fd;
+        break;
+      }
+      close(fd);
+      if(std::chrono::steady_clock::now() > deadline) {
+        throw std::runtime_error("SocketTransport --- Timed out connecting to rank " + std::to_string(peer) + ".");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    write_all(fds[peer], reinterpret_cast<const char*>(&own_rank), sizeof(own_rank));
+  }
+
+  for(int n_accepted = 0; n_accepted < n - rank - 1; ++n_accepted) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if(fd < 0) throw std::runtime_error("SocketTransport --- accept failed.");
+    int32_t peer;
+    read_all(fd, reinterpret_cast<char*>(&peer), sizeof(peer));
+    if(peer <= rank || peer >= n || fds[peer] >= 0) throw std::runtime_error("SocketTransport --- Unexpected peer rank.");
+    fds[peer] = fd;
+  }
+  close(listen_fd);
+  unlink(own_addr.sun_path);
+  return std::make_unique<SocketTransport>(rank, fds);
+}
+
+}
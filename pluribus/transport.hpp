@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace pluribus {
+
+// Point to point messaging between the trainer processes of a distributed run. Messages between two ranks arrive in the
+// order they were sent.
+class Transport {
+public:
+  virtual ~Transport() = default;
+  virtual int rank() const = 0;
+  virtual int size() const = 0;
+  virtual void send(int dst, const std::string& msg) = 0;
+  virtual std::string recv(int src) = 0;
+};
+
+// Sends out[peer] to every other rank and returns the message received from every other rank. The entries of the own 
+// rank are left empty. Sends run on a separate thread, so large messages can't deadlock.
+std::vector<std::string> all_to_all(Transport& transport, const std::vector<std::string>& out);
+
+// Length prefixed messages over connected stream sockets, one per peer.
+class SocketTransport : public Transport {
+public:
+  SocketTransport(int rank, std::vector<int> fds) : _rank{rank}, _fds{std::move(fds)} {}
+  SocketTransport(const SocketTransport&) = delete;
+  SocketTransport& operator=(const SocketTransport&) = delete;
+  ~SocketTransport() override;
+
+  int rank() const override { return _rank; }
+  int size() const override { return _fds.size(); }
+  void send(int dst, const std::string& msg) override;
+  std::string recv(int src) override;
+
+  // Fully connected ranks in the calling process from socket pairs. For threads or for processes forked afterwards, which
+  // keep the transport of their rank.
+  static std::vector<std::unique_ptr<SocketTransport>> mesh(int n);
+  // Connects rank to the other n - 1 processes through Unix domain sockets in dir. Every rank listens on its own socket
+  // and connects to the lower ranks.
+  static std::unique_ptr<SocketTransport> connect(const std::string& dir, int rank, int n);
+
+private:
+  int _rank;
+  std::vector<int> _fds;
+};
+
+}
@@ -4,6 +4,8 @@
 #include <vector>
 #include <pluribus/range.hpp>
 #include <pluribus/mccfr.hpp>
+#include <pluribus/mapped.hpp>
+#include <pluribus/simd.hpp>
 #include <pluribus/poker.hpp>
 #include <pluribus/cluster.hpp>
 #include <pluribus/range_viewer.hpp>
@@ -30,8 +32,25 @@ Action str_to_action(const std::string& str) {
   }
 }
 
-std::unordered_map<Action, RenderableRange> trainer_ranges(const BlueprintTrainer& bp, const PokerState& state, 
-                                                           const Board& board, PokerRange& base_range, bool force_regrets) {
+std::vector<float> snapshot_strategy(const BlueprintTrainer& bp, const PokerState& state, int cluster, int n_actions, 
+                                     bool force_regrets) {
+  if(state.get_round() == 0 && !force_regrets) {
+    return calculate_strategy(bp.get_phi(), bp.phi_index(state, cluster), n_actions);
+  }
+  return calculate_strategy(bp.get_regrets(), bp.regret_index(state, cluster), n_actions);
+}
+
+std::vector<float> snapshot_strategy(const MappedSnapshot& bp, const PokerState& state, int cluster, int n_actions, 
+                                     bool force_regrets) {
+  std::vector<float> freq(n_actions);
+  if(state.get_round() == 0 && !force_regrets) regret_matching(bp.phi() + bp.phi_index(state, cluster), n_actions, freq.data());
+  else regret_matching(bp.regrets() + bp.regret_index(state, cluster), n_actions, freq.data());
+  return freq;
+}
+
+template <class Snapshot>
+std::unordered_map<Action, RenderableRange> snapshot_ranges(const Snapshot& bp, const PokerState& state, const Board& board, 
+                                                            PokerRange& base_range, bool force_regrets) {
   std::unordered_map<Action, RenderableRange> ranges;
   auto actions = valid_actions(state, bp.get_config().action_profile);
   auto color_map = map_colors(actions);
@@ -47,15 +66,7 @@ std::unordered_map<Action, RenderableRange> trainer_ranges(const BlueprintTraine
         }
         
         int cluster = FlatClusterMap::get_instance()->cluster(state.get_round(), board, hand);
-        std::vector<float> freq;
-        if(state.get_round() == 0 && !force_regrets) {
-          int base_idx = bp.get_phi().index(state, cluster);
-          freq = calculate_strategy(bp.get_phi(), base_idx, actions.size());
-        }
-        else {
-          int base_idx = bp.get_regrets().index(state, cluster);
-          freq = calculate_strategy(bp.get_regrets(), base_idx, actions.size());
-        }
+        std::vector<float> freq = snapshot_strategy(bp, state, cluster, actions.size(), force_regrets);
         int a_idx = std::distance(actions.begin(), std::find(actions.begin(), actions.end(), a));
         action_range.add_hand(hand, freq[a_idx]);
       }
@@ -65,17 +76,24 @@ std::unordered_map<Action, RenderableRange> trainer_ranges(const BlueprintTraine
   return ranges;
 }
 
+std::unordered_map<Action, RenderableRange> trainer_ranges(const BlueprintTrainer& bp, const PokerState& state, 
+                                                           const Board& board, PokerRange& base_range, bool force_regrets) {
+  return snapshot_ranges(bp, state, board, base_range, force_regrets);
+}
+
+std::unordered_map<Action, RenderableRange> trainer_ranges(const MappedSnapshot& bp, const PokerState& state, 
+                                                           const Board& board, PokerRange& base_range, bool force_regrets) {
+  return snapshot_ranges(bp, state, board, base_range, force_regrets);
+}
+
 void render_ranges(RangeViewer* viewer_p, const PokerRange& base_range, const std::unordered_map<Action, RenderableRange>& action_ranges) {
   std::vector<RenderableRange> ranges{RenderableRange{base_range, "Base Range", Color{255, 255, 255, 255}}};
   for(auto& entry : action_ranges) ranges.push_back(entry.second);
   viewer_p->render(ranges);
 }
 
-void traverse(RangeViewer* viewer_p, const std::string& bp_fn) {
-  std::cout << "Loading " << bp_fn << " for traversal... " << std::flush;
-  auto bp = cereal_load<BlueprintTrainer>(bp_fn);
-  std::cout << "Success.\n";
-
+template <class Snapshot>
+void traverse_snapshot(RangeViewer* viewer_p, const Snapshot& bp) {
   std::string input;
   std::cout << "Board cards: ";
   auto board_cards = bp.get_config().init_board;
@@ -128,5 +146,19 @@ void traverse(RangeViewer* viewer_p, const std::string& bp_fn) {
   }
 }
 
+// Mapped snapshots are used in place, other snapshots are deserialized first.
+void traverse(RangeViewer* viewer_p, const std::string& bp_fn) {
+  std::cout << "Loading " << bp_fn << " for traversal... " << std::flush;
+  if(is_mapped_snapshot(bp_fn)) {
+    MappedSnapshot bp{bp_fn};
+    std::cout << "Success.\n";
+    traverse_snapshot(viewer_p, bp);
+  }
+  else {
+    auto bp = load_snapshot(bp_fn, {});
+    std::cout << "Success.\n";
+    traverse_snapshot(viewer_p, bp);
+  }
 }
 
+}
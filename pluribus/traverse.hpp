@@ -2,6 +2,7 @@
 
 #include <pluribus/range_viewer.hpp>
 #include <pluribus/mccfr.hpp>
+#include <pluribus/mapped.hpp>
 #include <string>
 
 namespace pluribus {
@@ -10,6 +11,8 @@ void traverse(RangeViewer* viewer, const std::string& bp_fn);
 
 std::unordered_map<Action, RenderableRange> trainer_ranges(const BlueprintTrainer& bp, const PokerState& state, 
   const Board& board, PokerRange& base_range, bool force_regrets);
+std::unordered_map<Action, RenderableRange> trainer_ranges(const MappedSnapshot& bp, const PokerState& state, 
+  const Board& board, PokerRange& base_range, bool force_regrets);
 
 }
 
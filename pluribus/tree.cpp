@@ -0,0 +1,59 @@
+#include <iostream>
+#include <stdexcept>
+#include <pluribus/poker.hpp>
+#include <pluribus/actions.hpp>
+#include <pluribus/tree.hpp>
+
+namespace pluribus {
+
+GameTree::GameTree(const PokerState& root, const ActionProfile& action_profile) : _root_state{root} {
+  if(root.is_terminal()) throw std::runtime_error("GameTree --- Root state is terminal.");
+  if(action_profile.max_actions() > MAX_ACTIONS) throw std::runtime_error("GameTree --- Too many actions in the action profile.");
+  PokerState state = root;
+  compile(state, action_profile);
+
+  std::array<uint64_t, 4> round_size{};
+  for(const TreeNode& node : _nodes) round_size[node.round] += node.n_actions;
+  _round_offsets[0] = 0;
+  for(int r = 0; r < 4; ++r) _round_offsets[r + 1] = _round_offsets[r] + round_size[r];
+  std::array<uint64_t, 4> cursor;
+  std::copy(_round_offsets.begin(), _round_offsets.begin() + 4, cursor.begin());
+  for(TreeNode& node : _nodes) {
+    node.offset = cursor[node.round];
+    cursor[node.round] += node.n_actions;
+  }
+}
+
+uint32_t GameTree::compile(PokerState& state, const ActionProfile& action_profile) {
+  if(_nodes.size() == TERMINAL) throw std::runtime_error("GameTree --- Too many nodes.");
+  uint32_t id = _nodes.size();
+  std::array<Action, MAX_ACTIONS> actions;
+  int n_actions = valid_actions(state, action_profile, actions.data());
+  uint64_t edges = _children.size();
+  _nodes.push_back(TreeNode{edges, 0, state.get_pot(), static_cast<uint8_t>(n_actions), state.get_active(), state.get_round()});
+  _children.resize(edges + n_actions, TERMINAL);
+  _actions.insert(_actions.end(), actions.begin(), actions.begin() + n_actions);
+  for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+    StateDelta delta = state.apply_in_place(actions[a_idx]);
+    if(!state.is_terminal()) {
+      uint32_t child_id = compile(state, action_profile);
+      _children[edges + a_idx] = child_id;
+    }
+    state.undo(delta);
+  }
+  return id;
+}
+
+const TreeNode* GameTree::find(const ActionHistory& history) const {
+  const TreeNode* node = &root();
+  for(int h_idx = _root_state.get_action_history().size(); h_idx < history.size(); ++h_idx) {
+    const Action* node_actions = actions(*node);
+    int a_idx = std::distance(node_actions, std::find(node_actions, node_actions + node->n_actions, history.get(h_idx)));
+    if(a_idx == node->n_actions) return nullptr;
+    node = child(*node, a_idx);
+    if(!node) return nullptr;
+  }
+  return node;
+}
+
+}
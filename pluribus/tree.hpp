@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <limits>
+#include <cstdint>
+#include <pluribus/poker.hpp>
+#include <pluribus/actions.hpp>
+
+namespace pluribus {
+
+struct TreeNode {
+  uint64_t edges;    // First entry of this node in GameTree::children() and GameTree::actions().
+  uint64_t offset;   // Strategy offset in actions. The rows of cluster c start at offset * n_clusters + c * n_actions.
+  int pot;
+  uint8_t n_actions;
+  uint8_t active;
+  uint8_t round;
+};
+
+// Decision nodes of the abstract game below a root state, expanded once under an ActionProfile. Children of a node are
+// stored contiguously and strategy offsets are assigned round by round, so all preflop rows come first.
+class GameTree {
+public:
+  static constexpr uint32_t TERMINAL = std::numeric_limits<uint32_t>::max();
+
+  GameTree(const PokerState& root, const ActionProfile& action_profile);
+
+  const TreeNode& root() const { return _nodes[0]; }
+  const TreeNode& node(uint32_t id) const { return _nodes[id]; }
+  uint32_t id(const TreeNode& node) const { return &node - _nodes.data(); }
+  const TreeNode* child(const TreeNode& node, int a_idx) const {
+    uint32_t id = _children[node.edges + a_idx];
+    return id == TERMINAL ? nullptr : &_nodes[id];
+  }
+  const Action* actions(const TreeNode& node) const { return _actions.data() + node.edges; }
+  const TreeNode* find(const ActionHistory& history) const;
+  const PokerState& root_state() const { return _root_state; }
+  // Flat arrays of the tree, for serialization.
+  const std::vector<TreeNode>& nodes() const { return _nodes; }
+  const std::vector<uint32_t>& children() const { return _children; }
+  const std::vector<Action>& edge_actions() const { return _actions; }
+  size_t size() const { return _nodes.size(); }
+  // Total strategy size of all rounds before the given round, in actions. round_offset(4) is the size of the whole tree.
+  uint64_t round_offset(int round) const { return _round_offsets[round]; }
+
+  template <class F>
+  void walk(F&& f) const {
+    PokerState state = _root_state;
+    walk(state, root(), f);
+  }
+
+private:
+  uint32_t compile(PokerState& state, const ActionProfile& action_profile);
+
+  template <class F>
+  void walk(PokerState& state, const TreeNode& node, F& f) const {
+    f(state, node);
+    for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) {
+      const TreeNode* next = child(node, a_idx);
+      if(!next) continue;
+      StateDelta delta = state.apply_in_place(actions(node)[a_idx]);
+      walk(state, *next, f);
+      state.undo(delta);
+    }
+  }
+
+  std::vector<TreeNode> _nodes;
+  std::vector<uint32_t> _children;
+  std::vector<Action> _actions;
+  std::array<uint64_t, 5> _round_offsets;
+  PokerState _root_state;
+};
+
+}
@@ -6,12 +6,22 @@
 #include <array>
 #include <vector>
 #include <fstream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
 #include <algorithm>
+#include <numeric>
 #include <cmath>
+#include <cstdlib>
+#include <new>
 #include <unistd.h>
+#include <csignal>
+#include <sys/wait.h>
+#include <omp.h>
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/unordered_map.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <json/json.hpp>
 #include <omp/Hand.h>
 #include <omp/HandEvaluator.h>
 #include <hand_isomorphism/hand_index.h>
@@ -21,16 +31,39 @@
 #include <pluribus/simulate.hpp>
 #include <pluribus/actions.hpp>
 #include <pluribus/storage.hpp>
+#include <pluribus/tree.hpp>
+#include <pluribus/infoset.hpp>
+#include <pluribus/deal.hpp>
 #include <pluribus/mccfr.hpp>
+#include <pluribus/simd.hpp>
 #include <pluribus/cereal_ext.hpp>
 #include <pluribus/util.hpp>
 #include <pluribus/rng.hpp>
+#include <pluribus/numa.hpp>
+#include <pluribus/transport.hpp>
+#include <pluribus/replica.hpp>
+#include <pluribus/mapped.hpp>
+#include <pluribus/compressed.hpp>
+#include <pluribus/hot.hpp>
+#include <pluribus/coro.hpp>
+#include <pluribus/sums.hpp>
 
 using namespace pluribus;
 using std::string;
 using std::cout;
 using std::endl;
 
+thread_local long n_allocs = 0;
+
+void* operator new(std::size_t size) {
+  ++n_allocs;
+  if(void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
 omp::Hand init_hand(const std::string& str) {
   return omp::Hand::empty() + omp::Hand(std::string(str));
 }
@@ -234,6 +267,1064 @@ TEST_CASE("Sample PokerRange with dead_cards", "[range]") {
   }
 }
 
+TEST_CASE("Allocation-free strategy kernel", "[mccfr]") {
+  PokerConfig config{6, 10'000, 0};
+  BlueprintActionProfile profile{config.n_players};
+  StrategyStorage<int> regrets{profile, 200};
+  PokerState state{config};
+  state = state.apply(Action::CHECK_CALL);
+  int max_actions = profile.max_actions();
+  REQUIRE(max_actions == 6);
+  std::array<Action, MAX_ACTIONS> actions;
+  std::array<float, MAX_ACTIONS> freq;
+  regrets.index(state, 0);
+
+  long init_allocs = n_allocs;
+  for(int c = 0; c < 200; ++c) {
+    int n_actions = valid_actions(state, profile, actions.data());
+    REQUIRE(n_actions == n_valid_actions(state, profile));
+    size_t base_idx = regrets.index(state, c);
+    regrets[base_idx + c % n_actions].store(c);
+    calculate_strategy(regrets, base_idx, n_actions, freq.data());
+    int a_idx = sample_action_idx(freq.data(), n_actions);
+    REQUIRE((c == 0 || a_idx == c % n_actions));
+  }
+  REQUIRE(n_allocs == init_allocs);
+}
+
+namespace pluribus {
+
+// Runs iteration t on the context of the calling thread, with hot row deltas sized like at the start of an interval.
+void call_run_iteration(BlueprintTrainer& trainer, long t, bool full_ranges) {
+  auto& worker = *trainer._workers[omp_get_thread_num()];
+  if(worker.hot_deltas.size() != trainer._hot_rows.n_values()) worker.hot_deltas.assign(trainer._hot_rows.n_values(), 0);
+  trainer.run_iteration(t, worker, full_ranges);
+}
+
+}
+
+TEST_CASE("Allocation-free iterations", "[mccfr]") {
+  for(bool full_ranges : {true, false}) {
+    BlueprintTrainerConfig config{};
+    config.compile_tree = true;
+    config.hot_row_values = 1'000;
+    config.strategy_interval = 100;
+    config.prune_thresh = 10'000;
+    if(!full_ranges) {
+      for(auto& range : config.init_ranges) {
+        range = PokerRange{};
+        for(int h_idx = 0; h_idx < 1326; h_idx += 3) range.add_hand(HoleCardIndexer::get_instance()->hand(h_idx));
+      }
+    }
+    BlueprintTrainer trainer{config};
+    trainer.mccfr_p(10'000);
+    call_run_iteration(trainer, 10'000, full_ranges);
+
+    long init_allocs = n_allocs;
+    for(long t = 10'001; t < 12'001; ++t) call_run_iteration(trainer, t, full_ranges);
+    REQUIRE(n_allocs == init_allocs);
+  }
+}
+
+TEST_CASE("Regret matching kernels", "[mccfr]") {
+  std::uniform_int_distribution<int> dist(-1'000, 1'000);
+  for(int n = 1; n <= 40; ++n) {
+    for(int trial = 0; trial < 20; ++trial) {
+      std::vector<int> int_values(n);
+      std::vector<float> float_values(n);
+      for(int a_idx = 0; a_idx < n; ++a_idx) {
+        int_values[a_idx] = trial == 0 ? -a_idx : dist(GlobalRNG::instance());
+        float_values[a_idx] = int_values[a_idx] / 7.0f;
+      }
+      std::vector<float> expected(n), freq(n + 1);
+      regret_matching_scalar(int_values.data(), n, expected.data());
+      float sum = 0.0f;
+      for(int a_idx = 0; a_idx < n; ++a_idx) sum += expected[a_idx];
+      REQUIRE(std::abs(sum - 1.0f) < 1e-4);
+
+      auto check = [&](auto kernel) {
+        freq[n] = -1.0f;
+        kernel(int_values.data(), n, freq.data());
+        for(int a_idx = 0; a_idx < n; ++a_idx) REQUIRE(std::abs(freq[a_idx] - expected[a_idx]) < 1e-5);
+        kernel(float_values.data(), n, freq.data());
+        for(int a_idx = 0; a_idx < n; ++a_idx) REQUIRE(std::abs(freq[a_idx] - expected[a_idx]) < 1e-5);
+        REQUIRE(freq[n] == -1.0f);
+      };
+      check([](auto values, int n, float* freq) { regret_matching(values, n, freq); });
+      if(has_avx2()) check([](auto values, int n, float* freq) { regret_matching_avx2(values, n, freq); });
+      if(has_avx512()) check([](auto values, int n, float* freq) { regret_matching_avx512(values, n, freq); });
+    }
+  }
+}
+
+Task<long> lane_sum(int depth, long label, std::vector<long>& trace) {
+  if(depth == 0) co_return label;
+  trace.push_back(label);
+  co_await yield_lane();
+  if(label < 0) throw std::runtime_error("lane_sum --- Negative label.");
+  long left = co_await lane_sum(depth - 1, 2 * label, trace);
+  long right = co_await lane_sum(depth - 1, 2 * label + 1, trace);
+  co_return left + right;
+}
+
+TEST_CASE("Interleaved coroutine lanes", "[mccfr]") {
+  std::vector<long> trace;
+  std::array<Lane, 3> lanes;
+  std::array<Task<long>, 3> tasks;
+  for(int l_idx = 0; l_idx < 3; ++l_idx) {
+    tasks[l_idx] = lanes[l_idx].spawn([&, l_idx]() { return lane_sum(10, l_idx + 1, trace); });
+  }
+  while(std::any_of(lanes.begin(), lanes.end(), [](const Lane& lane) { return lane.resume_point; })) {
+    for(auto& lane : lanes) {
+      if(lane.resume_point) lane.resume();
+    }
+  }
+  for(int l_idx = 0; l_idx < 3; ++l_idx) {
+    long label = l_idx + 1, expected = 0;
+    for(long leaf = label << 10; leaf < (label + 1) << 10; ++leaf) expected += leaf;
+    REQUIRE(tasks[l_idx].done());
+    REQUIRE(tasks[l_idx].result() == expected);
+    tasks[l_idx].reset();
+    REQUIRE(lanes[l_idx].arena.used() == 0);
+  }
+  REQUIRE(trace.size() == 3 * 1023);
+  REQUIRE(std::vector<long>(trace.begin(), trace.begin() + 3) == std::vector<long>{1, 2, 3});
+
+  Lane lane;
+  std::vector<long> unused;
+  Task<long> failing = lane.spawn([&]() { return lane_sum(3, -1, unused); });
+  while(lane.resume_point) lane.resume();
+  REQUIRE_THROWS_AS(failing.result(), std::runtime_error);
+
+  Task<long> outside = lane_sum(4, 1, unused);
+  outside.handle().resume();
+  REQUIRE(outside.done());
+  REQUIRE(outside.result() == (16 + 31) * 16 / 2);
+}
+
+TEST_CASE("Reproducible RNG streams", "[rng]") {
+  auto draw = [](uint64_t seed, uint64_t stream) {
+    GlobalRNG::seed(seed, stream);
+    Deck deck;
+    deck.shuffle();
+    std::vector<int> cards;
+    for(int c = 0; c < 9; ++c) cards.push_back(deck.draw());
+    float freq[] = {0.1f, 0.0f, 0.6f, 0.3f};
+    for(int s = 0; s < 100; ++s) cards.push_back(sample_action_idx(freq, 4));
+    return cards;
+  };
+  auto expected = draw(7, 1'000);
+  REQUIRE(draw(7, 1'000) == expected);
+  std::vector<int> other_thread;
+  std::thread{[&]() { other_thread = draw(7, 1'000); }}.join();
+  REQUIRE(other_thread == expected);
+  REQUIRE(draw(7, 1'001) != expected);
+  REQUIRE(draw(8, 1'000) != expected);
+
+  GlobalRNG::seed(1, 0);
+  int counts[4] = {0, 0, 0, 0};
+  float freq[] = {0.1f, 0.0f, 0.6f, 0.3f};
+  for(int s = 0; s < 100'000; ++s) {
+    float u = uniform_float(GlobalRNG::instance());
+    REQUIRE((u >= 0.0f && u < 1.0f));
+    ++counts[sample_action_idx(freq, 4)];
+  }
+  REQUIRE(counts[1] == 0);
+  for(int a_idx = 0; a_idx < 4; ++a_idx) REQUIRE(std::abs(counts[a_idx] / 100'000.0 - freq[a_idx]) < 0.01);
+}
+
+TEST_CASE("Apply and undo PokerState in place", "[poker]") {
+  for(int n_players : {2, 3, 6, 9}) {
+    BlueprintActionProfile profile{n_players};
+    PokerState root{n_players};
+    for(int game = 0; game < 1'000; ++game) {
+      PokerState state = root;
+      std::vector<PokerState> path{state};
+      std::vector<StateDelta> deltas;
+      while(!state.is_terminal()) {
+        auto actions = valid_actions(state, profile);
+        std::uniform_int_distribution<int> dist(0, actions.size() - 1);
+        Action a = actions[dist(GlobalRNG::instance())];
+        deltas.push_back(state.apply_in_place(a));
+        REQUIRE(state == path.back().apply(a));
+        path.push_back(state);
+      }
+      long init_allocs = n_allocs;
+      for(int d = deltas.size() - 1; d >= 0; --d) {
+        state.undo(deltas[d]);
+        REQUIRE(state == path[d]);
+      }
+      for(int d = 0; d < deltas.size(); ++d) {
+        state.apply_in_place(path[d + 1].get_action_history().get(d));
+      }
+      REQUIRE(n_allocs == init_allocs);
+      REQUIRE(state == path.back());
+    }
+  }
+}
+
+TEST_CASE("Compile game tree", "[tree]") {
+  for(int n_players : {2, 3}) {
+    BlueprintActionProfile profile{n_players};
+    PokerState root{n_players};
+    GameTree tree{root, profile};
+    REQUIRE(tree.size() == count_actionsets(root, profile));
+
+    uint64_t prev_offset = 0;
+    for(int round = 0; round < 4; ++round) {
+      REQUIRE(tree.round_offset(round) >= prev_offset);
+      prev_offset = tree.round_offset(round);
+    }
+    for(size_t id = 0; id < tree.size(); ++id) {
+      const TreeNode& node = tree.node(id);
+      REQUIRE(node.offset >= tree.round_offset(node.round));
+      REQUIRE(node.offset + node.n_actions <= tree.round_offset(node.round + 1));
+    }
+
+    StrategyStorage<int> regrets{profile, 10};
+    regrets.allocate(tree);
+    REQUIRE(regrets.size() == tree.round_offset(4) * 10);
+    for(int game = 0; game < 1'000; ++game) {
+      PokerState state = root;
+      const TreeNode* node = &tree.root();
+      while(!state.is_terminal()) {
+        auto actions = valid_actions(state, profile);
+        REQUIRE(actions.size() == node->n_actions);
+        REQUIRE(std::equal(actions.begin(), actions.end(), tree.actions(*node)));
+        REQUIRE(node->active == state.get_active());
+        REQUIRE(node->round == state.get_round());
+        REQUIRE(tree.find(state.get_action_history()) == node);
+        int cluster = game % 10;
+        REQUIRE(regrets.index(*node, cluster, 1) == regrets.index(state, cluster, 1));
+        std::uniform_int_distribution<int> dist(0, actions.size() - 1);
+        int a_idx = dist(GlobalRNG::instance());
+        state = state.apply(actions[a_idx]);
+        node = tree.child(*node, a_idx);
+        REQUIRE((node == nullptr) == state.is_terminal());
+      }
+    }
+  }
+
+  // Per-node scratch arrays hold MAX_ACTIONS actions, wider profiles are rejected.
+  BlueprintActionProfile wide{2};
+  for(int a_idx = 0; a_idx <= MAX_ACTIONS; ++a_idx) wide.add_action(Action{1.0f + a_idx}, 0, 0, 0);
+  REQUIRE_THROWS_AS(GameTree(PokerState{2}, wide), std::runtime_error);
+}
+
+TEST_CASE("Pre-sized storage", "[storage]") {
+  static_assert(!std::is_copy_constructible_v<StrategyStorage<int>>);
+  BlueprintActionProfile profile{2};
+  PokerState root{2};
+  GameTree tree{root, profile};
+  for(bool huge_pages : {false, true}) {
+    StrategyStorage<int> regrets{profile, 10};
+    regrets.allocate(tree, 3, huge_pages);
+    REQUIRE(regrets.is_presized());
+    REQUIRE(regrets.size() == tree.round_offset(4) * 10);
+    REQUIRE(regrets.history_map().empty());
+    REQUIRE(regrets.n_histories() == tree.nodes().size());
+    for(size_t idx = 0; idx < regrets.size(); idx += 7) {
+      REQUIRE(regrets[idx].load() == 0);
+      regrets[idx].store(idx % 1'000);
+    }
+    PokerState state = root.apply(Action::CHECK_CALL);
+    REQUIRE(regrets.index(state, 3, 1) == regrets.index(*tree.find(state.get_action_history()), 3, 1));
+    REQUIRE(regrets.find(state.get_action_history()) == tree.find(state.get_action_history())->offset * 10);
+
+    StrategyStorage<float> phi{profile, 10};
+    phi.allocate(tree, 0, huge_pages);
+    REQUIRE(phi.size() == tree.round_offset(1) * 10);
+    REQUIRE_THROWS(phi.index(state.apply(Action::CHECK_CALL), 0));
+    REQUIRE(phi.find(state.apply(Action::CHECK_CALL).get_action_history()) == StrategyStorage<float>::NO_HISTORY);
+    REQUIRE(phi.n_histories() == std::count_if(tree.nodes().begin(), tree.nodes().end(), [](const TreeNode& node) { return node.round == 0; }));
+
+    std::string fn = "test_presized.bin";
+    cereal_save(regrets, fn);
+    auto loaded = cereal_load<StrategyStorage<int>>(fn);
+    unlink(fn.c_str());
+    REQUIRE(!loaded.is_presized());
+    REQUIRE(loaded.history_map().size() == regrets.n_histories());
+    REQUIRE(loaded == regrets);
+    loaded.allocate(tree, 3, huge_pages);
+    REQUIRE(loaded.is_presized());
+    REQUIRE(loaded.history_map().empty());
+    REQUIRE(loaded == regrets);
+  }
+}
+
+TEST_CASE("Lazy discount", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree);
+  std::uniform_int_distribution<int> dist(-1'000'000, 1'000'000);
+  std::vector<double> expected(regrets.size());
+  for(size_t idx = 0; idx < regrets.size(); ++idx) {
+    regrets[idx].store(dist(GlobalRNG::instance()));
+    expected[idx] = regrets[idx].load();
+  }
+
+  // Values are truncated once per settled page instead of once per discount, so they may differ by one per discount.
+  for(int k = 1; k <= 5; ++k) {
+    double d = static_cast<double>(k) / (k + 1);
+    regrets.discount(d);
+    for(double& e : expected) e *= d;
+    for(size_t idx = k * 997; idx < regrets.size(); idx += 50'000) {
+      REQUIRE(std::abs(regrets[idx].load() - expected[idx]) <= k);
+    }
+    int values[3];
+    regrets.load_row(4'095, 3, values);
+    for(int a_idx = 0; a_idx < 3; ++a_idx) REQUIRE(std::abs(values[a_idx] - expected[4'095 + a_idx]) <= k);
+  }
+  regrets.for_each([&](size_t idx, int value) { REQUIRE(std::abs(value - expected[idx]) <= 5); });
+}
+
+// Forked snapshots walk the storage in a child. libgomp hangs in a child once the parent used OpenMP, so the walk must 
+// settle discounted pages serially.
+TEST_CASE("Walk discounted storage in a forked child", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree);
+  for(size_t idx = 0; idx < regrets.size(); ++idx) regrets[idx].store(1'000);
+  regrets.discount(0.5);
+  // The parent needs a thread pool, even on a single core.
+  int max_threads = omp_get_max_threads();
+  omp_set_num_threads(std::max(max_threads, 2));
+  int n_threads = 0;
+  #pragma omp parallel reduction(+:n_threads)
+  n_threads += 1;
+  REQUIRE(n_threads > 1);
+
+  pid_t pid = fork();
+  if(pid == 0) {
+    bool settled = true;
+    regrets.for_each([&](size_t idx, int value) { settled = settled && value == 500; });
+    _exit(settled ? 0 : 1);
+  }
+  omp_set_num_threads(max_threads);
+  REQUIRE(pid > 0);
+  int status = 0;
+  bool exited = false;
+  for(int poll = 0; poll < 1'000 && !exited; ++poll) {
+    exited = waitpid(pid, &status, WNOHANG) == pid;
+    if(!exited) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if(!exited) {
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+  }
+  REQUIRE(exited);
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(WEXITSTATUS(status) == 0);
+}
+
+TEST_CASE("Delta checkpoints", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree);
+  std::uniform_int_distribution<int> dist(-1'000'000, 1'000'000);
+  for(size_t idx = 0; idx < regrets.size(); ++idx) regrets[idx].store(dist(GlobalRNG::instance()));
+  std::string base_fn = "test_base.bin";
+  cereal_save(regrets, base_fn);
+  regrets.mark_checkpoint();
+  REQUIRE(regrets.dirty_pages().empty());
+
+  // Some pages are settled by reads only, others are written before or after the discount.
+  std::vector<std::string> delta_fns{"test_delta0.bin", "test_delta1.bin"};
+  for(int k = 0; k < 2; ++k) {
+    int values[3] = {k, -k, 1'000 * k};
+    regrets.store_row(k * 50'000, 3, values);
+    regrets.discount(0.5 + 0.25 * k);
+    regrets.get(100'000 + k * 4'096);
+    regrets.store_row(200'000 + k * 10'000, 3, values);
+    REQUIRE(regrets.dirty_pages().size() <= 4);
+    std::ofstream os(delta_fns[k], std::ios::binary);
+    cereal::BinaryOutputArchive oarchive(os);
+    regrets.save_delta(oarchive);
+    regrets.clear_dirty();
+  }
+
+  auto rebuilt = cereal_load<StrategyStorage<int>>(base_fn);
+  rebuilt.allocate(tree);
+  for(const auto& fn : delta_fns) {
+    std::ifstream is(fn, std::ios::binary);
+    cereal::BinaryInputArchive iarchive(is);
+    rebuilt.load_delta(iarchive);
+  }
+  REQUIRE(rebuilt == regrets);
+  unlink(base_fn.c_str());
+  for(const auto& fn : delta_fns) unlink(fn.c_str());
+}
+
+TEST_CASE("Compressed snapshots", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree);
+  std::uniform_int_distribution<int> dist(-1'000'000, 1'000'000);
+  for(size_t idx = 0; idx < regrets.size(); idx += 7) regrets[idx].store(dist(GlobalRNG::instance()));
+  regrets.discount(0.5);
+
+  for(int n_shards : {1, 3, 8}) {
+    std::ostringstream os;
+    {
+      cereal::BinaryOutputArchive oarchive(os);
+      save_compressed(regrets, oarchive, "test_regrets", n_shards);
+    }
+    StrategyStorage<int> loaded;
+    std::istringstream is(os.str());
+    {
+      cereal::BinaryInputArchive iarchive(is);
+      load_compressed(loaded, iarchive, ".");
+    }
+    REQUIRE(!loaded.is_presized());
+    REQUIRE(loaded.size() == regrets.size());
+    loaded.allocate(tree);
+    REQUIRE(loaded == regrets);
+    for(int shard = 0; shard < n_shards; ++shard) unlink(("test_regrets." + std::to_string(shard) + ".gz").c_str());
+  }
+
+  std::ostringstream os;
+  {
+    cereal::BinaryOutputArchive oarchive(os);
+    save_compressed(regrets, oarchive, "test_regrets", 2);
+  }
+  unlink("test_regrets.1.gz");
+  StrategyStorage<int> loaded;
+  std::istringstream is(os.str());
+  cereal::BinaryInputArchive iarchive(is);
+  REQUIRE_THROWS(load_compressed(loaded, iarchive, "."));
+  unlink("test_regrets.0.gz");
+}
+
+TEST_CASE("Frozen preflop strategy", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 169};
+  regrets.allocate(tree);
+  std::uniform_int_distribution<int> dist(-1'000'000, 1'000'000);
+  for(size_t idx = 0; idx < regrets.size(); ++idx) regrets[idx].store(dist(GlobalRNG::instance()));
+  regrets[0].store(-400'000'000);
+  FrozenStrategy frozen{regrets, tree, -300'000'000};
+  REQUIRE(frozen.size() == tree.round_offset(1) * 169);
+  REQUIRE(frozen.pruned(0));
+  REQUIRE(!frozen.contains(tree.round_offset(1) * 169));
+  tree.walk([&](const PokerState& state, const TreeNode& node) {
+    if(node.round > 0) return;
+    for(int cluster = 0; cluster < 169; cluster += 13) {
+      size_t base_idx = regrets.index(node, cluster);
+      REQUIRE(frozen.contains(base_idx));
+      auto freq = calculate_strategy(regrets, base_idx, node.n_actions);
+      for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) {
+        REQUIRE(frozen.row(base_idx)[a_idx] == freq[a_idx]);
+        REQUIRE(frozen.pruned(base_idx + a_idx) == (regrets.get(base_idx + a_idx) <= -300'000'000));
+      }
+    }
+  });
+}
+
+TEST_CASE("Frozen preflop strategy of lazy regrets", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 169};
+  // The walk visits parents first, so indexing a prefix of it scatters preflop histories between flop histories.
+  std::vector<std::pair<PokerState, const TreeNode*>> visited;
+  tree.walk([&](const PokerState& state, const TreeNode& node) {
+    if(visited.size() >= 2000 || node.round > 1) return;
+    regrets.index(state, 0);
+    visited.emplace_back(state, &node);
+  });
+  std::uniform_int_distribution<int> dist(-1'000'000, 1'000'000);
+  for(size_t idx = 0; idx < regrets.size(); ++idx) regrets[idx].store(dist(GlobalRNG::instance()));
+  FrozenStrategy frozen{regrets, PokerState{2}, -300'000};
+  size_t n_frozen = 0;
+  for(const auto& [state, node] : visited) {
+    size_t base_idx = regrets.index(state, 168);
+    if(node->round > 0) {
+      REQUIRE(!frozen.contains(base_idx));
+      continue;
+    }
+    n_frozen += node->n_actions * 169;
+    REQUIRE(frozen.contains(base_idx));
+    auto freq = calculate_strategy(regrets, base_idx, node->n_actions);
+    for(int a_idx = 0; a_idx < node->n_actions; ++a_idx) {
+      REQUIRE(frozen.row(base_idx)[a_idx] == freq[a_idx]);
+      REQUIRE(frozen.pruned(base_idx + a_idx) == (regrets.get(base_idx + a_idx) <= -300'000));
+    }
+  }
+  REQUIRE(frozen.size() == n_frozen);
+}
+
+TEST_CASE("Hot regret rows", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree);
+  const TreeNode& root = tree.root();
+  const TreeNode* child = tree.child(root, 1);
+  const TreeNode* cold = tree.child(root, 2);
+  std::unordered_map<uint32_t, long> visits{{tree.id(root), 100}, {tree.id(*child), 50}, {tree.id(*cold), 5}};
+  std::array<Precision, 4> precision = {Precision::INT32, Precision::INT32, Precision::INT32, Precision::INT32};
+  HotRows hot{tree, visits, 10, precision, 10, 1'000};
+  REQUIRE(hot.n_nodes() == 2);
+  REQUIRE(hot.n_values() == (root.n_actions + child->n_actions) * 10);
+  REQUIRE(hot.slot(regrets.index(*cold, 0)) == -1);
+  REQUIRE(hot.slot(regrets.index(root, 0)) >= 0);
+  REQUIRE(hot.slot(regrets.index(*child, 9, child->n_actions - 1)) >= 0);
+  REQUIRE(HotRows{tree, visits, 10, precision, 10, root.n_actions * 10}.n_nodes() == 1);
+
+  size_t idx = regrets.index(root, 3, 1);
+  size_t floor_idx = regrets.index(*child, 0);
+  regrets[floor_idx].store(-90);
+  int n_threads = 4;
+  long positive = 0;
+  #pragma omp parallel num_threads(n_threads) reduction(+:positive)
+  {
+    std::vector<long> deltas(hot.n_values(), 0);
+    for(int k = 0; k < 1'000; ++k) {
+      deltas[hot.slot(idx)] += 1;
+      deltas[hot.slot(floor_idx)] -= 1;
+      positive += hot.flush(regrets, deltas.data(), -100);
+    }
+  }
+  REQUIRE(regrets.get(idx) == n_threads * 1'000);
+  REQUIRE(regrets.get(floor_idx) == -100);
+  REQUIRE(positive == n_threads * 1'000);
+}
+
+TEST_CASE("Hot regret rows against direct updates", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree);
+  const TreeNode& root = tree.root();
+  std::unordered_map<uint32_t, long> visits{{tree.id(root), 100}};
+  std::array<Precision, 4> precision = {Precision::INT32, Precision::INT32, Precision::INT32, Precision::INT32};
+  HotRows hot{tree, visits, 10, precision, 10, 1'000};
+  size_t idx = regrets.index(root, 0);
+  int floor = -100;
+  std::uniform_int_distribution<int> dist(-40, 40);
+  std::vector<long> deltas(hot.n_values(), 0);
+  for(int k = 0; k < 1'000; ++k) {
+    int prev = dist(GlobalRNG::instance()) - 60;
+    regrets[idx].store(prev);
+    long direct = prev;
+    long sum = 0;
+    bool lifted = false;
+    for(int u = 0; u < 8; ++u) {
+      int delta = dist(GlobalRNG::instance());
+      lifted = lifted || direct + delta < floor;
+      direct = std::max<long>(direct + delta, floor);
+      deltas[hot.slot(idx)] += delta;
+      sum += delta;
+    }
+    hot.flush(regrets, deltas.data(), floor);
+    // The floor only applies to the sum, so the flushed value matches direct updates unless they were lifted.
+    REQUIRE(regrets.get(idx) == std::max<long>(prev + sum, floor));
+    REQUIRE(regrets.get(idx) >= floor);
+    REQUIRE(regrets.get(idx) <= direct);
+    if(!lifted) REQUIRE(regrets.get(idx) == direct);
+  }
+}
+
+TEST_CASE("NUMA placement", "[numa]") {
+  int n_nodes = n_numa_nodes();
+  REQUIRE(n_nodes >= 1);
+  AtomicBlock<int> block{size_t{1} << 20, false, true};
+  REQUIRE(block.is_mapped());
+  std::vector<size_t> pages = page_nodes(block.data(), block.bytes());
+  REQUIRE(pages.size() == n_nodes);
+  REQUIRE(std::accumulate(pages.begin(), pages.end(), size_t{0}) > 0);
+  REQUIRE(!placement_str(pages).empty());
+  REQUIRE(remote_ratio({100}, 8) == 0.0);
+  REQUIRE(remote_ratio({50, 50}, 2) == 0.5);
+  REQUIRE(remote_ratio({100, 0}, 2) == 0.5);
+
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree, 3, false, true);
+  pages = regrets.placement();
+  REQUIRE(std::accumulate(pages.begin(), pages.end(), size_t{0}) > 0);
+}
+
+TEST_CASE("Reorder lazy regrets", "[storage]") {
+  BlueprintActionProfile profile{2};
+  PokerState init_state{2};
+  std::vector<PokerState> states{init_state};
+  for(size_t s_idx = 0; states.size() < 40; ++s_idx) {
+    for(Action a : valid_actions(states[s_idx], profile)) {
+      PokerState next = states[s_idx].apply(a);
+      if(!next.is_terminal()) states.push_back(next);
+    }
+  }
+  StrategyStorage<int> regrets{profile, 10};
+  for(const auto& state : states) {
+    for(int cluster = 0; cluster < 10; ++cluster) {
+      for(int a_idx = 0; a_idx < n_valid_actions(state, profile); ++a_idx) {
+        regrets[regrets.index(state, cluster, a_idx)].store(cluster * 100 + a_idx + 1);
+      }
+    }
+  }
+  size_t prev_size = regrets.size();
+  std::unordered_map<size_t, long> visits;
+  for(int s_idx : {3, 17, 29, 38}) {
+    for(int cluster = 0; cluster < 10; ++cluster) visits[regrets.index(states[s_idx], cluster)] += 100 - s_idx;
+  }
+
+  ReorderStats stats = regrets.reorder(visits, init_state, 64 * 16);
+  REQUIRE(stats.hot_histories == 4);
+  REQUIRE(stats.miss_rate_after < stats.miss_rate_before);
+  REQUIRE(stats.sweep_ns_before > 0.0);
+  REQUIRE(stats.sweep_ns_after > 0.0);
+  // Visited histories are laid out depth first, whatever their visits.
+  std::vector<int> hot{3, 17, 29, 38};
+  std::sort(hot.begin(), hot.end(), [&](int a, int b) {
+    const auto& a_actions = states[a].get_action_history().get_history();
+    const auto& b_actions = states[b].get_action_history().get_history();
+    return std::lexicographical_compare(a_actions.begin(), a_actions.end(), b_actions.begin(), b_actions.end(), 
+                                        [](const Action& x, const Action& y) { return x.get_bet_type() < y.get_bet_type(); });
+  });
+  REQUIRE(regrets.index(states[hot[0]], 0) == 0);
+  for(int h_idx = 1; h_idx < hot.size(); ++h_idx) {
+    REQUIRE(regrets.index(states[hot[h_idx]], 0) % 16 == 0);
+    REQUIRE(regrets.index(states[hot[h_idx]], 0) > regrets.index(states[hot[h_idx - 1]], 0));
+  }
+  REQUIRE(regrets.index(states[0], 0) % 1'024 == 0);
+  REQUIRE(regrets.size() < prev_size + 1'024 + 4 * 16);
+  for(const auto& state : states) {
+    for(int cluster = 0; cluster < 10; ++cluster) {
+      for(int a_idx = 0; a_idx < n_valid_actions(state, profile); ++a_idx) {
+        REQUIRE(regrets[regrets.index(state, cluster, a_idx)].load() == cluster * 100 + a_idx + 1);
+      }
+    }
+  }
+  // Without visits the padding of the hot histories is dropped and the storage shrinks back to its values.
+  stats = regrets.reorder({}, init_state, 64 * 16);
+  REQUIRE(stats.hot_histories == 0);
+  REQUIRE(regrets.size() == prev_size);
+  for(const auto& state : states) {
+    for(int cluster = 0; cluster < 10; ++cluster) {
+      for(int a_idx = 0; a_idx < n_valid_actions(state, profile); ++a_idx) {
+        REQUIRE(regrets[regrets.index(state, cluster, a_idx)].load() == cluster * 100 + a_idx + 1);
+      }
+    }
+  }
+  GameTree tree{init_state, profile};
+  StrategyStorage<int> presized{profile, 10};
+  presized.allocate(tree);
+  REQUIRE_THROWS_AS(presized.reorder(visits, init_state, 64), std::runtime_error);
+}
+
+TEST_CASE("Cached row sums", "[storage]") {
+  BlueprintActionProfile profile{2};
+  GameTree tree{PokerState{2}, profile};
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.allocate(tree);
+  std::array<Precision, 4> precision = {Precision::INT32, Precision::INT32, Precision::INT32, Precision::INT8};
+  RowSums sums{tree, 10, precision};
+  const TreeNode& root = tree.root();
+  auto river = std::find_if(tree.nodes().begin(), tree.nodes().end(), [](const TreeNode& node) { return node.round == 3; });
+  REQUIRE(river != tree.nodes().end());
+  REQUIRE(sums.slot(tree.id(*river), 0) == -1);
+  long slot = sums.slot(tree.id(root), 2);
+  REQUIRE(slot >= 0);
+
+  int n_actions = root.n_actions;
+  std::vector<int> row(n_actions, -5);
+  row[0] = 30;
+  row[2] = 10;
+  regrets.store_row(regrets.index(root, 2), n_actions, row.data());
+  sums.rebuild(regrets, tree);
+  REQUIRE(sums.load(slot) == 40.0f);
+  REQUIRE(sums.load(sums.slot(tree.id(root), 3)) == 0.0f);
+  std::vector<int> counts(n_actions, 0);
+  for(int k = 0; k < 1'000; ++k) ++counts[sums.sample(slot, row.data(), n_actions, k / 1'000.0f)];
+  REQUIRE(counts[0] == 750);
+  REQUIRE(counts[2] == 250);
+  REQUIRE(counts[0] + counts[2] == 1'000);
+
+  // Stale sums which don't cover the row and rows without positive regret are left to the caller.
+  sums.store(slot, 100);
+  REQUIRE(sums.sample(slot, row.data(), n_actions, 0.2f) == 0);
+  REQUIRE(sums.sample(slot, row.data(), n_actions, 0.5f) == -1);
+  sums.store(slot, 0);
+  REQUIRE(sums.sample(slot, row.data(), n_actions, 0.2f) == -1);
+  // An understated sum, e.g. from interleaved writers of the row, would never reach the trailing actions.
+  sums.store(slot, 30);
+  for(float r : {0.0f, 0.5f, 0.99f}) REQUIRE(sums.sample(slot, row.data(), n_actions, r) == -1);
+  sums.store(slot, 40);
+  REQUIRE(sums.sample(slot, row.data(), n_actions, 0.99f) == 2);
+  long large = (1L << 40) + 1;
+  sums.store(slot, large);
+  REQUIRE(static_cast<double>(sums.load(slot)) >= large);
+}
+
+TEST_CASE("Compact regret storage", "[storage]") {
+  BlueprintActionProfile profile{2};
+  PokerState root{2};
+  GameTree tree{root, profile};
+  int floor = -310'000'000;
+  int cutoff = -300'000'000;
+  StrategyStorage<int> regrets{profile, 10};
+  regrets.set_precision({Precision::INT32, Precision::INT32, Precision::INT16, Precision::INT8}, floor);
+  regrets.allocate(tree);
+  REQUIRE(regrets.is_compact());
+  REQUIRE(regrets.size() == tree.round_offset(4) * 10);
+
+  std::uniform_int_distribution<int> dist(floor, 100'000'000);
+  tree.walk([&](const PokerState& state, const TreeNode& node) {
+    std::array<int, MAX_ACTIONS> values;
+    std::array<int, MAX_ACTIONS> decoded;
+    for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) values[a_idx] = a_idx == 0 ? floor : dist(GlobalRNG::instance());
+    size_t base_idx = regrets.index(node, 3);
+    regrets.store_row(base_idx, node.n_actions, values.data());
+    regrets.load_row(base_idx, node.n_actions, decoded.data());
+    REQUIRE(decoded[0] >= floor);
+    REQUIRE(decoded[0] <= cutoff);
+    for(int a_idx = 0; a_idx < node.n_actions; ++a_idx) {
+      REQUIRE(regrets.get(base_idx + a_idx) == decoded[a_idx]);
+      REQUIRE(std::abs(decoded[a_idx] - values[a_idx]) <= (node.round < 2 ? 0 : node.round == 2 ? 16'384 : 1 << 23));
+    }
+  });
+
+  // Updates far below the quantization step are kept in expectation.
+  const TreeNode* river = &tree.root();
+  PokerState state = root;
+  while(state.get_round() < 3) {
+    state = state.apply(Action::CHECK_CALL);
+    river = tree.find(state.get_action_history());
+  }
+  for(Precision precision : {Precision::INT16, Precision::INT8}) {
+    StrategyStorage<int> small{profile, 10};
+    small.set_precision({Precision::INT32, Precision::INT32, Precision::INT32, precision}, floor);
+    small.allocate(tree);
+    size_t base_idx = small.index(*river, 0);
+    std::array<int, MAX_ACTIONS> row;
+    long sum = 0;
+    int n_samples = 100'000;
+    for(int sample = 0; sample < n_samples; ++sample) {
+      for(int a_idx = 0; a_idx < river->n_actions; ++a_idx) row[a_idx] = a_idx == 0 ? 1'000'000 : 1'000;
+      small.store_row(base_idx, river->n_actions, row.data());
+      small.load_row(base_idx, river->n_actions, row.data());
+      sum += row[1];
+    }
+    REQUIRE(std::abs(static_cast<double>(sum) / n_samples - 1'000.0) < 100.0);
+  }
+
+  // Discounts round like updates. Truncation would pull every quantized value towards zero.
+  for(Precision precision : {Precision::INT16, Precision::INT8}) {
+    StrategyStorage<int> discounted{profile, 10};
+    discounted.set_precision({Precision::INT32, Precision::INT32, Precision::INT32, precision}, floor);
+    discounted.allocate(tree);
+    int step = precision == Precision::INT16 ? 1 << 14 : 1 << 13;
+    std::vector<size_t> rows;
+    for(const TreeNode& node : tree.nodes()) {
+      if(node.round != 3) continue;
+      for(int c = 0; c < 10; ++c) rows.push_back(discounted.index(node, c));
+    }
+    std::array<int, MAX_ACTIONS> row;
+    row.fill(0);
+    row[0] = 1'000'000;
+    row[1] = 3 * step;
+    for(size_t base_idx : rows) discounted.store_row(base_idx, 2, row.data());
+    discounted.discount(0.5);
+    double sum = 0.0;
+    for(size_t base_idx : rows) sum += discounted.get(base_idx + 1);
+    REQUIRE(std::abs(sum / rows.size() - 1.5 * step) < 0.1 * step);
+    // Pages that missed several discounts are rounded once to the product of their factors.
+    for(size_t base_idx : rows) discounted.store_row(base_idx, 2, row.data());
+    discounted.discount(0.5);
+    discounted.discount(0.5);
+    sum = 0.0;
+    for(size_t base_idx : rows) sum += discounted.get(base_idx + 1);
+    REQUIRE(std::abs(sum / rows.size() - 0.75 * step) < 0.1 * step);
+  }
+
+  // Saturated INT16 rounds are rescaled at the next discount.
+  PokerState turn = root;
+  while(turn.get_round() < 2) turn = turn.apply(Action::CHECK_CALL);
+  size_t turn_idx = regrets.index(*tree.find(turn.get_action_history()), 0);
+  regrets.set(turn_idx, 800'000'000);
+  REQUIRE(regrets.get(turn_idx) < 600'000'000);
+  regrets.discount(1.0);
+  regrets.set(turn_idx, 800'000'000);
+  REQUIRE(std::abs(regrets.get(turn_idx) - 800'000'000) <= 32'768);
+  // And at the next rescale, which keeps working after the last discount.
+  regrets.set(turn_idx, 1'500'000'000);
+  REQUIRE(regrets.get(turn_idx) < 1'100'000'000);
+  regrets.rescale();
+  regrets.set(turn_idx, 1'500'000'000);
+  REQUIRE(std::abs(regrets.get(turn_idx) - 1'500'000'000) <= 65'536);
+
+  std::string fn = "test_compact.bin";
+  cereal_save(regrets, fn);
+  auto loaded = cereal_load<StrategyStorage<int>>(fn);
+  unlink(fn.c_str());
+  REQUIRE(!loaded.is_presized());
+  REQUIRE(loaded == regrets);
+  loaded.set_precision(regrets.precision(), floor);
+  loaded.allocate(tree);
+  REQUIRE(loaded == regrets);
+}
+
+TEST_CASE("Compact regrets converge like INT32", "[mccfr][storage]") {
+  // The INT16 step of the default floor is 2^14, far above most updates, which are only applied in expectation.
+  auto root_strategy = [](const std::array<Precision, 4>& precision, uint64_t seed) {
+    BlueprintTrainerConfig config{};
+    config.compile_tree = true;
+    config.regret_precision = precision;
+    config.seed = seed;
+    config.discount_interval = 10'000;
+    config.lcfr_thresh = 40'000;
+    BlueprintTrainer trainer{config, false, "test_snapshots"};
+    trainer.mccfr_p(50'000);
+    const TreeNode& root = trainer.get_tree()->root();
+    std::vector<float> freq;
+    for(int c = 0; c < trainer.get_regrets().n_clusters(); ++c) {
+      auto row = calculate_strategy(trainer.get_regrets(), trainer.get_regrets().index(root, c), root.n_actions);
+      freq.insert(freq.end(), row.begin(), row.end());
+    }
+    return freq;
+  };
+  auto distance = [](const std::vector<float>& a, const std::vector<float>& b) {
+    double sum = 0.0;
+    for(size_t idx = 0; idx < a.size(); ++idx) sum += std::abs(a[idx] - b[idx]);
+    return sum / a.size();
+  };
+  std::array<Precision, 4> full = {Precision::INT32, Precision::INT32, Precision::INT32, Precision::INT32};
+  std::array<Precision, 4> compact = {Precision::INT32, Precision::INT32, Precision::INT16, Precision::INT16};
+  auto reference = root_strategy(full, 1);
+  // Two INT32 runs differ by their samples. INT16 rounds may not add more than a fraction of that.
+  double noise = distance(reference, root_strategy(full, 2));
+  REQUIRE(distance(reference, root_strategy(compact, 1)) < 1.5 * noise);
+  std::filesystem::remove_all("test_snapshots");
+}
+
+TEST_CASE("Interleaved traversals converge like recursive ones", "[mccfr]") {
+  // Lanes run the same seeded iterations, but their strategies read other regrets once the order of updates differs, so
+  // the runs drift apart about as far as two seeds.
+  auto root_strategy = [](int interleave, uint64_t seed) {
+    BlueprintTrainerConfig config{};
+    config.compile_tree = true;
+    config.interleave = interleave;
+    config.seed = seed;
+    config.discount_interval = 10'000;
+    config.lcfr_thresh = 40'000;
+    BlueprintTrainer trainer{config, false, "test_snapshots"};
+    trainer.mccfr_p(50'000);
+    const TreeNode& root = trainer.get_tree()->root();
+    std::vector<float> freq;
+    for(int c = 0; c < trainer.get_regrets().n_clusters(); ++c) {
+      auto row = calculate_strategy(trainer.get_regrets(), trainer.get_regrets().index(root, c), root.n_actions);
+      freq.insert(freq.end(), row.begin(), row.end());
+    }
+    return freq;
+  };
+  auto distance = [](const std::vector<float>& a, const std::vector<float>& b) {
+    double sum = 0.0;
+    for(size_t idx = 0; idx < a.size(); ++idx) sum += std::abs(a[idx] - b[idx]);
+    return sum / a.size();
+  };
+  auto reference = root_strategy(1, 1);
+  double noise = distance(reference, root_strategy(1, 2));
+  REQUIRE(distance(reference, root_strategy(4, 1)) < 1.5 * noise);
+  std::filesystem::remove_all("test_snapshots");
+}
+
+TEST_CASE("Cluster deal", "[deal][blueprint]") {
+  int n_players = 6;
+  Deck deck;
+  Deal deal{n_players};
+  for(int game = 0; game < 10'000; ++game) {
+    deck.shuffle();
+    deal.board.deal(deck);
+    for(auto& hand : deal.hands) hand.deal(deck);
+    deal.update_clusters();
+    for(int p_idx = 0; p_idx < n_players; ++p_idx) {
+      for(int round = 0; round < 4; ++round) {
+        REQUIRE(deal.cluster(p_idx, round) == FlatClusterMap::get_instance()->cluster(round, deal.board, deal.hands[p_idx]));
+      }
+    }
+  }
+}
+
+TEST_CASE("Showdown payoff", "[deal]") {
+  omp::HandEvaluator eval;
+  for(int n_players : {2, 3, 6}) {
+    BlueprintActionProfile profile{n_players};
+    Deal deal{n_players};
+    Deck deck;
+    int n_showdowns = 0;
+    while(n_showdowns < 500) {
+      deck.reset();
+      deck.shuffle();
+      deal.board.deal(deck);
+      for(auto& hand : deal.hands) hand.deal(deck);
+      deal.update_ranks(eval);
+      PokerState state{n_players};
+      while(!state.is_terminal()) {
+        auto actions = valid_actions(state, profile);
+        std::uniform_int_distribution<int> dist(0, actions.size() - 1);
+        state = state.apply(actions[dist(GlobalRNG::instance())]);
+      }
+      if(state.get_winner() != -1) continue;
+      ++n_showdowns;
+
+      std::vector<uint8_t> win_idxs = winners(state, deal.hands, deal.board, eval);
+      long init_allocs = n_allocs;
+      int total = 0;
+      for(int i = 0; i < n_players; ++i) {
+        int payoff = deal.showdown_payoff(state, i, 10'000);
+        bool winner = std::find(win_idxs.begin(), win_idxs.end(), i) != win_idxs.end();
+        REQUIRE((winner || payoff == 0));
+        if(win_idxs.size() == 1 && winner) REQUIRE(payoff == state.get_pot());
+        total += payoff;
+      }
+      REQUIRE(n_allocs == init_allocs);
+      REQUIRE(total == state.get_pot());
+    }
+  }
+}
+
+TEST_CASE("Public chance showdown", "[deal]") {
+  omp::HandEvaluator eval;
+  std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+  for(const std::string& board_str : {"AcTd2h3cQs", "2c2d2h2s3c", "AsKsQsJsTs"}) {
+    PublicDeal deal;
+    deal.update_showdown(Board{board_str}, eval);
+    std::vector<float> reach(N_HANDS);
+    for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) reach[h_idx] = deal.blocked[h_idx] ? 0.0f : dist(GlobalRNG::instance());
+    std::vector<float> showdown(N_HANDS), fold(N_HANDS);
+    deal.showdown_values(reach.data(), -300.0f, 800.0f, showdown.data());
+    deal.fold_values(reach.data(), 150.0f, fold.data());
+
+    for(int h_idx = 0; h_idx < N_HANDS; h_idx += 7) {
+      if(deal.blocked[h_idx]) continue;
+      const Hand& hand = PublicDeal::hands()[h_idx];
+      double expected_showdown = 0.0, expected_fold = 0.0;
+      for(int o_idx = 0; o_idx < N_HANDS; ++o_idx) {
+        const Hand& opp = PublicDeal::hands()[o_idx];
+        if(deal.blocked[o_idx] || hand.cards()[0] == opp.cards()[0] || hand.cards()[0] == opp.cards()[1] || 
+           hand.cards()[1] == opp.cards()[0] || hand.cards()[1] == opp.cards()[1]) continue;
+        std::vector<uint8_t> win_idxs = winners(PokerState{2}, {hand, opp}, deal.board, eval);
+        double u = -300.0 + (win_idxs[0] == 0 ? 800.0 / win_idxs.size() : 0.0);
+        expected_showdown += reach[o_idx] * u;
+        expected_fold += reach[o_idx] * 150.0;
+      }
+      REQUIRE(std::abs(showdown[h_idx] - expected_showdown) < 0.5);
+      REQUIRE(std::abs(fold[h_idx] - expected_fold) < 0.5);
+    }
+  }
+}
+
+TEST_CASE("Socket transport", "[transport]") {
+  auto check_all_to_all = [](Transport& transport) {
+    std::vector<std::string> out(transport.size());
+    for(int peer = 0; peer < transport.size(); ++peer) {
+      if(peer != transport.rank()) out[peer] = std::string(100'000 * (peer + 1), 'a' + transport.rank());
+    }
+    auto in = all_to_all(transport, out);
+    for(int peer = 0; peer < transport.size(); ++peer) {
+      if(peer == transport.rank()) REQUIRE(in[peer].empty());
+      else REQUIRE(in[peer] == std::string(100'000 * (transport.rank() + 1), 'a' + peer));
+    }
+  };
+
+  auto transports = SocketTransport::mesh(3);
+  std::vector<std::thread> threads;
+  for(auto& transport : transports) threads.emplace_back([&]() { check_all_to_all(*transport); });
+  for(auto& thread : threads) thread.join();
+
+  std::filesystem::path dir = std::filesystem::temp_directory_path();
+  std::vector<std::unique_ptr<SocketTransport>> connected(3);
+  threads.clear();
+  for(int rank = 0; rank < 3; ++rank) threads.emplace_back([&, rank]() { connected[rank] = SocketTransport::connect(dir.string(), rank, 3); });
+  for(auto& thread : threads) thread.join();
+  threads.clear();
+  for(auto& transport : connected) threads.emplace_back([&]() { check_all_to_all(*transport); });
+  for(auto& thread : threads) thread.join();
+
+  // A closed peer surfaces as an error of the exchange instead of terminating the process.
+  auto closing = SocketTransport::mesh(2);
+  closing[1].reset();
+  REQUIRE_THROWS_AS(all_to_all(*closing[0], {"", std::string(100'000, 'a')}), std::runtime_error);
+
+  ReplicaBatch batch;
+  std::array<long, 2> deltas{-5, 3'000'000'000};
+  batch.add_row(4'095, 2, deltas.data());
+  batch.add_row(1'000'000, 3, static_cast<const long*>(nullptr));
+  batch.phi_idxs = {2};
+  batch.phi_values = {1.5f};
+  batch.blocks = {0, 7};
+  ReplicaBatch loaded = ReplicaBatch::unpack(batch.pack());
+  REQUIRE(loaded.row_idxs == std::vector<size_t>{4'095, 1'000'000});
+  REQUIRE(loaded.row_actions == std::vector<uint8_t>{2, 3});
+  REQUIRE(loaded.row_values == std::vector<long>{-5, 3'000'000'000});
+  REQUIRE(loaded.phi_idxs == batch.phi_idxs);
+  REQUIRE(loaded.phi_values == batch.phi_values);
+  REQUIRE(loaded.blocks == batch.blocks);
+  REQUIRE(value_owner(4'095, 2) == 0);
+  REQUIRE(value_owner(4'096, 2) == 1);
+}
+
+TEST_CASE("Row cache", "[transport]") {
+  RowCache cache{8};
+  std::array<int, 3> values;
+  REQUIRE(cache.load(100, 3, values.data()));
+  REQUIRE(values == std::array<int, 3>{0, 0, 0});
+  std::array<int, 3> stored{5, -2, 0};
+  REQUIRE(cache.store(100, 3, stored.data()));
+  REQUIRE(cache.store(200, 3, stored.data()));
+  // The values have no room for a third row.
+  REQUIRE(!cache.store(300, 3, stored.data()));
+  REQUIRE(!cache.load(300, 3, values.data()));
+  REQUIRE(values == std::array<int, 3>{0, 0, 0});
+  long n_deltas = 0;
+  cache.for_each_delta([&](size_t base_idx, int n_actions, const long* deltas) {
+    REQUIRE(n_actions == 3);
+    REQUIRE(std::vector<long>(deltas, deltas + 3) == std::vector<long>{5, -2, 0});
+    ++n_deltas;
+  });
+  REQUIRE(n_deltas == 2);
+
+  // Used rows are kept unfetched, up to the capacity. Filled rows read the values of their owners and have no deltas.
+  RowCache next = cache.rebuild([](size_t base_idx, int n_actions) { return true; });
+  auto rows = next.unfetched();
+  REQUIRE(rows.size() == 2);
+  std::array<int, 3> owned{7, 1, -4};
+  for(const auto& [base_idx, n_actions] : rows) next.fill(base_idx, owned.data());
+  REQUIRE(next.unfetched().empty());
+  next.for_each_delta([](size_t base_idx, int n_actions, const long* deltas) { FAIL("Fetched rows have no deltas."); });
+  REQUIRE(next.load(rows[0].first, 3, values.data()));
+  REQUIRE(values == owned);
+
+  // Fetched rows which didn't change are copied, rows unused since the last rebuild are dropped.
+  RowCache kept = next.rebuild([](size_t base_idx, int n_actions) { return false; });
+  REQUIRE(kept.n_rows() == 1);
+  REQUIRE(kept.unfetched().empty());
+  kept.for_each_row([&](size_t base_idx, int n_actions, const int* row) {
+    REQUIRE(base_idx == rows[0].first);
+    REQUIRE(std::vector<int>(row, row + n_actions) == std::vector<int>{7, 1, -4});
+  });
+  kept.discount(0.5);
+  REQUIRE(kept.unfetched() == std::vector<std::pair<size_t, int>>{rows[0]});
+  REQUIRE(kept.load(rows[0].first, 3, values.data()));
+  REQUIRE(values == std::array<int, 3>{3, 0, -2});
+}
+
+TEST_CASE("Mapped snapshot header", "[serialize]") {
+  std::string fn = "test_not_mapped.bin";
+  cereal_save(Hand{"AcKd"}, fn);
+  REQUIRE(!is_mapped_snapshot(fn));
+  REQUIRE_THROWS(MappedSnapshot{fn});
+  unlink(fn.c_str());
+  REQUIRE(!is_mapped_snapshot("missing.snap"));
+  REQUIRE_THROWS(MappedSnapshot{"missing.snap"});
+}
+
 TEST_CASE("Serialize Hand", "[serialize]") {
   REQUIRE(test_serialization(Hand{"Ac2s"}));
   REQUIRE(test_serialization(Hand{"3h5h"}));
@@ -264,6 +1355,45 @@ TEST_CASE("Serialize ActionHistory", "[serialize]") {
   REQUIRE(test_serialization(actions));
 }
 
+TEST_CASE("Serialize BlueprintTrainerConfig", "[serialize]") {
+  BlueprintTrainerConfig config{6, 10'000, 0};
+  config.regret_floor = -123;
+  config.compile_tree = true;
+  config.seed = 7;
+  config.interleave = 4;
+  REQUIRE(test_serialization(config));
+}
+
+// Written by the trainer from before the config layout was tagged, after 200 iterations of a heads-up river spot.
+TEST_CASE("Load legacy trainer", "[serialize][blueprint]") {
+  auto trainer = cereal_load<BlueprintTrainer>(std::string{PROJECT_ROOT_DIR} + "/resources/legacy_trainer.bin");
+  const auto& config = trainer.get_config();
+  REQUIRE(config.poker == PokerConfig{2, 10'000, 0});
+  REQUIRE(config.init_state.get_round() == 3);
+  REQUIRE(cards_to_str(config.init_board.data(), config.init_board.size()) == "AcKd7h5s2c");
+  REQUIRE(config.regret_floor == -310'000'000);
+  REQUIRE(config.compile_tree == BlueprintTrainerConfig{}.compile_tree);
+  REQUIRE(trainer.get_regrets().size() > 0);
+  REQUIRE(test_serialization(trainer));
+}
+
+TEST_CASE("Train legacy trainer", "[mccfr][blueprint]") {
+  // Without a seed in the archive, both copies continue with the default seed and train identically.
+  std::string fn = std::string{PROJECT_ROOT_DIR} + "/resources/legacy_trainer.bin";
+  auto trainer = cereal_load<BlueprintTrainer>(fn);
+  auto copy = cereal_load<BlueprintTrainer>(fn);
+  auto legacy = cereal_load<BlueprintTrainer>(fn);
+  REQUIRE(trainer.get_config().seed == BlueprintTrainerConfig{}.seed);
+  int n_threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  trainer.mccfr_p(1'000);
+  copy.mccfr_p(1'000);
+  omp_set_num_threads(n_threads);
+  REQUIRE(trainer == copy);
+  REQUIRE(trainer.get_regrets().size() >= legacy.get_regrets().size());
+  REQUIRE(!(trainer.get_regrets() == legacy.get_regrets()));
+}
+
 TEST_CASE("Serialize StrategyStorage, BlueprintTrainer", "[serialize][blueprint]") {
   BlueprintTrainerConfig config{};
   BlueprintTrainer trainer{config};
@@ -271,6 +1401,304 @@ TEST_CASE("Serialize StrategyStorage, BlueprintTrainer", "[serialize][blueprint]
 
   REQUIRE(test_serialization(trainer.get_regrets()));
   REQUIRE(test_serialization(trainer));
+
+  std::string fn = "test_compressed.bin";
+  trainer.save_compressed(fn, 4);
+  REQUIRE(is_compressed_snapshot(fn));
+  REQUIRE(load_snapshot(fn, {}) == trainer);
+  unlink(fn.c_str());
+  for(std::string storage : {".regrets.", ".phi."}) {
+    for(int shard = 0; shard < 4; ++shard) unlink((fn + storage + std::to_string(shard) + ".gz").c_str());
+  }
+}
+
+TEST_CASE("Mapped snapshot", "[serialize][blueprint]") {
+  for(bool compile_tree : {false, true}) {
+    BlueprintTrainerConfig config{};
+    config.compile_tree = compile_tree;
+    BlueprintTrainer trainer{config};
+    trainer.mccfr_p(20'000);
+    std::string fn = "test_mapped.snap";
+    save_mapped(trainer, fn);
+    REQUIRE(is_mapped_snapshot(fn));
+    MappedSnapshot snapshot{fn};
+    REQUIRE(snapshot.get_config() == config);
+    REQUIRE(snapshot.n_regrets() == GameTree{config.init_state, config.action_profile}.round_offset(4) * snapshot.n_clusters());
+    const auto& regrets = trainer.get_regrets();
+    regrets.for_each_history([&](const ActionHistory& history, size_t idx) {
+      PokerState state = config.init_state.apply(history);
+      for(int c = 0; c < snapshot.n_clusters(); c += 17) {
+        REQUIRE(snapshot.regrets()[snapshot.regret_index(state, c)] == regrets.get(trainer.regret_index(state, c)));
+      }
+    });
+    unlink(fn.c_str());
+  }
+}
+
+TEST_CASE("Metrics thread", "[mccfr][blueprint]") {
+  BlueprintTrainerConfig config{};
+  config.log_interval = 100'000;
+  std::filesystem::path metrics_dir = "test_metrics";
+  BlueprintTrainer trainer{config, false, "test_snapshots", metrics_dir.string()};
+  trainer.mccfr_p(250'000);
+
+  int n_samples = 0;
+  for(const auto& entry : std::filesystem::directory_iterator(metrics_dir)) {
+    std::ifstream file{entry.path()};
+    auto metrics = nlohmann::json::parse(file);
+    REQUIRE(metrics.contains("avg_regret"));
+    REQUIRE(metrics["metrics_dropped"] == 0);
+    ++n_samples;
+  }
+  std::filesystem::remove_all(metrics_dir);
+  std::filesystem::remove_all("test_snapshots");
+  REQUIRE(n_samples == 2);
+}
+
+TEST_CASE("Buffered average strategy", "[mccfr][blueprint]") {
+  BlueprintTrainerConfig config{};
+  config.strategy_interval = 100;
+  config.lcfr_thresh = 20'000;
+  config.discount_interval = 5'000;
+  int n_threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  BlueprintTrainer buffered{config, false, "test_snapshots"};
+  buffered.mccfr_p(30'000);
+  BlueprintTrainer direct{config, false, "test_snapshots"};
+  direct.set_phi_buffering(false);
+  direct.mccfr_p(30'000);
+  omp_set_num_threads(n_threads);
+  std::filesystem::remove_all("test_snapshots");
+
+  // Discounts make the sums non-integral, so the increments must have been applied in the same order.
+  REQUIRE(buffered.get_phi().size() == direct.get_phi().size());
+  buffered.get_phi().for_each([&](size_t idx, float value) { REQUIRE(value == direct.get_phi().get(idx)); });
+
+  // Without discounts, every strategy update adds exactly one increment to the root rows of the first player to act, 
+  // whichever thread buffered it.
+  config.discount_interval = 1'000'000;
+  omp_set_num_threads(std::max(n_threads, 2));
+  BlueprintTrainer merged{config, false, "test_snapshots"};
+  merged.mccfr_p(30'000);
+  omp_set_num_threads(n_threads);
+  std::filesystem::remove_all("test_snapshots");
+  int n_actions = valid_actions(config.init_state, config.action_profile).size();
+  double root_sum = 0.0;
+  for(int c = 0; c < merged.get_phi().n_clusters(); ++c) {
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) root_sum += merged.get_phi().get(merged.phi_index(config.init_state, c, a_idx));
+  }
+  // Training starts at iteration 1.
+  REQUIRE(root_sum == 29'999 / config.strategy_interval);
+}
+
+TEST_CASE("Public chance sampling against enumeration", "[mccfr][blueprint]") {
+  BlueprintTrainerConfig config{};
+  config.public_sampling = true;
+  Board board{"AcKd7h5s2c"};
+  config.init_board = std::vector<uint8_t>(board.cards().begin(), board.cards().end());
+  while(config.init_state.get_round() < 3) config.init_state = config.init_state.apply(Action::CHECK_CALL);
+  REQUIRE(config.init_state.get_active() == 0);
+  int n_threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  BlueprintTrainer trainer{config, false, "test_snapshots"};
+  // Iteration 1 traverses player 0 first, so every strategy it reads is still uniform.
+  trainer.mccfr_p(2);
+  omp_set_num_threads(n_threads);
+  std::filesystem::remove_all("test_snapshots");
+
+  // Under uniform strategies, the value of action a for hand h is fixed[a] * R(h) + pot[a] * S(h), where R(h) is the reach
+  // of the opponent combinations compatible with h and S(h) their reach weighted with the showdown share of h.
+  auto actions = valid_actions(config.init_state, config.action_profile);
+  std::vector<double> fixed(actions.size()), pot(actions.size());
+  std::function<void(const PokerState&, double, int)> walk = [&](const PokerState& state, double p, int a_idx) {
+    if(state.is_terminal() || state.get_players()[0].has_folded()) {
+      const Player& player = state.get_players()[0];
+      double base = player.get_chips() - config.poker.n_chips;
+      if(player.has_folded() || state.get_winner() != -1) {
+        fixed[a_idx] += p * (base + (state.get_winner() == 0 ? state.get_pot() : 0));
+      }
+      else {
+        fixed[a_idx] += p * base;
+        pot[a_idx] += p * state.get_pot();
+      }
+      return;
+    }
+    auto next_actions = valid_actions(state, config.action_profile);
+    for(Action a : next_actions) walk(state.apply(a), p / next_actions.size(), a_idx);
+  };
+  for(int a_idx = 0; a_idx < actions.size(); ++a_idx) walk(config.init_state.apply(actions[a_idx]), 1.0, a_idx);
+
+  omp::HandEvaluator eval;
+  PublicDeal deal;
+  deal.update(board, eval);
+  double total = 0.0;
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) total += deal.blocked[h_idx] ? 0.0 : 1.0;
+  std::vector<std::vector<double>> expected(trainer.get_regrets().n_clusters(), std::vector<double>(actions.size(), 0.0));
+  for(int h_idx = 0; h_idx < N_HANDS; ++h_idx) {
+    if(deal.blocked[h_idx]) continue;
+    const Hand& hand = PublicDeal::hands()[h_idx];
+    double reach = 0.0, share = 0.0;
+    for(int o_idx = 0; o_idx < N_HANDS; ++o_idx) {
+      const Hand& opp = PublicDeal::hands()[o_idx];
+      if(deal.blocked[o_idx] || hand.cards()[0] == opp.cards()[0] || hand.cards()[0] == opp.cards()[1] || 
+         hand.cards()[1] == opp.cards()[0] || hand.cards()[1] == opp.cards()[1]) continue;
+      std::vector<uint8_t> win_idxs = winners(PokerState{2}, {hand, opp}, board, eval);
+      reach += 1.0 / total;
+      share += win_idxs[0] == 0 ? 1.0 / total / win_idxs.size() : 0.0;
+    }
+    std::vector<double> values(actions.size());
+    double v = 0.0;
+    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+      values[a_idx] = fixed[a_idx] * reach + pot[a_idx] * share;
+      v += values[a_idx] / actions.size();
+    }
+    int cluster = deal.cluster(h_idx, 3);
+    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) expected[cluster][a_idx] += values[a_idx] - v;
+  }
+
+  const auto& regrets = trainer.get_regrets();
+  int n_checked = 0;
+  for(int cluster = 0; cluster < regrets.n_clusters(); ++cluster) {
+    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+      double r = regrets.get(trainer.regret_index(config.init_state, cluster, a_idx));
+      REQUIRE(std::abs(r - std::max<double>(expected[cluster][a_idx], config.regret_floor)) <= 1.0 + 1e-4 * std::abs(expected[cluster][a_idx]));
+      n_checked += expected[cluster][a_idx] != 0.0;
+    }
+  }
+  REQUIRE(n_checked > 0);
+}
+
+TEST_CASE("Asynchronous snapshots", "[serialize][blueprint]") {
+  // Pre-sized storage has discounts pending at the snapshot, which must not be settled with OpenMP in the forked child. The 
+  // parent uses a thread pool even on a single core, otherwise the child could not hang.
+  int max_threads = omp_get_max_threads();
+  omp_set_num_threads(std::max(max_threads, 2));
+  for(bool compile_tree : {false, true}) {
+    BlueprintTrainerConfig config{};
+    config.async_snapshots = true;
+    config.compile_tree = compile_tree;
+    config.preflop_threshold = 20'000;
+    config.snapshot_interval = 20'000;
+    config.discount_interval = 10'000;
+    config.lcfr_thresh = 40'000;
+    std::filesystem::path snapshot_dir = "test_snapshots";
+    BlueprintTrainer trainer{config, false, snapshot_dir.string()};
+    trainer.mccfr_p(60'000);
+
+    // Children that failed leave a .tmp file behind, children that hung never return from mccfr_p.
+    int n_snapshots = 0;
+    for(const auto& entry : std::filesystem::directory_iterator(snapshot_dir)) {
+      REQUIRE(entry.path().extension() == ".bin");
+      auto snapshot = cereal_load<BlueprintTrainer>(entry.path().string());
+      REQUIRE(snapshot.get_config() == config);
+      ++n_snapshots;
+    }
+    std::filesystem::remove_all(snapshot_dir);
+    // The preflop snapshot at 20k and the snapshots at 40k and 60k.
+    REQUIRE(n_snapshots == 3);
+  }
+  omp_set_num_threads(max_threads);
+}
+
+TEST_CASE("Delta snapshot chains", "[serialize][blueprint]") {
+  for(bool async : {false, true}) {
+    BlueprintTrainerConfig config{};
+    config.compile_tree = true;
+    config.delta_snapshots = 2;
+    config.async_snapshots = async;
+    config.preflop_threshold = 10'000;
+    config.snapshot_interval = 10'000;
+    config.discount_interval = 1'000'000;
+    config.lcfr_thresh = 1'000'000;
+    std::filesystem::path snapshot_dir = "test_snapshots";
+    std::filesystem::remove_all(snapshot_dir);
+    BlueprintTrainer trainer{config, false, snapshot_dir.string()};
+    std::set<std::filesystem::path> seen;
+    std::string base_fn;
+    std::vector<std::string> delta_fns;
+    // Full at 10k, deltas at 20k and 30k, full at 40k and deltas at 50k and 60k. In async mode the child of the 50k delta 
+    // fails, so the 60k snapshot is full even though the chain of 40k has a delta left.
+    std::vector<bool> expected_deltas = {false, true, true, false, true, !async};
+    for(int step = 0; step < expected_deltas.size(); ++step) {
+      bool fail = async && step == 4;
+      // A file in place of the directory makes the child fail to write its snapshot.
+      if(fail) {
+        std::filesystem::rename(snapshot_dir, "test_snapshots_kept");
+        std::ofstream{snapshot_dir};
+      }
+      trainer.mccfr_p((step + 1) * 10'000);
+      if(fail) {
+        std::filesystem::remove(snapshot_dir);
+        std::filesystem::rename("test_snapshots_kept", snapshot_dir);
+        continue;
+      }
+      std::vector<std::filesystem::path> new_fns;
+      for(const auto& entry : std::filesystem::directory_iterator(snapshot_dir)) {
+        if(!seen.contains(entry.path())) new_fns.push_back(entry.path());
+      }
+      REQUIRE(new_fns.size() == 1);
+      seen.insert(new_fns[0]);
+      bool delta = new_fns[0].filename().string().find("_delta") != std::string::npos;
+      REQUIRE(delta == expected_deltas[step]);
+      if(delta) {
+        delta_fns.push_back(new_fns[0].string());
+      }
+      else {
+        base_fn = new_fns[0].string();
+        delta_fns.clear();
+      }
+      std::string full_fn = "test_full.bin";
+      cereal_save(trainer, full_fn);
+      REQUIRE(load_snapshot(base_fn, delta_fns) == cereal_load<BlueprintTrainer>(full_fn));
+      unlink(full_fn.c_str());
+    }
+    std::filesystem::remove_all(snapshot_dir);
+  }
+}
+
+TEST_CASE("Distributed training", "[mccfr][blueprint]") {
+  BlueprintTrainerConfig config{};
+  config.compile_tree = true;
+  config.sync_interval = 5'000;
+  config.row_sums = true;
+  auto transports = SocketTransport::mesh(2);
+  std::vector<std::unique_ptr<BlueprintTrainer>> trainers;
+  for(int rank = 0; rank < 2; ++rank) {
+    trainers.push_back(std::make_unique<BlueprintTrainer>(config, false, "test_snapshots", "metrics", std::move(transports[rank])));
+  }
+  std::vector<std::thread> threads;
+  for(auto& trainer : trainers) threads.emplace_back([&trainer]() { trainer->mccfr_p(20'000); });
+  for(auto& thread : threads) thread.join();
+
+  // Every rank allocates only its own blocks. Cached rows are fetched at the last synchronization, so they hold the
+  // values of their owners.
+  for(int rank = 0; rank < 2; ++rank) {
+    const auto& regrets = trainers[rank]->get_regrets();
+    REQUIRE(regrets.n_allocated() <= regrets.size() / 2 + (1 << OWNER_BITS));
+    const RowCache& cache = trainers[rank]->get_row_cache();
+    REQUIRE(cache.n_rows() > 0);
+    REQUIRE(cache.unfetched().empty());
+    cache.for_each_row([&](size_t base_idx, int n_actions, const int* values) {
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        size_t idx = base_idx + a_idx;
+        REQUIRE(values[a_idx] == trainers[value_owner(idx, 2)]->get_regrets().get(idx));
+      }
+    });
+  }
+
+  std::vector<std::string> rank_fns{"test_rank0.bin", "test_rank1.bin"};
+  for(int rank = 0; rank < 2; ++rank) cereal_save(*trainers[rank], rank_fns[rank]);
+  merge_replicas(rank_fns, "test_merged.bin");
+  auto merged = cereal_load<BlueprintTrainer>("test_merged.bin");
+  merged.get_regrets().for_each([&](size_t idx, int value) {
+    REQUIRE(value == trainers[value_owner(idx, 2)]->get_regrets().get(idx));
+  });
+  merged.get_phi().for_each([&](size_t idx, float value) {
+    REQUIRE(value == trainers[value_owner(idx, 2)]->get_phi().get(idx));
+  });
+  for(const auto& fn : rank_fns) std::filesystem::remove(fn);
+  std::filesystem::remove("test_merged.bin");
+  std::filesystem::remove_all("test_snapshots");
 }
 
-#endif
\ No newline at end of file
+#endif